@@ -33,7 +33,9 @@ android {
                     "-DGGML_CUDA=OFF",
                     "-DGGML_VULKAN=OFF",
                     "-DGGML_OPENMP=OFF",
-                    "-DBUILD_SHARED_LIBS=OFF"
+                    "-DBUILD_SHARED_LIBS=OFF",
+                    // Native trace spans (cpp/trace.h): ./gradlew -Paigentik.trace=ON
+                    "-DAIGENTIK_TRACE=${project.findProperty("aigentik.trace") ?: "OFF"}"
                 )
             }
         }
@@ -93,6 +95,7 @@ dependencies {
     implementation(libs.androidx.appcompat)
     implementation(libs.material)
     implementation(libs.androidx.constraintlayout)
+    implementation(libs.androidx.lifecycle.runtime.ktx)
     implementation(libs.kotlinx.coroutines)
     implementation(libs.javamail.android)
     implementation(libs.javamail.activation)
@@ -0,0 +1,23 @@
+// aigentik_log.h — logging macros shared by the native sources.
+// Each .cpp defines LOG_TAG before including this header.
+// On Android the macros go to logcat; elsewhere (host tools) they go to stderr
+// so the same sources compile without the NDK.
+#pragma once
+
+#ifndef LOG_TAG
+#define LOG_TAG "Aigentik"
+#endif
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO,  LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN,  LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#else
+#include <cstdio>
+#define AIGENTIK_LOG(lvl, ...) \
+    do { fprintf(stderr, lvl "/" LOG_TAG ": " __VA_ARGS__); fputc('\n', stderr); } while (0)
+#define LOGI(...) AIGENTIK_LOG("I", __VA_ARGS__)
+#define LOGW(...) AIGENTIK_LOG("W", __VA_ARGS__)
+#define LOGE(...) AIGENTIK_LOG("E", __VA_ARGS__)
+#endif
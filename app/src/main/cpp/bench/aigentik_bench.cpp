@@ -0,0 +1,533 @@
+// aigentik_bench.cpp — end-to-end inference benchmark on a developer machine.
+//
+// Drives Engine (engine.h) — the same load / context reset / chat template /
+// tokenize / prefill / decode path the app runs through llama_jni.cpp — with the
+// prompts AiEngine builds for SMS replies, email replies and command parsing, and
+// prints one JSON document: per scenario and overall pp / tg tok/s, TTFT and
+// end-to-end latency percentiles.
+//
+//   aigentik_bench --model qwen3-1.7b-q4_0.gguf [--runs 5] [--warmup 1]
+//                  [--threads 6] [--ctx 8192] [--batch 256] [--scenario sms,email,cmd]
+//                  [--session-ram MB] [--huge-pages off|advise|collapse]
+//                  [--cascade small.gguf [--cascade-entropy 1.5] [--cascade-min-prob 0.01]
+//                   [--cascade-draft-tokens 96]] [--out result.json]
+//
+// Sessions are off by default, so every run prefills its whole prompt (the cold
+// path). --session-ram enables the RAM session cache with the app's per-contact
+// keys, which measures the warm path instead.
+//
+// --huge-pages backs the KV cache, compute buffers and anonymous weight copies with
+// transparent huge pages (huge_pages.h); the "huge_pages" block reports how much
+// the kernel actually gave. Compare tg_tps and dtlb_misses_per_token of an `off`
+// and a `collapse` run — the TLB counts need a -DAIGENTIK_PERF_COUNTERS=ON build
+// and read -1 otherwise.
+//
+// --cascade registers a second, smaller model and sends the SMS scenario through
+// generateCascade(), as AiEngine does when a small model is loaded, with the
+// --cascade-* limits (AiEngine's by default). The sms block then reports
+// small_tier_share, the fraction of replies the small model kept, the mean latency
+// of each tier, and escalated_draft_ms, the draft time an escalated reply paid on
+// top. Run it over a few entropy / min-prob pairs to choose AiEngine's limits.
+
+#include "engine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+// ─── Prompts — mirror AiEngine.kt ───────────────────────────────────────────
+
+constexpr const char* kAgent = "Aigentik";
+constexpr const char* kOwner = "Alex";
+constexpr int kEmailBodyTokens = 1024;   // AiEngine.EMAIL_BODY_TOKENS
+
+std::string truncatable(const std::string& s) {
+    return std::string(TRUNCATE_BEGIN) + s + TRUNCATE_END;
+}
+
+// How AiEngine submits the prompt.
+enum class Path {
+    Tokens,    // budgetedPrompt() → tokenizeChat() → generateTokens()
+    Chat,      // generateChat()
+    Cascade,   // generateCascade() with kSmallModel drafting
+};
+
+constexpr const char* kSmallModel = "small";
+
+struct Request {
+    std::string              sessionKey;
+    std::vector<ChatMessage> msgs;
+};
+
+struct Scenario {
+    std::string          name;
+    Path                 path;
+    int                  maxTokens;
+    SamplingParams       sp;
+    std::string          prefill;
+    int                  segmentBudget;
+    std::vector<Request> requests;
+    CascadeParams        cascade = {};    // Path::Cascade
+};
+
+std::string smsSystem(const std::string& from, const char* relationship) {
+    std::string s = std::string("You are ") + kAgent + ", an AI personal assistant for " + kOwner +
+                    ". Reply to a text message sent to " + kOwner + " from " + from + ". ";
+    if (relationship) s += std::string("Relationship: ") + relationship + ". ";
+    return s + "Be concise and natural — this is a text message. "
+               "Do NOT add a signature. Reply with message text only.";
+}
+
+Request smsRequest(const std::string& from, const std::string& phone, const char* relationship,
+                   const std::vector<std::string>& history, const std::string& message) {
+    std::string user;
+    if (!history.empty()) {
+        user += "Previous conversation:\n";
+        for (const auto& h : history) user += h + "\n";
+        user += "---\n";
+    }
+    user += "Reply to: \"" + truncatable(message) + "\" from " + from;
+    return {"sms:" + phone, {{"system", smsSystem(from, relationship)}, {"user", user}}};
+}
+
+std::string emailSystem() {
+    return std::string("You are ") + kAgent + ", an AI personal assistant for " + kOwner + ". " +
+           "You reply to emails sent to " + kOwner + ". "
+           "Follow any IMPORTANT instruction given for the sender. "
+           "Be professional and natural. Do NOT add a signature.";
+}
+
+Request emailRequest(const std::string& from, const std::string& address, const char* relationship,
+                     const char* instructions, const std::string& subject, const std::string& body) {
+    std::string user = "From: " + from + "\n";
+    if (relationship) user += std::string("Relationship: ") + relationship + "\n";
+    if (instructions) user += std::string("IMPORTANT: ") + instructions + "\n";
+    user += "Subject: " + subject + "\nBody: " + truncatable(body) + "\n\nWrite a reply.";
+    return {"email:" + address, {{"system", emailSystem()}, {"user", user}}};
+}
+
+const char* kCommandSystem =
+    "You interpret commands for an AI assistant. "
+    "Return ONLY valid JSON with no extra text: "
+    "{\"action\":\"string\",\"target\":\"string or null\",\"content\":\"string or null\",\"query\":\"string or null\"} "
+    "The 'query' field is a Gmail search string (e.g. \"from:amazon is:unread\"). "
+    "Actions: send_sms, send_email, find_contact, get_contact_phone, "
+    "never_reply_to, always_reply_to, set_contact_instructions, "
+    "gmail_count_unread, gmail_list_unread, gmail_search, "
+    "gmail_trash, gmail_trash_all, gmail_mark_read, gmail_mark_read_all, "
+    "gmail_mark_spam, gmail_label, gmail_unsubscribe, gmail_empty_trash, "
+    "check_email, list_contacts, sync_contacts, status, unknown. "
+    "Examples: "
+    "\"how many unread emails\" -> {\"action\":\"gmail_count_unread\",\"target\":null,\"content\":null,\"query\":null} "
+    "\"any new emails\" -> {\"action\":\"gmail_count_unread\",\"target\":null,\"content\":null,\"query\":null} "
+    "\"list my unread emails\" -> {\"action\":\"gmail_list_unread\",\"target\":null,\"content\":null,\"query\":null} "
+    "\"what emails haven't I read\" -> {\"action\":\"gmail_list_unread\",\"target\":null,\"content\":null,\"query\":null} "
+    "\"could you check my emails\" -> {\"action\":\"gmail_list_unread\",\"target\":null,\"content\":null,\"query\":null} "
+    "\"check my inbox\" -> {\"action\":\"gmail_list_unread\",\"target\":null,\"content\":null,\"query\":null} "
+    "\"show emails from amazon\" -> {\"action\":\"gmail_search\",\"target\":\"amazon\",\"content\":null,\"query\":\"from:amazon\"} "
+    "\"delete that email from john\" -> {\"action\":\"gmail_trash\",\"target\":\"john\",\"content\":null,\"query\":\"from:john\"} "
+    "\"delete all emails from newsletters\" -> {\"action\":\"gmail_trash_all\",\"target\":\"newsletters\",\"content\":null,\"query\":\"from:newsletters\"} "
+    "\"mark emails from google as read\" -> {\"action\":\"gmail_mark_read_all\",\"target\":\"google\",\"content\":null,\"query\":\"from:google is:unread\"} "
+    "\"mark that amazon email as spam\" -> {\"action\":\"gmail_mark_spam\",\"target\":\"amazon\",\"content\":null,\"query\":\"from:amazon\"} "
+    "\"label amazon emails as shopping\" -> {\"action\":\"gmail_label\",\"target\":\"amazon\",\"content\":\"shopping\",\"query\":\"from:amazon\"} "
+    "\"unsubscribe from newsletters.com\" -> {\"action\":\"gmail_unsubscribe\",\"target\":\"newsletters.com\",\"content\":null,\"query\":\"from:newsletters.com\"} "
+    "\"empty trash\" -> {\"action\":\"gmail_empty_trash\",\"target\":null,\"content\":null,\"query\":null} "
+    "\"text mom I'll be late\" -> {\"action\":\"send_sms\",\"target\":\"mom\",\"content\":\"I'll be late\",\"query\":null} "
+    "\"what's Sarah's number\" -> {\"action\":\"get_contact_phone\",\"target\":\"Sarah\",\"content\":null,\"query\":null} "
+    "\"always reply formally to John\" -> {\"action\":\"set_contact_instructions\",\"target\":\"John\",\"content\":\"always reply formally\",\"query\":null} "
+    "\"when texting Mom be casual\" -> {\"action\":\"set_contact_instructions\",\"target\":\"Mom\",\"content\":\"be casual and friendly\",\"query\":null}";
+
+Request commandRequest(const std::string& command) {
+    return {"cmd", {{"system", kCommandSystem}, {"user", "Command: \"" + command + "\""}}};
+}
+
+std::vector<Scenario> scenarios() {
+    std::vector<Scenario> out;
+
+    // generateSmsReply: 256 tokens, temperature 0.7 / top-p 0.9.
+    out.push_back({"sms", Path::Tokens, 256, {0.7f, 0.9f}, "", 0, {
+        smsRequest("Jordan", "+15551230001", "friend", {},
+                   "hey are we still on for dinner tonight? thinking 7 at the thai place"),
+        smsRequest("Mom", "+15551230002", "mother",
+                   {"Mom: Did you get the package I sent?", "Alex: Not yet, should be here Friday",
+                    "Mom: Ok let me know when it arrives"},
+                   "It says delivered! Did you open it yet? Your aunt picked the color"),
+        smsRequest("+15551230003", "+15551230003", nullptr, {},
+                   "Hi this is Sam from the dentist office confirming your cleaning Tuesday at "
+                   "10:30am. Reply C to confirm or call us to reschedule."),
+    }});
+
+    // generateEmailReply: 512 tokens, body capped at EMAIL_BODY_TOKENS.
+    std::string longBody;
+    for (int i = 0; i < 12; i++) {
+        longBody += "Item " + std::to_string(i + 1) + ": the vendor review for the Q3 rollout "
+                    "needs sign-off from finance and legal before the contract renewal window "
+                    "closes. Please confirm owners and expected dates, and flag any blockers "
+                    "that would push the launch past the end of the month.\n";
+    }
+    out.push_back({"email", Path::Tokens, 512, {0.7f, 0.9f}, "", kEmailBodyTokens, {
+        emailRequest("Priya Shah", "priya@example.com", "manager", "keep replies short",
+                     "Q3 rollout checklist", longBody),
+        emailRequest("Chris Lee", "chris@example.org", "colleague", nullptr,
+                     "Lunch Thursday?",
+                     "Hi Alex,\n\nAre you free for lunch on Thursday? There's a new ramen place "
+                     "near the office I've been meaning to try. Noon works best for me.\n\nChris"),
+        emailRequest("Billing", "billing@example.net", nullptr, nullptr,
+                     "Your invoice #48213 is overdue",
+                     "Dear customer,\n\nOur records show invoice #48213 for $129.00 is now 14 days "
+                     "past due. Please arrange payment at your earliest convenience or reply to "
+                     "this message if you believe this is an error.\n\nThank you,\nAccounts"),
+    }});
+
+    // interpretCommand: 120 tokens, greedy, empty <think> block as the prefill.
+    out.push_back({"cmd", Path::Chat, 120, {0.0f, 1.0f}, "<think>\n\n</think>\n", 0, {
+        commandRequest("how many unread emails do I have"),
+        commandRequest("text Jordan I'm running 10 minutes late"),
+        commandRequest("delete all emails from promotions@shop.example"),
+        commandRequest("always reply formally to Priya"),
+    }});
+
+    return out;
+}
+
+// ─── Measurement ────────────────────────────────────────────────────────────
+
+struct Sample {
+    double ppTps    = 0;
+    double tgTps    = 0;
+    double ttftMs   = 0;
+    double totalMs  = 0;
+    int    promptTokens    = 0;
+    int    reusedTokens    = 0;
+    int    generatedTokens = 0;
+    int64_t decodeDtlbMisses = -1;
+    CascadeTier tier = CascadeTier::None;
+    double draftMs = 0;
+};
+
+Sample runRequest(Engine& engine, const Scenario& s, const Request& r, bool& ok) {
+    std::string reply;
+    if (s.path == Path::Tokens) {
+        std::vector<llama_token> tokens = engine.tokenizeChat(r.msgs, s.prefill, s.maxTokens,
+                                                              s.segmentBudget);
+        reply = engine.generateTokens(std::move(tokens), s.maxTokens, s.sp, r.sessionKey);
+    } else if (s.path == Path::Cascade) {
+        reply = engine.generateCascade(r.msgs, s.prefill, s.segmentBudget, s.maxTokens, s.sp,
+                                       r.sessionKey, s.cascade);
+    } else {
+        reply = engine.generateChat(r.msgs, s.prefill, s.segmentBudget, 0, s.maxTokens, s.sp,
+                                    r.sessionKey);
+    }
+    const GenerationStats st = engine.lastStats();
+    ok = st.stopReason != StopReason::None && st.stopReason != StopReason::Error;
+    return {st.prefillTps, st.decodeTps, st.ttftMs, st.totalMs,
+            st.promptTokens, st.reusedTokens, st.generatedTokens, st.decodeCounters.dtlbMisses,
+            st.cascadeTier, st.draftMs};
+}
+
+// Nearest-rank percentile of an ascending vector.
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+double mean(const std::vector<double>& v) {
+    double sum = 0;
+    for (double x : v) sum += x;
+    return v.empty() ? 0 : sum / v.size();
+}
+
+std::string jsonEscape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n";  break;
+            case '\t': out += "\\t";  break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
+
+// pp / tg tok/s are averaged over runs that had that phase (a fully reused prompt
+// has no prefill); latencies are percentiles over all runs.
+std::string summaryJson(const std::vector<Sample>& samples, int failures) {
+    std::vector<double> pp, tg, ttft, total;
+    long promptTokens = 0, reusedTokens = 0, generatedTokens = 0;
+    long dtlbMisses = 0, dtlbTokens = 0;
+    int cascaded = 0, smallTier = 0;
+    std::vector<double> smallTotal, largeTotal, escalatedDraft;
+    for (const Sample& s : samples) {
+        if (s.tier != CascadeTier::None) cascaded++;
+        if (s.tier == CascadeTier::Small) {
+            smallTier++;
+            smallTotal.push_back(s.totalMs);
+        } else if (s.tier == CascadeTier::Large) {
+            largeTotal.push_back(s.totalMs);
+            escalatedDraft.push_back(s.draftMs);
+        }
+        if (s.decodeDtlbMisses >= 0) {
+            dtlbMisses += (long)s.decodeDtlbMisses;
+            dtlbTokens += s.generatedTokens;
+        }
+        if (s.ppTps > 0) pp.push_back(s.ppTps);
+        if (s.tgTps > 0) tg.push_back(s.tgTps);
+        ttft.push_back(s.ttftMs);
+        total.push_back(s.totalMs);
+        promptTokens    += s.promptTokens;
+        reusedTokens    += s.reusedTokens;
+        generatedTokens += s.generatedTokens;
+    }
+    std::sort(ttft.begin(), ttft.end());
+    std::sort(total.begin(), total.end());
+
+    char buf[1536];
+    snprintf(buf, sizeof(buf),
+             "{\"runs\": %zu, \"failures\": %d, "
+             "\"pp_tps\": %.2f, \"tg_tps\": %.2f, "
+             "\"ttft_ms\": {\"mean\": %.2f, \"p50\": %.2f, \"p95\": %.2f, \"p99\": %.2f}, "
+             "\"latency_ms\": {\"mean\": %.2f, \"p50\": %.2f, \"p95\": %.2f, \"p99\": %.2f}, "
+             "\"prompt_tokens\": %ld, \"reused_tokens\": %ld, \"generated_tokens\": %ld, "
+             "\"dtlb_misses_per_token\": %.1f, \"small_tier_share\": %.2f, "
+             "\"small_tier_latency_ms\": %.2f, \"large_tier_latency_ms\": %.2f, "
+             "\"escalated_draft_ms\": %.2f}",
+             samples.size(), failures, mean(pp), mean(tg),
+             mean(ttft), percentile(ttft, 50), percentile(ttft, 95), percentile(ttft, 99),
+             mean(total), percentile(total, 50), percentile(total, 95), percentile(total, 99),
+             promptTokens, reusedTokens, generatedTokens,
+             dtlbTokens ? (double)dtlbMisses / dtlbTokens : -1.0,
+             cascaded ? (double)smallTier / cascaded : -1.0,
+             smallTotal.empty() ? -1.0 : mean(smallTotal), largeTotal.empty() ? -1.0 : mean(largeTotal),
+             escalatedDraft.empty() ? -1.0 : mean(escalatedDraft));
+    return buf;
+}
+
+// ─── Command line ───────────────────────────────────────────────────────────
+
+struct Options {
+    std::string model;
+    std::string out;
+    std::string cascade;              // small model for the sms scenario; "" = none
+    CascadeParams cascadeLimits;      // its small is set in main()
+    std::vector<std::string> only;    // scenario names; empty = all
+    int runs       = 5;
+    int warmup     = 1;
+    int sessionRam = 0;                // MB
+    HugePageMode hugePages = HugePageMode::Off;
+    EngineConfig config;
+};
+
+void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s --model PATH [--runs N] [--warmup N] [--threads N] [--ctx N]\n"
+            "          [--batch N] [--scenario sms,email,cmd] [--session-ram MB]\n"
+            "          [--huge-pages off|advise|collapse] [--cascade PATH [--cascade-entropy F]\n"
+            "          [--cascade-min-prob F] [--cascade-draft-tokens N]] [--out FILE]\n",
+            argv0);
+}
+
+bool parseArgs(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        auto num = [&](int& dst) {
+            if (!v) return false;
+            dst = atoi(v);
+            i++;
+            return true;
+        };
+        auto real = [&](float& dst) {
+            if (!v) return false;
+            dst = (float)atof(v);
+            i++;
+            return true;
+        };
+        if      (!strcmp(a, "--model")       && v) { o.model = v; i++; }
+        else if (!strcmp(a, "--out")         && v) { o.out   = v; i++; }
+        else if (!strcmp(a, "--cascade")     && v) { o.cascade = v; i++; }
+        else if (!strcmp(a, "--runs"))        { if (!num(o.runs))              return false; }
+        else if (!strcmp(a, "--warmup"))      { if (!num(o.warmup))            return false; }
+        else if (!strcmp(a, "--threads"))     { if (!num(o.config.nThreads))   return false; }
+        else if (!strcmp(a, "--ctx"))         { if (!num(o.config.ctxSize))    return false; }
+        else if (!strcmp(a, "--batch"))       { if (!num(o.config.nBatch))     return false; }
+        else if (!strcmp(a, "--session-ram")) { if (!num(o.sessionRam))        return false; }
+        else if (!strcmp(a, "--cascade-entropy")) {
+            if (!real(o.cascadeLimits.maxMeanEntropy)) return false;
+        }
+        else if (!strcmp(a, "--cascade-min-prob")) {
+            if (!real(o.cascadeLimits.minTokenProb)) return false;
+        }
+        else if (!strcmp(a, "--cascade-draft-tokens")) {
+            if (!num(o.cascadeLimits.draftMaxTokens)) return false;
+        }
+        else if (!strcmp(a, "--huge-pages") && v) {
+            if      (!strcmp(v, "off"))      o.hugePages = HugePageMode::Off;
+            else if (!strcmp(v, "advise"))   o.hugePages = HugePageMode::Advise;
+            else if (!strcmp(v, "collapse")) o.hugePages = HugePageMode::Collapse;
+            else return false;
+            i++;
+        }
+        else if (!strcmp(a, "--scenario") && v) {
+            std::string list = v;
+            i++;
+            for (size_t pos = 0; pos <= list.size();) {
+                size_t comma = list.find(',', pos);
+                if (comma == std::string::npos) comma = list.size();
+                if (comma > pos) o.only.push_back(list.substr(pos, comma - pos));
+                pos = comma + 1;
+            }
+        }
+        else return false;
+    }
+    return !o.model.empty() && o.runs > 0 && o.warmup >= 0;
+}
+
+const char* buildFlags() {
+    return ""
+#ifdef AIGENTIK_TRACE
+        "trace "
+#endif
+#ifdef AIGENTIK_PERF_COUNTERS
+        "perf_counters "
+#endif
+#ifdef NDEBUG
+        "ndebug"
+#endif
+        ;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    Engine engine(opt.config);
+    engine.setHugePages(opt.hugePages);
+    if (!engine.load(opt.model)) {
+        fprintf(stderr, "failed to load %s\n", opt.model.c_str());
+        return 1;
+    }
+    if (!opt.cascade.empty() && !engine.addModel(kSmallModel, opt.cascade)) {
+        fprintf(stderr, "failed to load %s\n", opt.cascade.c_str());
+        return 1;
+    }
+    if (opt.sessionRam > 0) engine.configureSessions("", (size_t)opt.sessionRam << 20, 0);
+    const WarmupStats warm = engine.warmup();    // what the app does after every load
+
+    std::string json = "{\n";
+    json += "  \"model\": \"" + jsonEscape(opt.model) + "\",\n";
+    json += "  \"model_info\": \"" + jsonEscape(engine.modelInfo()) + "\",\n";
+    char buf[256];
+    if (!opt.cascade.empty()) {
+        json += "  \"cascade_model\": \"" + jsonEscape(opt.cascade) + "\",\n";
+        snprintf(buf, sizeof(buf),
+                 "  \"cascade_limits\": {\"max_mean_entropy\": %.3f, \"min_token_prob\": %.4f, "
+                 "\"draft_max_tokens\": %d},\n",
+                 opt.cascadeLimits.maxMeanEntropy, opt.cascadeLimits.minTokenProb,
+                 opt.cascadeLimits.draftMaxTokens);
+        json += buf;
+    }
+    json += "  \"build\": \"" + jsonEscape(buildFlags()) + "\",\n";
+    snprintf(buf, sizeof(buf),
+             "  \"config\": {\"ctx\": %d, \"threads\": %d, \"batch\": %d, \"runs\": %d, "
+             "\"warmup\": %d, \"session_ram_mb\": %d},\n",
+             opt.config.ctxSize, opt.config.nThreads, opt.config.nBatch, opt.runs, opt.warmup,
+             opt.sessionRam);
+    json += buf;
+    snprintf(buf, sizeof(buf),
+             "  \"model_warmup\": {\"ok\": %s, \"threads_ms\": %.2f, \"touch_ms\": %.2f, "
+             "\"touched_bytes\": %lld, \"graph_ms\": %.2f, \"decode_ms\": %.2f, \"total_ms\": %.2f},\n",
+             warm.ok ? "true" : "false", warm.threadsMs, warm.touchMs, (long long)warm.touchedBytes,
+             warm.graphMs, warm.decodeMs, warm.totalMs);
+    json += buf;
+    json += "  \"scenarios\": {\n";
+
+    std::vector<Sample> all;
+    int allFailures = 0;
+    bool first = true;
+    for (Scenario& s : scenarios()) {
+        if (s.name == "sms" && !opt.cascade.empty()) {
+            s.path          = Path::Cascade;
+            s.cascade       = opt.cascadeLimits;
+            s.cascade.small = kSmallModel;
+        }
+        if (!opt.only.empty() &&
+            std::find(opt.only.begin(), opt.only.end(), s.name) == opt.only.end()) continue;
+
+        // Warm-up passes are not recorded: first-touch page faults on the weights
+        // and allocator growth would otherwise land in the first sample.
+        bool ok = false;
+        for (int w = 0; w < opt.warmup; w++) {
+            for (const Request& r : s.requests) runRequest(engine, s, r, ok);
+        }
+
+        std::vector<Sample> samples;
+        int failures = 0;
+        for (int run = 0; run < opt.runs; run++) {
+            for (const Request& r : s.requests) {
+                Sample sample = runRequest(engine, s, r, ok);
+                if (!ok) {
+                    failures++;
+                    continue;
+                }
+                samples.push_back(sample);
+            }
+        }
+        fprintf(stderr, "%s: %zu runs, %d failed\n", s.name.c_str(), samples.size(), failures);
+
+        json += std::string(first ? "" : ",\n") + "    \"" + s.name + "\": " +
+                summaryJson(samples, failures);
+        first = false;
+        all.insert(all.end(), samples.begin(), samples.end());
+        allFailures += failures;
+    }
+    json += "\n  },\n  \"overall\": " + summaryJson(all, allFailures) + ",\n";
+
+    const HugePageStats hp = engine.hugePageStats();
+    static const char* kModes[] = {"off", "advise", "collapse"};
+    snprintf(buf, sizeof(buf), "  \"huge_pages\": {\"mode\": \"%s\", \"thp\": \"%s\", "
+             "\"advised_bytes\": %lld, \"huge_bytes\": %lld, \"collapse_errors\": %d},\n",
+             kModes[(int)opt.hugePages], jsonEscape(hp.thp).c_str(), (long long)hp.advisedBytes,
+             (long long)hp.hugeBytes, hp.collapseErrors);
+    json += buf;
+
+    const MemoryStats mem = engine.memoryStats();
+    snprintf(buf, sizeof(buf), "  \"memory\": {\"weights_bytes\": %lld, \"kv_bytes\": %lld, "
+             "\"compute_bytes\": %lld, \"rss_bytes\": %lld, \"peak_rss_bytes\": %lld}\n}\n",
+             (long long)mem.weightsBytes, (long long)mem.kvBytes, (long long)mem.computeBytes,
+             (long long)mem.rssBytes, (long long)mem.peakRssBytes);
+    json += buf;
+
+    if (opt.out.empty()) {
+        fputs(json.c_str(), stdout);
+    } else {
+        FILE* f = fopen(opt.out.c_str(), "w");
+        if (!f) {
+            fprintf(stderr, "cannot write %s\n", opt.out.c_str());
+            return 1;
+        }
+        fputs(json.c_str(), f);
+        fclose(f);
+    }
+    return allFailures ? 3 : 0;
+}
@@ -0,0 +1,334 @@
+// jni_bench.cpp — microbenchmarks of the JNI marshalling layer (jni_marshal.h).
+//
+// Starts a desktop JVM through the invocation API (JNI_CreateJavaVM) and times the
+// same conversion code the app runs on every call: prompt ingestion (UTF-8 byte[]
+// and, for comparison, jstring), reply bytes and Java string construction, and
+// byte[][] / double[] result building. With a GGUF it also times token-to-piece
+// conversion and reply assembly (vocab only, no weights are loaded). Inputs are
+// sized like real traffic: an SMS prompt, a long email body, the command system
+// prompt, SMS and email replies with emoji.
+//
+// Output follows Google Benchmark's console and JSON layouts so results can go
+// through the same compare tooling; run it before and after a change to
+// jni_marshal.cpp and compare ns per call:
+//
+//   jni_bench [--model tiny-qwen3.gguf] [--benchmark_filter=SUBSTR]
+//             [--benchmark_min_time=0.5] [--benchmark_format=console|json]
+//             [--check_jni]
+//
+// A desktop HotSpot JNI is not ART — absolute numbers differ from a phone — but
+// the per-call work (lookups, allocations, copies) that optimisations remove is
+// the same on both.
+
+#include "jni_marshal.h"
+
+#include <jni.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+#include "generation.h"
+#include "llama.h"
+
+namespace {
+
+// ─── Harness ────────────────────────────────────────────────────────────────
+
+struct Benchmark {
+    std::string                 name;
+    int64_t                     bytesPerIter;   // 0 = no throughput column
+    std::function<void(int64_t)> run;           // runs n iterations
+};
+
+struct Result {
+    std::string name;
+    int64_t     iterations;
+    double      nsPerIter;
+    double      bytesPerSecond;
+};
+
+// Grows the iteration count until one timed pass lasts at least minTime seconds,
+// the way Google Benchmark does.
+Result measure(const Benchmark& b, double minTime) {
+    using clock = std::chrono::steady_clock;
+    int64_t iters = 1;
+    for (;;) {
+        const auto start = clock::now();
+        b.run(iters);
+        const double secs = std::chrono::duration<double>(clock::now() - start).count();
+        if (secs >= minTime || iters >= (int64_t)1 << 30) {
+            const double ns = secs * 1e9 / iters;
+            return {b.name, iters, ns, b.bytesPerIter ? b.bytesPerIter * iters / secs : 0};
+        }
+        const double perIter = secs > 0 ? secs / iters : 1e-9;
+        const int64_t next = (int64_t)(minTime * 1.4 / perIter);
+        iters = std::max(iters * 2, std::min(next, iters * 100));
+    }
+}
+
+void printConsole(const std::vector<Result>& results) {
+    printf("%-44s %12s %12s %14s\n", "Benchmark", "Time", "Iterations", "Throughput");
+    printf("%s\n", std::string(85, '-').c_str());
+    for (const Result& r : results) {
+        char tput[32] = "";
+        if (r.bytesPerSecond > 0) snprintf(tput, sizeof(tput), "%.1f MiB/s", r.bytesPerSecond / 1048576.0);
+        printf("%-44s %9.0f ns %12lld %14s\n", r.name.c_str(), r.nsPerIter,
+               (long long)r.iterations, tput);
+    }
+}
+
+void printJson(const std::vector<Result>& results) {
+    printf("{\n  \"context\": {\"library_build_type\": \"%s\"},\n  \"benchmarks\": [\n",
+#ifdef NDEBUG
+           "release"
+#else
+           "debug"
+#endif
+    );
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        printf("    {\"name\": \"%s\", \"run_type\": \"iteration\", \"iterations\": %lld, "
+               "\"real_time\": %.2f, \"cpu_time\": %.2f, \"time_unit\": \"ns\"",
+               r.name.c_str(), (long long)r.iterations, r.nsPerIter, r.nsPerIter);
+        if (r.bytesPerSecond > 0) printf(", \"bytes_per_second\": %.0f", r.bytesPerSecond);
+        printf("}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+// Keeps the optimizer from discarding a result.
+template <typename T>
+void doNotOptimize(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// ─── Inputs ─────────────────────────────────────────────────────────────────
+
+std::string repeatTo(const std::string& unit, size_t bytes) {
+    std::string s;
+    while (s.size() < bytes) s += unit;
+    return s;
+}
+
+const std::string kSmsPrompt =
+    "Reply to: \"hey are we still on for dinner tonight? thinking 7 at the thai place, "
+    "lmk if that works 🍜\" from Jordan";
+const std::string kEmailBody = repeatTo(
+    "Hi Alex, following up on the Q3 rollout: finance and legal still need to sign off "
+    "before the renewal window closes. Can you confirm owners and dates? Thanks — Priya\n",
+    6 * 1024);
+const std::string kCommandSystem = repeatTo(
+    "\"show emails from amazon\" -> {\"action\":\"gmail_search\",\"target\":\"amazon\","
+    "\"content\":null,\"query\":\"from:amazon\"} ", 3 * 1024);
+const std::string kSmsReply =
+    "Yes! 7 works for me, see you at the thai place 😊 I'll grab a table if I get there first.";
+const std::string kEmailReply = repeatTo(
+    "Thanks Priya — finance signed off this morning and legal expects to finish review by "
+    "Thursday. I'll confirm owners and dates in the tracker by end of day. 👍\n", 1536);
+
+// ─── Benchmarks ─────────────────────────────────────────────────────────────
+
+std::vector<Benchmark> marshallingBenchmarks(JNIEnv* env) {
+    std::vector<Benchmark> out;
+
+    // Inputs as Java strings, built once with the helper under test.
+    auto global = [env](jobject local) {
+        jobject g = env->NewGlobalRef(local);
+        env->DeleteLocalRef(local);
+        return g;
+    };
+    const struct { const char* name; const std::string* text; } prompts[] = {
+        {"sms_prompt", &kSmsPrompt}, {"email_body", &kEmailBody}, {"command_system", &kCommandSystem},
+    };
+    for (const auto& p : prompts) {
+        jstring js = (jstring)global(toJavaString(env, *p.text));
+        out.push_back({std::string("BM_FromJavaString/") + p.name, (int64_t)p.text->size(),
+                       [env, js](int64_t n) {
+                           for (int64_t i = 0; i < n; i++) doNotOptimize(fromJavaString(env, js));
+                       }});
+        jbyteArray bytes = (jbyteArray)global(toJavaBytes(env, *p.text));
+        out.push_back({std::string("BM_FromJavaBytes/") + p.name, (int64_t)p.text->size(),
+                       [env, bytes](int64_t n) {
+                           for (int64_t i = 0; i < n; i++) doNotOptimize(fromJavaBytes(env, bytes));
+                       }});
+    }
+
+    // generateChat()'s two-message roles / contents arrays (UTF-8 byte[]).
+    {
+        jclass bytesClass = env->FindClass("[B");
+        jobjectArray roles    = (jobjectArray)global(env->NewObjectArray(2, bytesClass, nullptr));
+        jobjectArray contents = (jobjectArray)global(env->NewObjectArray(2, bytesClass, nullptr));
+        env->DeleteLocalRef(bytesClass);
+        const std::string texts[2][2] = {{"system", kCommandSystem}, {"user", kSmsPrompt}};
+        for (jsize i = 0; i < 2; i++) {
+            jbyteArray r = toJavaBytes(env, texts[i][0]);
+            jbyteArray c = toJavaBytes(env, texts[i][1]);
+            env->SetObjectArrayElement(roles, i, r);
+            env->SetObjectArrayElement(contents, i, c);
+            env->DeleteLocalRef(r);
+            env->DeleteLocalRef(c);
+        }
+        out.push_back({"BM_ToMessages/chat_2", (int64_t)(kCommandSystem.size() + kSmsPrompt.size()),
+                       [env, roles, contents](int64_t n) {
+                           for (int64_t i = 0; i < n; i++) doNotOptimize(toMessages(env, roles, contents));
+                       }});
+    }
+
+    const struct { const char* name; const std::string* text; } replies[] = {
+        {"sms_reply", &kSmsReply}, {"email_reply", &kEmailReply}, {"trace_json_64k", nullptr},
+    };
+    static const std::string traceJson = repeatTo(
+        "{\"name\":\"decode\",\"ph\":\"X\",\"ts\":12345,\"dur\":42,\"pid\":1,\"tid\":2},\n", 64 * 1024);
+    for (const auto& r : replies) {
+        const std::string* text = r.text ? r.text : &traceJson;
+        out.push_back({std::string("BM_ToJavaString/") + r.name, (int64_t)text->size(),
+                       [env, text](int64_t n) {
+                           for (int64_t i = 0; i < n; i++) env->DeleteLocalRef(toJavaString(env, *text));
+                       }});
+        out.push_back({std::string("BM_ToJavaBytes/") + r.name, (int64_t)text->size(),
+                       [env, text](int64_t n) {
+                           for (int64_t i = 0; i < n; i++) env->DeleteLocalRef(toJavaBytes(env, *text));
+                       }});
+    }
+
+    // Lower bound for string construction: NewStringUTF on ASCII (not usable for
+    // model output — see toJavaString()).
+    static const std::string asciiReply = "Yes, 7 works for me, see you at the thai place.";
+    out.push_back({"BM_NewStringUTF/ascii_reference", (int64_t)asciiReply.size(),
+                   [env](int64_t n) {
+                       for (int64_t i = 0; i < n; i++) env->DeleteLocalRef(env->NewStringUTF(asciiReply.c_str()));
+                   }});
+
+    // nativeGenerateBulk result: 8 email replies.
+    {
+        const std::vector<std::string> bulk(8, kEmailReply);
+        out.push_back({"BM_ToJavaBytesArray/bulk_8", (int64_t)(8 * kEmailReply.size()),
+                       [env, bulk](int64_t n) {
+                           for (int64_t i = 0; i < n; i++) env->DeleteLocalRef(toJavaBytesArray(env, bulk));
+                       }});
+    }
+
+    // nativeLastStats result.
+    out.push_back({"BM_StatsToArray", 0, [env](int64_t n) {
+                       GenerationStats st;
+                       st.promptTokens = 812;
+                       st.generatedTokens = 96;
+                       for (int64_t i = 0; i < n; i++) {
+                           env->DeleteLocalRef(toJavaDoubleArray(env, statsToArray(st)));
+                       }
+                   }});
+
+    // nativeTokenize result into a direct buffer (1 KiB of tokens).
+    {
+        static std::vector<int32_t> storage(4096);
+        jobject buf = global(env->NewDirectByteBuffer(storage.data(), (jlong)(storage.size() * 4)));
+        const std::vector<llama_token> tokens(1024, 42);
+        out.push_back({"BM_WriteTokens/1024", (int64_t)(tokens.size() * 4),
+                       [env, buf, tokens](int64_t n) {
+                           for (int64_t i = 0; i < n; i++) doNotOptimize(writeTokens(env, buf, tokens));
+                       }});
+    }
+    return out;
+}
+
+// Token → text as the decode loop does it, and a whole reply: 256 pieces appended
+// and handed to Java.
+std::vector<Benchmark> vocabBenchmarks(JNIEnv* env, const llama_vocab* vocab) {
+    std::vector<Benchmark> out;
+    const int nVocab = llama_vocab_n_tokens(vocab);
+    std::vector<llama_token> ids;
+    for (int i = 0; i < 256; i++) ids.push_back((llama_token)((i * 2654435761u) % (unsigned)nVocab));
+
+    out.push_back({"BM_TokenPiece", 0, [vocab, ids](int64_t n) {
+                       bool stop = false;
+                       for (int64_t i = 0; i < n; i++) {
+                           doNotOptimize(tokenPiece(vocab, ids[(size_t)i & 255], stop));
+                       }
+                   }});
+    out.push_back({"BM_ReplyAssembly/256_tokens", 0, [env, vocab, ids](int64_t n) {
+                       bool stop = false;
+                       for (int64_t i = 0; i < n; i++) {
+                           std::string reply;
+                           for (llama_token t : ids) reply += tokenPiece(vocab, t, stop);
+                           env->DeleteLocalRef(toJavaBytes(env, reply));
+                       }
+                   }});
+    return out;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string model, filter, format = "console";
+    double minTime = 0.5;
+    bool checkJni = false;
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        if (!strcmp(a, "--model") && i + 1 < argc)            model   = argv[++i];
+        else if (!strncmp(a, "--benchmark_filter=", 19))      filter  = a + 19;
+        else if (!strncmp(a, "--benchmark_min_time=", 21))    minTime = atof(a + 21);
+        else if (!strncmp(a, "--benchmark_format=", 19))      format  = a + 19;
+        else if (!strcmp(a, "--check_jni"))                   checkJni = true;
+        else {
+            fprintf(stderr, "usage: %s [--model GGUF] [--benchmark_filter=SUBSTR] "
+                            "[--benchmark_min_time=SECS] [--benchmark_format=console|json] "
+                            "[--check_jni]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    JavaVMOption options[1];
+    options[0].optionString = const_cast<char*>("-Xcheck:jni");
+    options[0].extraInfo    = nullptr;
+    JavaVMInitArgs vmArgs;
+    vmArgs.version            = JNI_VERSION_1_6;
+    vmArgs.nOptions           = checkJni ? 1 : 0;
+    vmArgs.options            = options;
+    vmArgs.ignoreUnrecognized = JNI_FALSE;
+    JavaVM* vm  = nullptr;
+    JNIEnv* env = nullptr;
+    if (JNI_CreateJavaVM(&vm, reinterpret_cast<void**>(&env), &vmArgs) != JNI_OK) {
+        fprintf(stderr, "JNI_CreateJavaVM failed\n");
+        return 1;
+    }
+
+    if (!jniMarshalInit(env)) {
+        fprintf(stderr, "jniMarshalInit failed\n");
+        return 1;
+    }
+    std::vector<Benchmark> benchmarks = marshallingBenchmarks(env);
+
+    llama_model* vocabModel = nullptr;
+    if (!model.empty()) {
+        llama_model_params mp = llama_model_default_params();
+        mp.vocab_only = true;
+        vocabModel = llama_model_load_from_file(model.c_str(), mp);
+        if (!vocabModel) {
+            fprintf(stderr, "failed to load vocab from %s\n", model.c_str());
+            return 1;
+        }
+        for (Benchmark& b : vocabBenchmarks(env, llama_model_get_vocab(vocabModel))) {
+            benchmarks.push_back(std::move(b));
+        }
+    }
+
+    std::vector<Result> results;
+    for (const Benchmark& b : benchmarks) {
+        if (!filter.empty() && b.name.find(filter) == std::string::npos) continue;
+        results.push_back(measure(b, minTime));
+        if (env->ExceptionCheck()) {
+            env->ExceptionDescribe();
+            return 1;
+        }
+    }
+    if (format == "json") printJson(results);
+    else printConsole(results);
+
+    if (vocabModel) llama_model_free(vocabModel);
+    vm->DestroyJavaVM();
+    return 0;
+}
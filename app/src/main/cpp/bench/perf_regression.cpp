@@ -0,0 +1,469 @@
+// perf_regression.cpp — engine regression checks on the tiny model (tiny_gguf.cpp).
+//
+// Four checks, each one ctest test (CMakeLists.txt):
+//
+//   --determinism 1,2,4   Greedy generation must produce the same text and token
+//                         count at every thread count. The same prompts run through
+//                         a fresh Engine per count, covering both generateTokens()
+//                         and generateChat() with a prefill.
+//
+//   --baseline FILE       Median prefill and decode tok/s over --runs runs must not
+//                         fall below (1 - tolerance) x the stored baseline. A missing
+//                         baseline fails the check; --update-baseline writes the
+//                         measured numbers to FILE instead of checking them.
+//
+//   --bulk                generateBulk() with one message too long for the context,
+//                         first and in the middle of the batch: only its reply may
+//                         be empty.
+//
+//   --sessions DIR        Session cache (session_cache.h) with spill files in DIR:
+//                         more sessions than the RAM budget holds spill to disk, an
+//                         evicted one restores its token history and the same reply
+//                         as a RAM restore, a spill file holding another key is not
+//                         restored, and the disk budget deletes the oldest files.
+//
+// Throughput baselines are per machine and live in the build tree: record one with
+// the perf_baseline target (CMakeLists.txt) on a known-good build, and again when a
+// faster build lands. CI keeps its runner's baseline in the Actions cache.
+
+#include "engine.h"
+#include "hash_util.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+struct Options {
+    std::string      model;
+    std::string      baseline;
+    std::vector<int> threadCounts;
+    double           tolerance      = 0.15;
+    int              runs           = 5;
+    int              threads        = 4;
+    bool             updateBaseline = false;
+    bool             bulk           = false;
+    std::string      sessionDir;
+};
+
+EngineConfig configFor(int threads) {
+    EngineConfig c;
+    c.ctxSize  = 2048;
+    c.nThreads = threads;
+    return c;
+}
+
+std::vector<ChatMessage> smsPrompt() {
+    return {{"system", "You are Aigentik, an AI personal assistant for Alex. Reply to a text "
+                       "message sent to Alex from Jordan. Be concise and natural — this is a "
+                       "text message. Do NOT add a signature. Reply with message text only."},
+            {"user", "Reply to: \"are we still on for dinner tonight?\" from Jordan"}};
+}
+
+std::vector<ChatMessage> commandPrompt() {
+    return {{"system", "You interpret commands for an AI assistant. Return ONLY valid JSON with "
+                       "no extra text."},
+            {"user", "Command: \"text mom I'll be late\""}};
+}
+
+// ─── Determinism ────────────────────────────────────────────────────────────
+
+struct Output {
+    std::string text;
+    int         tokens = 0;
+};
+
+bool greedyOutputs(const Options& o, int threads, std::vector<Output>& out) {
+    Engine engine(configFor(threads));
+    if (!engine.load(o.model)) {
+        fprintf(stderr, "failed to load %s\n", o.model.c_str());
+        return false;
+    }
+    const SamplingParams greedy{0.0f, 1.0f};
+
+    std::vector<llama_token> tokens = engine.tokenizeChat(smsPrompt(), "", 64, 0);
+    Output sms;
+    sms.text   = engine.generateTokens(std::move(tokens), 64, greedy);
+    sms.tokens = engine.lastStats().generatedTokens;
+    out.push_back(sms);
+
+    Output cmd;
+    cmd.text   = engine.generateChat(commandPrompt(), "<think>\n\n</think>\n", 0, 0, 64, greedy);
+    cmd.tokens = engine.lastStats().generatedTokens;
+    out.push_back(cmd);
+    return true;
+}
+
+int checkDeterminism(const Options& o) {
+    std::vector<Output> reference;
+    int failures = 0;
+    for (size_t i = 0; i < o.threadCounts.size(); i++) {
+        std::vector<Output> outputs;
+        if (!greedyOutputs(o, o.threadCounts[i], outputs)) return 1;
+        for (size_t p = 0; p < outputs.size(); p++) {
+            printf("threads=%d prompt=%zu tokens=%d\n", o.threadCounts[i], p, outputs[p].tokens);
+            if (outputs[p].tokens == 0) {
+                fprintf(stderr, "  prompt %zu generated nothing\n", p);
+                failures++;
+            }
+        }
+        if (i == 0) {
+            reference = std::move(outputs);
+            continue;
+        }
+        for (size_t p = 0; p < outputs.size(); p++) {
+            if (outputs[p].text != reference[p].text || outputs[p].tokens != reference[p].tokens) {
+                fprintf(stderr, "  prompt %zu differs at %d threads from %d threads\n",
+                        p, o.threadCounts[i], o.threadCounts[0]);
+                failures++;
+            }
+        }
+    }
+    printf("%s\n", failures ? "FAIL" : "OK");
+    return failures ? 1 : 0;
+}
+
+// ─── Bulk ───────────────────────────────────────────────────────────────────
+
+// Digits pre-tokenize one per token, so this is longer than the context in tokens.
+std::string oversizeMessage(int ctxSize) {
+    std::string s;
+    for (int i = 0; i < 2 * ctxSize; i++) s += (char)('0' + i % 10);
+    return s;
+}
+
+int checkBulk(const Options& o) {
+    const EngineConfig config = configFor(o.threads);
+    Engine engine(config);
+    if (!engine.load(o.model)) {
+        fprintf(stderr, "failed to load %s\n", o.model.c_str());
+        return 1;
+    }
+    const SamplingParams greedy{0.0f, 1.0f};
+    const std::string system = smsPrompt()[0].content;
+    const std::string big = oversizeMessage(config.ctxSize);
+    const std::string a = "Reply to: \"are we still on for dinner tonight?\" from Jordan";
+    const std::string b = "Reply to: \"can you send me the slides?\" from Sam";
+
+    int failures = 0;
+    const std::vector<std::vector<std::string>> batches = {{big, a, b}, {a, big, b}};
+    for (size_t n = 0; n < batches.size(); n++) {
+        const std::vector<std::string>& msgs = batches[n];
+        const std::vector<std::string> replies = engine.generateBulk(system, msgs, 0, 16, greedy);
+        if (replies.size() != msgs.size()) {
+            fprintf(stderr, "batch %zu: %zu replies for %zu messages\n", n, replies.size(), msgs.size());
+            failures++;
+            continue;
+        }
+        for (size_t i = 0; i < msgs.size(); i++) {
+            const bool oversize = msgs[i] == big;
+            printf("batch=%zu item=%zu%s reply=%zu bytes\n", n, i, oversize ? " (oversize)" : "",
+                   replies[i].size());
+            if (oversize != replies[i].empty()) {
+                fprintf(stderr, "  item %zu: expected %s reply\n", i, oversize ? "an empty" : "a");
+                failures++;
+            }
+        }
+    }
+    printf("%s\n", failures ? "FAIL" : "OK");
+    return failures ? 1 : 0;
+}
+
+// ─── Session spill ──────────────────────────────────────────────────────────
+
+struct Reply {
+    std::string text;
+    int         tokens = 0;
+    int         reused = 0;
+};
+
+Reply replyFor(Engine& engine, const std::vector<llama_token>& prompt, const std::string& key) {
+    const SamplingParams greedy{0.0f, 1.0f};
+    Reply r;
+    r.text = engine.generateTokens(prompt, 16, greedy, key);
+    const GenerationStats st = engine.lastStats();
+    r.tokens = st.generatedTokens;
+    r.reused = st.reusedTokens;
+    return r;
+}
+
+bool sameReply(const Reply& a, const Reply& b) { return a.text == b.text && a.tokens == b.tokens; }
+
+// Spill file of a primary-model session (SessionCache::pathFor()).
+std::string spillPath(const std::string& dir, const std::string& key) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64 ".kvz", fnv1a64(key));
+    return dir + "/" + name;
+}
+
+long fileBytes(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? (long)st.st_size : -1;
+}
+
+int spillFiles(const std::string& dir) {
+    int n = 0;
+    if (DIR* d = opendir(dir.c_str())) {
+        while (dirent* ent = readdir(d)) {
+            const size_t len = strlen(ent->d_name);
+            if (len > 4 && !strcmp(ent->d_name + len - 4, ".kvz")) n++;
+        }
+        closedir(d);
+    }
+    return n;
+}
+
+bool copyFile(const std::string& from, const std::string& to) {
+    FILE* in = fopen(from.c_str(), "rb");
+    if (!in) return false;
+    FILE* out = fopen(to.c_str(), "wb");
+    if (!out) {
+        fclose(in);
+        return false;
+    }
+    char buf[1 << 16];
+    size_t n;
+    bool ok = true;
+    while (ok && (n = fread(buf, 1, sizeof(buf), in)) > 0) ok = fwrite(buf, 1, n, out) == n;
+    fclose(in);
+    return fclose(out) == 0 && ok;
+}
+
+int checkSessions(const Options& o) {
+    Engine engine(configFor(o.threads));
+    if (!engine.load(o.model)) {
+        fprintf(stderr, "failed to load %s\n", o.model.c_str());
+        return 1;
+    }
+    const std::string& dir = o.sessionDir;
+    const std::vector<std::string> messages = {
+        "Reply to: \"are we still on for dinner tonight?\" from Jordan",
+        "Reply to: \"can you send me the slides?\" from Sam",
+        "Reply to: \"call me when you land\" from Mom",
+        "Reply to: \"did the package arrive yet?\" from Priya"};
+    std::vector<std::vector<llama_token>> prompts;
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < messages.size(); i++) {
+        prompts.push_back(engine.tokenizeChat({smsPrompt()[0], {"user", messages[i]}}, "", 16, 0));
+        keys.push_back("contact" + std::to_string(i));
+    }
+    const int last = (int)keys.size() - 1;
+    const size_t unbounded = (size_t)1 << 40;
+
+    int failures = 0;
+    auto expect = [&](bool ok, const char* what) {
+        printf("  %-52s %s\n", what, ok ? "ok" : "FAILED");
+        if (!ok) failures++;
+    };
+
+    // Reference: every prompt cold, then contact0 restored from RAM.
+    printf("reference (unbounded RAM)\n");
+    engine.configureSessions(dir, unbounded, unbounded);
+    std::vector<Reply> cold;
+    for (size_t i = 0; i < keys.size(); i++) cold.push_back(replyFor(engine, prompts[i], keys[i]));
+    const size_t sessionBytes = engine.sessionCounters().ramBytes / keys.size();
+    const Reply warm = replyFor(engine, prompts[0], keys[0]);
+    expect(engine.sessionCounters().ramHits == 1, "RAM restore");
+    expect(warm.reused == (int)prompts[0].size() - 1, "RAM restore reuses the prompt prefix");
+
+    // RAM budget of one and a half sessions: each save spills the one before.
+    printf("RAM budget %zu bytes\n", sessionBytes + sessionBytes / 2);
+    engine.configureSessions(dir, sessionBytes + sessionBytes / 2, unbounded);
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (!sameReply(replyFor(engine, prompts[i], keys[i]), cold[i])) {
+            fprintf(stderr, "  %s: cold reply differs from the reference\n", keys[i].c_str());
+            failures++;
+        }
+    }
+    SessionCache::Stats s = engine.sessionCounters();
+    expect(s.spills == (uint64_t)last && s.drops == 0, "older sessions spilled, none dropped");
+    expect(s.diskEntries == (size_t)last && spillFiles(dir) == last, "one spill file per evicted session");
+    const long spillBytes = fileBytes(spillPath(dir, keys[0]));
+    expect(spillBytes > 0, "contact0 spilled under its key hash");
+
+    const Reply fromDisk = replyFor(engine, prompts[0], keys[0]);
+    expect(engine.sessionCounters().diskHits == 1, "disk restore");
+    expect(fromDisk.reused == (int)prompts[0].size() - 1, "disk restore reuses the prompt prefix");
+    expect(sameReply(fromDisk, warm), "disk restore replies as the RAM restore");
+
+    // A spill file written for another key, as after a hash collision, is not ours.
+    printf("foreign spill file\n");
+    const std::string victim = spillPath(dir, keys[1]), owner = spillPath(dir, keys[2]);
+    expect(fileBytes(victim) > 0 && fileBytes(owner) > 0 && copyFile(owner, victim),
+           "contact2's file copied over contact1's");
+    const uint64_t misses = engine.sessionCounters().misses;
+    const Reply foreign = replyFor(engine, prompts[1], keys[1]);
+    expect(foreign.reused == 0 && engine.sessionCounters().misses == misses + 1,
+           "contact1 misses instead of loading contact2");
+    expect(sameReply(foreign, cold[1]), "contact1 replies as when cold");
+    const Reply owned = replyFor(engine, prompts[2], keys[2]);
+    expect(owned.reused == (int)prompts[2].size() - 1, "contact2 still restores from its file");
+
+    // Disk budget of one and a half spill files: only the newest file is kept.
+    printf("disk budget %ld bytes\n", spillBytes + spillBytes / 2);
+    engine.configureSessions(dir, sessionBytes + sessionBytes / 2, spillBytes + spillBytes / 2);
+    for (size_t i = 0; i < keys.size(); i++) replyFor(engine, prompts[i], keys[i]);
+    s = engine.sessionCounters();
+    expect(s.diskEntries == 1 && spillFiles(dir) == 1, "one spill file kept");
+    expect(s.drops == (uint64_t)last - 1, "older spill files dropped");
+    expect(fileBytes(spillPath(dir, keys[0])) < 0, "contact0's file deleted");
+    const Reply dropped = replyFor(engine, prompts[0], keys[0]);
+    expect(dropped.reused == 0 && sameReply(dropped, cold[0]), "contact0 starts cold");
+
+    engine.configureSessions(dir, 0, 0);    // deletes the remaining files
+    rmdir(dir.c_str());
+    printf("%s\n", failures ? "FAIL" : "OK");
+    return failures ? 1 : 0;
+}
+
+// ─── Throughput ─────────────────────────────────────────────────────────────
+
+double median(std::vector<double> v) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    const size_t n = v.size();
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+bool readBaseline(const std::string& path, double& pp, double& tg) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return false;
+    char key[64];
+    double value;
+    pp = tg = 0;
+    while (fscanf(f, "%63s %lf", key, &value) == 2) {
+        if (!strcmp(key, "pp_tps")) pp = value;
+        if (!strcmp(key, "tg_tps")) tg = value;
+    }
+    fclose(f);
+    return pp > 0 && tg > 0;
+}
+
+bool writeBaseline(const std::string& path, double pp, double tg, const std::string& modelInfo) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) return false;
+    fprintf(f, "pp_tps %.2f\ntg_tps %.2f\n", pp, tg);
+    fprintf(f, "# %s\n", modelInfo.c_str());
+    fclose(f);
+    return true;
+}
+
+int checkThroughput(const Options& o) {
+    Engine engine(configFor(o.threads));
+    if (!engine.load(o.model)) {
+        fprintf(stderr, "failed to load %s\n", o.model.c_str());
+        return 1;
+    }
+    const SamplingParams greedy{0.0f, 1.0f};
+    const std::vector<llama_token> prompt = engine.tokenizeChat(smsPrompt(), "", 128, 0);
+
+    engine.generateTokens(prompt, 128, greedy);    // warm-up, not recorded
+    std::vector<double> pp, tg;
+    for (int r = 0; r < o.runs; r++) {
+        engine.generateTokens(prompt, 128, greedy);
+        const GenerationStats st = engine.lastStats();
+        pp.push_back(st.prefillTps);
+        tg.push_back(st.decodeTps);
+    }
+    const double ppMed = median(pp), tgMed = median(tg);
+    printf("measured: pp %.1f tok/s, tg %.1f tok/s (median of %d, %d threads)\n",
+           ppMed, tgMed, o.runs, o.threads);
+    if (ppMed <= 0 || tgMed <= 0) {
+        fprintf(stderr, "no throughput measured\n");
+        return 1;
+    }
+
+    if (o.updateBaseline) {
+        if (!writeBaseline(o.baseline, ppMed, tgMed, engine.modelInfo())) {
+            fprintf(stderr, "cannot write baseline %s\n", o.baseline.c_str());
+            return 1;
+        }
+        printf("baseline written to %s\n", o.baseline.c_str());
+        return 0;
+    }
+    double basePp = 0, baseTg = 0;
+    if (!readBaseline(o.baseline, basePp, baseTg)) {
+        fprintf(stderr, "no baseline in %s — record one with --update-baseline "
+                        "(build target perf_baseline)\n", o.baseline.c_str());
+        return 1;
+    }
+
+    const double floor = 1.0 - o.tolerance;
+    printf("baseline: pp %.1f tok/s, tg %.1f tok/s (tolerance %.0f%%)\n",
+           basePp, baseTg, o.tolerance * 100);
+    int failures = 0;
+    if (ppMed < basePp * floor) {
+        fprintf(stderr, "prefill regressed: %.1f < %.1f\n", ppMed, basePp * floor);
+        failures++;
+    }
+    if (tgMed < baseTg * floor) {
+        fprintf(stderr, "decode regressed: %.1f < %.1f\n", tgMed, baseTg * floor);
+        failures++;
+    }
+    printf("%s\n", failures ? "FAIL" : "OK");
+    return failures ? 1 : 0;
+}
+
+// ─── Command line ───────────────────────────────────────────────────────────
+
+bool parseArgs(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        if (!strcmp(a, "--update-baseline")) {
+            o.updateBaseline = true;
+            continue;
+        }
+        if (!strcmp(a, "--bulk")) {
+            o.bulk = true;
+            continue;
+        }
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!v) return false;
+        i++;
+        if      (!strcmp(a, "--model"))     o.model     = v;
+        else if (!strcmp(a, "--baseline"))  o.baseline  = v;
+        else if (!strcmp(a, "--tolerance")) o.tolerance = atof(v);
+        else if (!strcmp(a, "--runs"))      o.runs      = atoi(v);
+        else if (!strcmp(a, "--threads"))   o.threads   = atoi(v);
+        else if (!strcmp(a, "--sessions"))  o.sessionDir = v;
+        else if (!strcmp(a, "--determinism")) {
+            for (const char* p = v; *p;) {
+                o.threadCounts.push_back(atoi(p));
+                p = strchr(p, ',');
+                if (!p) break;
+                p++;
+            }
+        }
+        else return false;
+    }
+    const bool oneMode = (int)!o.threadCounts.empty() + (int)!o.baseline.empty() + (int)o.bulk +
+                         (int)!o.sessionDir.empty() == 1;
+    return !o.model.empty() && oneMode && o.runs > 0 && o.threads > 0 &&
+           std::all_of(o.threadCounts.begin(), o.threadCounts.end(), [](int t) { return t > 0; });
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options o;
+    if (!parseArgs(argc, argv, o)) {
+        fprintf(stderr, "usage: %s --model PATH --determinism T1,T2,...\n"
+                        "       %s --model PATH --baseline FILE [--tolerance 0.15] [--runs 5]\n"
+                        "          [--threads 4] [--update-baseline]\n"
+                        "       %s --model PATH --bulk [--threads 4]\n"
+                        "       %s --model PATH --sessions DIR [--threads 4]\n",
+                argv[0], argv[0], argv[0], argv[0]);
+        return 2;
+    }
+    if (o.bulk) return checkBulk(o);
+    if (!o.sessionDir.empty()) return checkSessions(o);
+    return o.threadCounts.empty() ? checkThroughput(o) : checkDeterminism(o);
+}
@@ -0,0 +1,356 @@
+// tiny_gguf.cpp — writes a tiny random-weight GGUF shaped like the app's Qwen3.
+//
+// Benchmarks and regression tests need a model, and CI cannot download a
+// multi-GB one. This writes a few-MB file with the same architecture ("qwen3":
+// GQA with q/k norms, SwiGLU FFN, tied embeddings, 128-dim heads), the same
+// tokenizer shape (byte-level BPE with the qwen2 pre-tokenizer, ChatML control
+// tokens, <think> tags) and Q4_K_M-style quantization, so the engine runs the
+// same graph and kernels it runs on the phone — only smaller. Output is noise.
+//
+//   tiny_gguf --out tiny-qwen3.gguf [--layers 4] [--embd 256] [--merges 512]
+//             [--type q4_k_m|q4_0|q8_0|f32] [--seed 42]
+//
+// The BPE merges are learned from a built-in English corpus, so ordinary text
+// tokenizes into multi-byte pieces as with the real vocab. Control tokens get
+// all-zero embedding rows: with tied embeddings their logit is always 0, so
+// greedy decoding never ends a reply early and every run decodes maxTokens.
+// The same arguments always produce the same file.
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "ggml.h"
+#include "gguf.h"
+
+namespace {
+
+struct Options {
+    std::string out;
+    int         layers   = 4;
+    int         embd     = 256;      // multiple of 256 (k-quant block)
+    int         heads    = 4;
+    int         headsKv  = 1;        // 4:1 GQA, as Qwen3-4B
+    int         headDim  = 128;
+    int         ff       = 768;
+    int         merges   = 512;
+    std::string type     = "q4_k_m";
+    uint32_t    seed     = 42;
+};
+
+// ─── Tokenizer ──────────────────────────────────────────────────────────────
+
+const char* kCorpus =
+    "hey are we still on for dinner tonight? thinking 7 at the thai place. "
+    "Did you get the package I sent? Not yet, should be here Friday. Ok let me know when it arrives. "
+    "Hi this is Sam from the dentist office confirming your cleaning Tuesday at 10:30am. "
+    "Reply C to confirm or call us to reschedule. Thanks, see you then! "
+    "Are you free for lunch on Thursday? There's a new ramen place near the office. "
+    "Noon works best for me. Please confirm the owners and expected dates for the rollout, "
+    "and flag any blockers that would push the launch past the end of the month. "
+    "Our records show your invoice is now past due. Please arrange payment at your earliest "
+    "convenience or reply to this message if you believe this is an error. "
+    "You are an AI personal assistant. Reply to a text message. Be concise and natural. "
+    "Do NOT add a signature. Reply with message text only. You reply to emails. "
+    "Follow any IMPORTANT instruction given for the sender. Be professional and natural. "
+    "Return ONLY valid JSON with no extra text. how many unread emails, list my unread emails, "
+    "check my inbox, show emails from amazon, delete that email from john, mark emails as read, "
+    "label amazon emails as shopping, unsubscribe from newsletters, empty trash, text mom I'll "
+    "be late, what's Sarah's number, always reply formally to John, when texting Mom be casual. "
+    "{\"action\":\"send_sms\",\"target\":\"mom\",\"content\":\"I'll be late\",\"query\":null} "
+    "The meeting has been moved to 3pm tomorrow. Can you send me the report by the end of the day? "
+    "I will be out of the office next week with limited access to email. "
+    "Thank you for your order. Your package has shipped and will arrive in 3-5 business days.";
+
+// GPT-2 byte-level encoding: every byte maps to one printable code point.
+std::vector<std::string> byteSymbols() {
+    std::vector<int> cps(256, -1);
+    for (int b = 0; b < 256; b++) {
+        if ((b >= 33 && b <= 126) || (b >= 161 && b <= 172) || (b >= 174 && b <= 255)) cps[b] = b;
+    }
+    int next = 256;
+    for (int b = 0; b < 256; b++) {
+        if (cps[b] < 0) cps[b] = next++;
+    }
+    std::vector<std::string> out(256);
+    for (int b = 0; b < 256; b++) {
+        const int cp = cps[b];
+        std::string& s = out[b];
+        if (cp < 0x80) {
+            s += (char)cp;
+        } else {
+            s += (char)(0xC0 | (cp >> 6));
+            s += (char)(0x80 | (cp & 0x3F));
+        }
+    }
+    return out;
+}
+
+// Rough stand-in for the qwen2 pre-tokenizer: a word is an optional leading
+// space plus a run of letters, a single digit, or a run of punctuation.
+std::vector<std::string> preTokenize(const std::string& text) {
+    std::vector<std::string> words;
+    size_t i = 0;
+    while (i < text.size()) {
+        size_t j = i;
+        if (text[j] == ' ' && j + 1 < text.size() && text[j + 1] != ' ') j++;
+        const unsigned char c = text[j];
+        size_t k = j + 1;
+        if (isalpha(c)) {
+            while (k < text.size() && isalpha((unsigned char)text[k])) k++;
+        } else if (!isdigit(c) && c != ' ') {
+            while (k < text.size() && ispunct((unsigned char)text[k])) k++;
+        }
+        words.push_back(text.substr(i, k - i));
+        i = k;
+    }
+    return words;
+}
+
+struct Vocab {
+    std::vector<std::string> tokens;
+    std::vector<int32_t>     types;       // llama_token_type
+    std::vector<std::string> merges;
+};
+
+constexpr int32_t kTypeNormal      = 1;
+constexpr int32_t kTypeControl     = 3;
+constexpr int32_t kTypeUserDefined = 4;
+
+// Byte tokens, then one token per learned merge, then the special tokens.
+Vocab buildVocab(int nMerges) {
+    const std::vector<std::string> bytes = byteSymbols();
+    Vocab v;
+    for (int b = 0; b < 256; b++) {
+        v.tokens.push_back(bytes[b]);
+        v.types.push_back(kTypeNormal);
+    }
+
+    std::map<std::string, int> wordCounts;
+    for (const std::string& w : preTokenize(kCorpus)) wordCounts[w]++;
+    std::vector<std::pair<std::vector<std::string>, int>> words;
+    for (const auto& [w, n] : wordCounts) {
+        std::vector<std::string> syms;
+        for (unsigned char c : w) syms.push_back(bytes[c]);
+        words.push_back({std::move(syms), n});
+    }
+
+    std::set<std::string> known(v.tokens.begin(), v.tokens.end());
+    for (int m = 0; m < nMerges; m++) {
+        std::map<std::pair<std::string, std::string>, int> pairs;
+        for (const auto& [syms, n] : words) {
+            for (size_t i = 0; i + 1 < syms.size(); i++) pairs[{syms[i], syms[i + 1]}] += n;
+        }
+        if (pairs.empty()) break;
+        // Most frequent pair; std::map order breaks ties deterministically.
+        auto best = pairs.begin();
+        for (auto it = pairs.begin(); it != pairs.end(); ++it) {
+            if (it->second > best->second) best = it;
+        }
+        const auto [a, b] = best->first;
+        v.merges.push_back(a + " " + b);
+        if (known.insert(a + b).second) {    // "ab"+"c" and "a"+"bc" are one token
+            v.tokens.push_back(a + b);
+            v.types.push_back(kTypeNormal);
+        }
+        for (auto& [syms, n] : words) {
+            std::vector<std::string> merged;
+            for (size_t i = 0; i < syms.size(); i++) {
+                if (i + 1 < syms.size() && syms[i] == a && syms[i + 1] == b) {
+                    merged.push_back(a + b);
+                    i++;
+                } else {
+                    merged.push_back(syms[i]);
+                }
+            }
+            syms = std::move(merged);
+        }
+    }
+
+    for (const char* s : {"<|endoftext|>", "<|im_start|>", "<|im_end|>"}) {
+        v.tokens.push_back(s);
+        v.types.push_back(kTypeControl);
+    }
+    for (const char* s : {"<think>", "</think>"}) {
+        v.tokens.push_back(s);
+        v.types.push_back(kTypeUserDefined);
+    }
+    return v;
+}
+
+int32_t tokenId(const Vocab& v, const char* text) {
+    return (int32_t)(std::find(v.tokens.begin(), v.tokens.end(), text) - v.tokens.begin());
+}
+
+// ─── Weights ────────────────────────────────────────────────────────────────
+
+struct TensorSpec {
+    std::string name;
+    int64_t     ne0;
+    int64_t     ne1;       // 1 for vectors
+    ggml_type   type;
+};
+
+// Q4_K_M keeps attn_v, ffn_down and the (tied) embedding at Q6_K.
+ggml_type matrixType(const std::string& preset, const std::string& name) {
+    if (preset == "f32")  return GGML_TYPE_F32;
+    if (preset == "q8_0") return GGML_TYPE_Q8_0;
+    if (preset == "q4_0") return GGML_TYPE_Q4_0;
+    const bool sensitive = name.find("attn_v") != std::string::npos ||
+                           name.find("ffn_down") != std::string::npos ||
+                           name == "token_embd.weight";
+    return sensitive ? GGML_TYPE_Q6_K : GGML_TYPE_Q4_K;
+}
+
+std::vector<TensorSpec> tensorSpecs(const Options& o, int64_t nVocab) {
+    const int64_t qDim  = (int64_t)o.heads   * o.headDim;
+    const int64_t kvDim = (int64_t)o.headsKv * o.headDim;
+    std::vector<TensorSpec> specs;
+    auto matrix = [&](const std::string& name, int64_t ne0, int64_t ne1) {
+        specs.push_back({name, ne0, ne1, matrixType(o.type, name)});
+    };
+    auto norm = [&](const std::string& name, int64_t ne0) {
+        specs.push_back({name, ne0, 1, GGML_TYPE_F32});
+    };
+
+    matrix("token_embd.weight", o.embd, nVocab);
+    norm("output_norm.weight", o.embd);
+    for (int l = 0; l < o.layers; l++) {
+        const std::string p = "blk." + std::to_string(l) + ".";
+        norm(p + "attn_norm.weight",   o.embd);
+        matrix(p + "attn_q.weight",      o.embd, qDim);
+        matrix(p + "attn_k.weight",      o.embd, kvDim);
+        matrix(p + "attn_v.weight",      o.embd, kvDim);
+        matrix(p + "attn_output.weight", qDim,   o.embd);
+        norm(p + "attn_q_norm.weight", o.headDim);
+        norm(p + "attn_k_norm.weight", o.headDim);
+        norm(p + "ffn_norm.weight",    o.embd);
+        matrix(p + "ffn_gate.weight",    o.embd, o.ff);
+        matrix(p + "ffn_up.weight",      o.embd, o.ff);
+        matrix(p + "ffn_down.weight",    o.ff,   o.embd);
+    }
+    return specs;
+}
+
+bool parseArgs(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!v) return false;
+        i++;
+        if      (!strcmp(a, "--out"))    o.out    = v;
+        else if (!strcmp(a, "--type"))   o.type   = v;
+        else if (!strcmp(a, "--layers")) o.layers = atoi(v);
+        else if (!strcmp(a, "--embd"))   o.embd   = atoi(v);
+        else if (!strcmp(a, "--merges")) o.merges = atoi(v);
+        else if (!strcmp(a, "--seed"))   o.seed   = (uint32_t)strtoul(v, nullptr, 10);
+        else return false;
+    }
+    const bool knownType = o.type == "q4_k_m" || o.type == "q4_0" || o.type == "q8_0" ||
+                           o.type == "f32";
+    return !o.out.empty() && knownType && o.layers > 0 && o.embd > 0 && o.embd % 256 == 0 &&
+           o.merges >= 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options o;
+    if (!parseArgs(argc, argv, o)) {
+        fprintf(stderr, "usage: %s --out FILE [--layers N] [--embd N (multiple of 256)] "
+                        "[--merges N] [--type q4_k_m|q4_0|q8_0|f32] [--seed N]\n", argv[0]);
+        return 2;
+    }
+
+    const Vocab vocab = buildVocab(o.merges);
+    const int64_t nVocab = (int64_t)vocab.tokens.size();
+    const std::vector<TensorSpec> specs = tensorSpecs(o, nVocab);
+
+    gguf_context* gguf = gguf_init_empty();
+    gguf_set_val_str(gguf, "general.architecture", "qwen3");
+    gguf_set_val_str(gguf, "general.name", "tiny-qwen3-random");
+    gguf_set_val_u32(gguf, "general.quantization_version", 2);
+    gguf_set_val_u32(gguf, "qwen3.context_length", 40960);
+    gguf_set_val_u32(gguf, "qwen3.embedding_length", o.embd);
+    gguf_set_val_u32(gguf, "qwen3.feed_forward_length", o.ff);
+    gguf_set_val_u32(gguf, "qwen3.block_count", o.layers);
+    gguf_set_val_u32(gguf, "qwen3.attention.head_count", o.heads);
+    gguf_set_val_u32(gguf, "qwen3.attention.head_count_kv", o.headsKv);
+    gguf_set_val_u32(gguf, "qwen3.attention.key_length", o.headDim);
+    gguf_set_val_u32(gguf, "qwen3.attention.value_length", o.headDim);
+    gguf_set_val_f32(gguf, "qwen3.attention.layer_norm_rms_epsilon", 1e-6f);
+    gguf_set_val_f32(gguf, "qwen3.rope.freq_base", 1000000.0f);
+
+    std::vector<const char*> tokenPtrs, mergePtrs;
+    for (const auto& t : vocab.tokens) tokenPtrs.push_back(t.c_str());
+    for (const auto& m : vocab.merges) mergePtrs.push_back(m.c_str());
+    gguf_set_val_str(gguf, "tokenizer.ggml.model", "gpt2");
+    gguf_set_val_str(gguf, "tokenizer.ggml.pre", "qwen2");
+    gguf_set_arr_str(gguf, "tokenizer.ggml.tokens", tokenPtrs.data(), tokenPtrs.size());
+    gguf_set_arr_data(gguf, "tokenizer.ggml.token_type", GGUF_TYPE_INT32, vocab.types.data(),
+                      vocab.types.size());
+    gguf_set_arr_str(gguf, "tokenizer.ggml.merges", mergePtrs.data(), mergePtrs.size());
+    gguf_set_val_u32(gguf, "tokenizer.ggml.bos_token_id", tokenId(vocab, "<|endoftext|>"));
+    gguf_set_val_u32(gguf, "tokenizer.ggml.eos_token_id", tokenId(vocab, "<|im_end|>"));
+    gguf_set_val_u32(gguf, "tokenizer.ggml.padding_token_id", tokenId(vocab, "<|endoftext|>"));
+    gguf_set_val_bool(gguf, "tokenizer.ggml.add_bos_token", false);
+    gguf_set_val_str(gguf, "tokenizer.chat_template",
+        "{% for message in messages %}{{'<|im_start|>' + message['role'] + '\n' + "
+        "message['content'] + '<|im_end|>' + '\n'}}{% endfor %}"
+        "{% if add_generation_prompt %}{{ '<|im_start|>assistant\n' }}{% endif %}");
+
+    size_t dataBytes = 0;
+    for (const TensorSpec& s : specs) dataBytes += ggml_row_size(s.type, s.ne0) * s.ne1;
+    ggml_init_params ip = {dataBytes + specs.size() * (ggml_tensor_overhead() + 64), nullptr, false};
+    ggml_context* ctx = ggml_init(ip);
+    if (!ctx) {
+        fprintf(stderr, "ggml_init failed (%zu bytes)\n", ip.mem_size);
+        gguf_free(gguf);
+        return 1;
+    }
+
+    std::mt19937 rng(o.seed);
+    std::normal_distribution<float> normal(0.0f, 0.02f);
+    std::vector<float> values;
+    for (const TensorSpec& s : specs) {
+        ggml_tensor* t = s.ne1 == 1 ? ggml_new_tensor_1d(ctx, s.type, s.ne0)
+                                    : ggml_new_tensor_2d(ctx, s.type, s.ne0, s.ne1);
+        ggml_set_name(t, s.name.c_str());
+
+        values.assign((size_t)(s.ne0 * s.ne1), 0.0f);
+        const bool norm = s.name.find("norm") != std::string::npos;
+        for (float& x : values) x = norm ? 1.0f : normal(rng);
+        if (s.name == "token_embd.weight") {
+            for (int64_t row = 0; row < nVocab; row++) {
+                if (vocab.types[row] == kTypeNormal) continue;
+                std::fill_n(values.begin() + row * s.ne0, s.ne0, 0.0f);
+            }
+        }
+
+        if (s.type == GGML_TYPE_F32) {
+            memcpy(ggml_get_data(t), values.data(), values.size() * sizeof(float));
+        } else {
+            ggml_quantize_chunk(s.type, values.data(), ggml_get_data(t), 0, s.ne1, s.ne0, nullptr);
+        }
+        gguf_add_tensor(gguf, t);
+    }
+
+    const bool ok = gguf_write_to_file(gguf, o.out.c_str(), false);
+    if (ok) {
+        fprintf(stderr, "%s: qwen3, %d layers, n_embd %d, n_vocab %lld (%zu merges), %s, %.1f MiB\n",
+                o.out.c_str(), o.layers, o.embd, (long long)nVocab, vocab.merges.size(),
+                o.type.c_str(), dataBytes / 1048576.0);
+    } else {
+        fprintf(stderr, "failed to write %s\n", o.out.c_str());
+    }
+    ggml_free(ctx);
+    gguf_free(gguf);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,286 @@
+// chat_prompt.cpp — see chat_prompt.h.
+
+#define LOG_TAG "ChatPrompt"
+#include "chat_prompt.h"
+#include "aigentik_log.h"
+#include "generation.h"
+#include "hash_util.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Segments kept tokenized. System prompts, personas and assistant headers are few;
+// per-message bodies churn through and are evicted least-recently-used first.
+constexpr size_t MAX_SEGMENTS = 64;
+
+// Distinguishes the prompt's first segment (tokenized with BOS) from the same
+// text appearing later in a prompt.
+constexpr uint64_t FIRST_SEGMENT_SALT = 0x9E3779B97F4A7C15ULL;
+
+// Stand-ins for message content while segments() finds the segment boundaries —
+// U+E004 / U+E005 (private use) in UTF-8 around the message index.
+constexpr const char* PLACEHOLDER_BEGIN = "\xEE\x80\x84";
+constexpr const char* PLACEHOLDER_END   = "\xEE\x80\x85";
+
+// Re-fit rounds. Re-tokenizing at the cut points and the omission marker shift
+// the count by a few tokens, so a round can land slightly over the limit.
+constexpr int FIT_ROUNDS = 6;
+constexpr int FIT_SLACK  = 8;     // extra tokens cut per retry round
+
+// One truncatable span of message content.
+struct Span {
+    std::vector<llama_token> tokens;
+    int                      keep;   // tokens of it to keep
+};
+
+// Message content split at span delimiters: literal text around span indices.
+struct Piece {
+    std::string text;
+    int         span = -1;           // >= 0: index into the span list
+};
+
+std::vector<Piece> splitSpans(const std::string& content, std::vector<std::string>& spanText) {
+    std::vector<Piece> pieces;
+    const size_t beginLen = std::strlen(TRUNCATE_BEGIN);
+    const size_t endLen   = std::strlen(TRUNCATE_END);
+    size_t at = 0;
+    while (at < content.size()) {
+        const size_t b = content.find(TRUNCATE_BEGIN, at);
+        if (b == std::string::npos) break;
+        size_t e = content.find(TRUNCATE_END, b + beginLen);
+        if (e == std::string::npos) e = content.size();
+        if (b > at) pieces.push_back({content.substr(at, b - at)});
+        Piece p;
+        p.span = (int)spanText.size();
+        spanText.push_back(content.substr(b + beginLen, e - b - beginLen));
+        pieces.push_back(p);
+        at = std::min(content.size(), e + endLen);
+    }
+    if (at < content.size()) pieces.push_back({content.substr(at)});
+    return pieces;
+}
+
+// Span text with only span.keep tokens left: head, omission marker, tail.
+std::string cutSpan(const llama_vocab* vocab, const Span& span) {
+    const size_t n = span.tokens.size();
+    const size_t keep = (size_t)std::max(span.keep, 0);
+    if (keep >= n) return detokenize(vocab, span.tokens, 0, n);
+    const size_t tail = keep / 3;
+    const size_t head = keep - tail;
+    return detokenize(vocab, span.tokens, 0, head) +
+           "\n[... " + std::to_string(n - keep) + " tokens omitted ...]\n" +
+           detokenize(vocab, span.tokens, n - tail, n);
+}
+
+// text is one control or user-defined token of vocab, not ordinary text.
+bool isSpecialToken(const llama_vocab* vocab, const char* text) {
+    llama_token tok[2];
+    const int n = llama_tokenize(vocab, text, (int32_t)std::strlen(text), tok, 2, false, true);
+    return n == 1 &&
+           (llama_vocab_get_attr(vocab, tok[0]) & (LLAMA_TOKEN_ATTR_CONTROL | LLAMA_TOKEN_ATTR_USER_DEFINED));
+}
+
+} // namespace
+
+void ChatPrompt::reset(const llama_model* model) {
+    model_ = model;
+    vocab_ = model ? llama_model_get_vocab(model) : nullptr;
+    cache_.clear();
+    hits_ = misses_ = 0;
+    tmpl_.clear();
+    builtinFallback_ = false;
+    thinkTokens_ = false;
+    if (!model) return;
+    thinkTokens_ = isSpecialToken(vocab_, "<think>") && isSpecialToken(vocab_, "</think>");
+
+    const char* t = llama_model_chat_template(model, nullptr);
+    if (t) tmpl_ = t;
+
+    // llama_chat_apply_template only understands the built-in template families;
+    // a GGUF with no template or an unrecognised Jinja one gets ChatML.
+    llama_chat_message probe{"user", "x"};
+    if (tmpl_.empty() ||
+        llama_chat_apply_template(tmpl_.c_str(), &probe, 1, true, nullptr, 0) < 0) {
+        LOGW("Model chat template %s — falling back to ChatML",
+             tmpl_.empty() ? "missing" : "not supported");
+        tmpl_ = "chatml";
+        builtinFallback_ = true;
+    }
+}
+
+std::string ChatPrompt::apply(const std::vector<llama_chat_message>& chat,
+                              bool addAssistant) const {
+    std::string buf(1024, '\0');
+    int32_t n = llama_chat_apply_template(tmpl_.c_str(), chat.data(), chat.size(),
+                                          addAssistant, &buf[0], (int32_t)buf.size());
+    if (n < 0) return {};
+    if ((size_t)n > buf.size()) {
+        buf.resize(n);
+        n = llama_chat_apply_template(tmpl_.c_str(), chat.data(), chat.size(),
+                                      addAssistant, &buf[0], (int32_t)buf.size());
+        if (n < 0) return {};
+    }
+    buf.resize(n);
+    return buf;
+}
+
+std::string ChatPrompt::render(const std::vector<ChatMessage>& msgs, bool addAssistant) const {
+    std::vector<llama_chat_message> chat;
+    chat.reserve(msgs.size());
+    for (const auto& m : msgs) chat.push_back({m.role.c_str(), m.content.c_str()});
+    return apply(chat, addAssistant);
+}
+
+const std::vector<llama_token>& ChatPrompt::segmentTokens(const std::string& text, bool first) {
+    const uint64_t key = fnv1a64(text) ^ (first ? FIRST_SEGMENT_SALT : 0);
+    auto it = cache_.find(key);
+    if (it != cache_.end() && it->second.text == text) {
+        hits_++;
+        it->second.lastUse = ++clock_;
+        return it->second.tokens;
+    }
+    misses_++;
+
+    if (it == cache_.end() && cache_.size() >= MAX_SEGMENTS) {
+        auto oldest = cache_.begin();
+        for (auto c = cache_.begin(); c != cache_.end(); ++c) {
+            if (c->second.lastUse < oldest->second.lastUse) oldest = c;
+        }
+        cache_.erase(oldest);
+    }
+    Segment& seg = cache_[key];      // replaces a colliding entry in place
+    seg.text    = text;
+    seg.tokens  = tokenize(vocab_, text, first);
+    seg.lastUse = ++clock_;
+    return seg.tokens;
+}
+
+// Segment i is what rendering messages [0, i] adds to rendering [0, i-1]; the last
+// one, with addAssistant, is the assistant header. The boundaries come from
+// rendering the conversation prefix by prefix with every content replaced by a
+// short placeholder, which is then swapped back for the content — so long bodies are
+// copied once, not once per later message. That holds for append-only templates
+// that pass content through unchanged (ChatML and most others), checked against one
+// full rendering; for any other template this returns nothing.
+std::vector<std::string> ChatPrompt::segments(const std::vector<ChatMessage>& msgs,
+                                              bool addAssistant) const {
+    const size_t n = msgs.size();
+    std::vector<std::string> marks(n);
+    std::vector<llama_chat_message> skeleton(n);
+    for (size_t i = 0; i < n; i++) {
+        marks[i]    = PLACEHOLDER_BEGIN + std::to_string(i) + PLACEHOLDER_END;
+        skeleton[i] = {msgs[i].role.c_str(), marks[i].c_str()};
+    }
+
+    std::vector<std::string> out;
+    std::string prev;
+    for (size_t i = 1; i <= n + (addAssistant ? 1 : 0); i++) {
+        const bool header = i > n;
+        const size_t count = header ? n : i;
+        const std::vector<llama_chat_message> head(skeleton.begin(), skeleton.begin() + count);
+        std::string cur = apply(head, header);
+        if (cur.empty() || cur.compare(0, prev.size(), prev) != 0) return {};
+        out.push_back(cur.substr(prev.size()));
+        prev = std::move(cur);
+    }
+
+    std::string joined;
+    for (size_t i = 0; i < out.size(); i++) {
+        if (i < n) {
+            const size_t at = out[i].find(marks[i]);
+            if (at == std::string::npos) return {};    // content moved to another turn
+            out[i].replace(at, marks[i].size(), msgs[i].content);
+        }
+        joined += out[i];
+    }
+    if (joined != render(msgs, addAssistant)) return {};
+    return out;
+}
+
+std::vector<llama_token> ChatPrompt::build(const std::vector<ChatMessage>& msgs,
+                                           const std::string& assistantPrefill,
+                                           bool addAssistant) {
+    TRACE_SCOPE("chat_template");
+    std::vector<llama_token> out;
+    if (!vocab_ || msgs.empty()) return out;
+
+    // Per-message segments; a template segments() cannot split is tokenized as a
+    // single segment instead.
+    std::vector<std::string> parts = segments(msgs, addAssistant);
+    if (parts.empty()) {
+        std::string full = render(msgs, addAssistant);
+        if (full.empty()) {
+            LOGE("Chat template failed to render %zu messages", msgs.size());
+            return out;
+        }
+        parts.push_back(std::move(full));
+    }
+
+    bool first = true;    // the first non-empty segment carries BOS
+    for (const std::string& part : parts) {
+        if (part.empty()) continue;
+        const auto& toks = segmentTokens(part, first);
+        out.insert(out.end(), toks.begin(), toks.end());
+        first = false;
+    }
+
+    if (!assistantPrefill.empty()) {
+        const auto& toks = segmentTokens(assistantPrefill, false);
+        out.insert(out.end(), toks.begin(), toks.end());
+    }
+    return out;
+}
+
+std::vector<llama_token> ChatPrompt::buildFitted(const std::vector<ChatMessage>& msgs,
+                                                 const std::string& assistantPrefill,
+                                                 int maxPromptTokens, int spanBudget) {
+    if (!vocab_) return {};
+
+    std::vector<std::string>        spanText;
+    std::vector<std::vector<Piece>> pieces;
+    pieces.reserve(msgs.size());
+    for (const auto& m : msgs) pieces.push_back(splitSpans(m.content, spanText));
+
+    std::vector<Span> spans(spanText.size());
+    for (size_t i = 0; i < spans.size(); i++) {
+        spans[i].tokens = tokenize(vocab_, spanText[i], false);
+        spans[i].keep   = (int)spans[i].tokens.size();
+        if (spanBudget > 0) spans[i].keep = std::min(spans[i].keep, spanBudget);
+    }
+
+    std::vector<ChatMessage> fitted(msgs.size());
+    for (int round = 0; round < FIT_ROUNDS; round++) {
+        for (size_t m = 0; m < msgs.size(); m++) {
+            fitted[m].role = msgs[m].role;
+            fitted[m].content.clear();
+            for (const Piece& p : pieces[m]) {
+                if (p.span < 0) { fitted[m].content += p.text; continue; }
+                const Span& sp = spans[p.span];
+                fitted[m].content += sp.keep >= (int)sp.tokens.size()
+                                     ? spanText[p.span] : cutSpan(vocab_, sp);
+            }
+        }
+
+        std::vector<llama_token> out = build(fitted, assistantPrefill);
+        if (out.empty() || maxPromptTokens <= 0 || (int)out.size() <= maxPromptTokens) {
+            if (round > 0) LOGI("Prompt fitted to %zu tokens (limit %d)", out.size(), maxPromptTokens);
+            return out;
+        }
+
+        // Spread the excess over the spans in proportion to what each still keeps.
+        const int excess = (int)out.size() - maxPromptTokens + round * FIT_SLACK;
+        int kept = 0;
+        for (const Span& sp : spans) kept += sp.keep;
+        if (kept == 0) break;
+        for (Span& sp : spans) {
+            const int cut = (int)(((int64_t)excess * sp.keep + kept - 1) / kept);
+            sp.keep = std::max(0, sp.keep - cut);
+        }
+    }
+
+    LOGE("Prompt does not fit %d tokens even with every truncatable span cut", maxPromptTokens);
+    return {};
+}
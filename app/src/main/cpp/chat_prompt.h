@@ -0,0 +1,91 @@
+// chat_prompt.h — model-native chat prompt assembly with a segment token cache.
+//
+// Messages are rendered with the loaded model's own chat template
+// (llama_model_chat_template + llama_chat_apply_template; ChatML if the GGUF has
+// none). The rendered prompt is split into segments — the text each message adds
+// to the rendering, plus the assistant header — and every segment is tokenized on
+// its own through a hash-keyed cache. A system prompt or persona that did not
+// change since the last call is therefore never re-tokenized.
+//
+// buildFitted() additionally shortens marked spans of message content (e.g. an
+// email body) to a token budget, keeping their head and tail around an omission
+// marker, so the prompt fits a caller-given limit.
+//
+// Not thread-safe: owned by the engine and used under its generation lock.
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "llama.h"
+
+struct ChatMessage {
+    std::string role;      // "system", "user" or "assistant"
+    std::string content;
+};
+
+// Delimiters of a truncatable span inside ChatMessage::content — U+E000 / U+E001
+// (private use) in UTF-8. An unterminated span runs to the end of the content.
+constexpr const char* TRUNCATE_BEGIN = "\xEE\x80\x80";
+constexpr const char* TRUNCATE_END   = "\xEE\x80\x81";
+
+// An empty think block as assistant prefill: a reasoning model (hasThinkTokens())
+// sees its reasoning already closed and answers directly.
+constexpr const char* EMPTY_THINK_PREFILL = "<think>\n\n</think>\n";
+
+class ChatPrompt {
+public:
+    // Binds to model (nullptr = unbound) and drops all cached segments.
+    void reset(const llama_model* model);
+
+    // Renders msgs, appends the assistant header when addAssistant is set, then
+    // assistantPrefill verbatim (e.g. an empty <think></think> block), and returns
+    // the prompt tokens. Empty on template or tokenizer failure.
+    std::vector<llama_token> build(const std::vector<ChatMessage>& msgs,
+                                   const std::string& assistantPrefill = "",
+                                   bool addAssistant = true);
+
+    // build() with truncatable spans resolved: each span is first cut to spanBudget
+    // tokens (0 = no per-span cap), then every span is cut further in proportion to
+    // what it keeps — a few rounds — until the prompt is at most maxPromptTokens
+    // (0 = no limit).
+    // A cut span keeps ~2/3 of its budget from the head, ~1/3 from the tail, and
+    // an "[... N tokens omitted ...]" marker in between. Span delimiters are always
+    // removed. Empty if the prompt cannot be made to fit.
+    std::vector<llama_token> buildFitted(const std::vector<ChatMessage>& msgs,
+                                         const std::string& assistantPrefill,
+                                         int maxPromptTokens, int spanBudget);
+
+    // Rendered prompt text for msgs — same layout build() tokenizes.
+    std::string render(const std::vector<ChatMessage>& msgs, bool addAssistant) const;
+
+    const char* templateName() const { return builtinFallback_ ? "chatml (fallback)" : "model"; }
+
+    // <think> and </think> are tokens of their own in the vocab (Qwen3, DeepSeek-R1).
+    bool hasThinkTokens() const { return thinkTokens_; }
+    uint64_t segmentHits()   const { return hits_; }
+    uint64_t segmentMisses() const { return misses_; }
+
+private:
+    struct Segment {
+        std::string              text;
+        std::vector<llama_token> tokens;
+        uint64_t                 lastUse = 0;
+    };
+
+    const std::vector<llama_token>& segmentTokens(const std::string& text, bool first);
+    std::vector<std::string> segments(const std::vector<ChatMessage>& msgs,
+                                      bool addAssistant) const;
+    std::string apply(const std::vector<llama_chat_message>& chat, bool addAssistant) const;
+
+    const llama_model* model_ = nullptr;
+    const llama_vocab* vocab_ = nullptr;
+    std::string        tmpl_;
+    bool               builtinFallback_ = false;
+    bool               thinkTokens_     = false;
+    std::unordered_map<uint64_t, Segment> cache_;
+    uint64_t           clock_  = 0;
+    uint64_t           hits_   = 0;
+    uint64_t           misses_ = 0;
+};
@@ -0,0 +1,1112 @@
+// engine.cpp — see engine.h. Change history of this code up to its extraction is
+// kept at the top of llama_jni.cpp.
+
+#define LOG_TAG "Engine"
+#include "engine.h"
+#include "aigentik_log.h"
+#include "ggml-cpu.h"
+#include "metrics.h"
+#include "summarize.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <sys/stat.h>
+
+// Decode tokens between tok/s samples on the metrics page.
+static const int METRICS_SAMPLE_TOKENS = 16;
+
+// Spare memory a hot swap must leave beyond both models.
+static const int64_t SWAP_HEADROOM = 256ll << 20;
+
+// The generation mutex for one request, tracked on the metrics page: the caller
+// counts in queueDepth while it waits and in activeRequests while it holds it.
+class Engine::GenerationLock {
+public:
+    explicit GenerationLock(Engine& e) : engine_(e) {
+        MetricsPage& m = metrics();
+        m.queueDepth.fetch_add(1, std::memory_order_relaxed);
+        lock_ = std::unique_lock<std::mutex>(e.mutex_);
+        m.queueDepth.fetch_sub(1, std::memory_order_relaxed);
+        m.activeRequests.fetch_add(1, std::memory_order_relaxed);
+        if (e.hasContext()) e.publishState(EngineState::Generating);
+    }
+    ~GenerationLock() {
+        metrics().activeRequests.fetch_sub(1, std::memory_order_relaxed);
+        if (engine_.hasContext()) engine_.publishState(EngineState::Ready);
+        metricsUpdateRss();
+    }
+    GenerationLock(const GenerationLock&) = delete;
+    GenerationLock& operator=(const GenerationLock&) = delete;
+
+private:
+    Engine&                      engine_;
+    std::unique_lock<std::mutex> lock_;
+};
+
+Engine::Engine(const EngineConfig& config) : config_(config) {}
+
+Engine::~Engine() {
+    cancelLoad();
+    std::thread loader;
+    {
+        std::lock_guard<std::mutex> lock(loaderMutex_);
+        loader = std::move(loader_);
+    }
+    if (loader.joinable()) loader.join();
+    unload();
+    if (threadpool_) ggml_threadpool_free(threadpool_);
+}
+
+// One persistent threadpool for decode and batch. Without one the CPU backend
+// starts and joins a throwaway pool for every graph it computes. Created paused —
+// the first graph wakes it — so its workers sleep while the weights load.
+// The workers' hardware counters are opened first: `inherit` (perf_counters.h)
+// only covers threads started after it.
+void Engine::createThreadpool() {
+    TRACE_SCOPE("threadpool_create");
+    auto counters = std::make_unique<PerfCounters>();
+    ggml_threadpool_params tpp = ggml_threadpool_params_default(config_.nThreads);
+    tpp.paused  = true;
+    threadpool_ = ggml_threadpool_new(&tpp);
+    if (!threadpool_) {
+        LOGW("Threadpool creation failed — using per-graph threads");
+        return;
+    }
+    if (counters->available()) poolCounters_ = std::move(counters);
+}
+
+// The pager's touch thread reads the mappings, so it stops before the model goes.
+Engine::Slot::~Slot() {
+    pager.detach();
+    if (ctx)   llama_free(ctx);
+    if (model) llama_model_free(model);
+}
+
+Engine::SlotOptions Engine::slotOptions() const {
+    SlotOptions o;
+    o.weights    = weightsPolicy_;
+    o.hugePages  = hugePages_;
+    o.profileOps = profileOps_;
+    return o;
+}
+
+// (Re)create slot's context (model load / recovery / profiling switch). Between
+// generations the KV cache is cleared in place with llama_memory_clear().
+// Q8_0 KV cache: ~128MB at 8k ctx vs ~512MB F16 — fits comfortably in 6GB RAM
+// attachPool: the engine's threadpool serves one context at a time, so a slot
+// being prepared beside the live one computes with per-graph threads until it
+// takes over.
+bool Engine::createContext(Slot& slot, const SlotOptions& opt, bool attachPool) {
+    TRACE_SCOPE("context_create");
+    if (!slot.model) return false;
+    if (slot.ctx) {
+        llama_free(slot.ctx);
+        slot.ctx = nullptr;
+    }
+    slot.ctxRanges.clear();
+    slot.ctxHuge.clear();
+    llama_context_params cp = llama_context_default_params();
+    cp.n_ctx           = config_.ctxSize;
+    cp.n_batch         = config_.nBatch;
+    cp.n_ubatch        = config_.nBatch;
+    cp.n_threads       = config_.nThreads;
+    cp.n_threads_batch = config_.nThreads;
+    cp.n_seq_max       = config_.nSeqMax;
+    cp.kv_unified      = true;       // one cell pool shared by all sequences
+    cp.no_perf         = false;      // llama_perf_context feeds GenerationStats
+    cp.type_k          = config_.kvType;
+    cp.type_v          = config_.kvType;
+    memoryStatsOnContextCreate(opt.primary ? nullptr : &slot.memory);
+    if (opt.profileOps) {
+        cp.cb_eval           = OpProfiler::evalCallback;
+        cp.cb_eval_user_data = &opProfiler_;
+    }
+    // Of the mappings that appear meanwhile, those sized like the buffers llama.cpp
+    // reports are the context's KV cache and compute buffers: advised for huge
+    // pages here, pre-faulted by warmup(). Other threads' mappings are left alone.
+    const std::vector<MemRange> before = anonMappings();
+    memoryStatsRecordInto(opt.primary ? nullptr : &slot.memory);
+    memoryStatsBeginCapture();
+    slot.ctx = llama_init_from_model(slot.model, cp);
+    const std::vector<int64_t> bufferSizes = memoryStatsEndCapture();
+    memoryStatsRecordInto(nullptr);
+    if (!slot.ctx) {
+        LOGE("Context reset failed");
+        return false;
+    }
+    if (attachPool && threadpool_) llama_attach_threadpool(slot.ctx, threadpool_, nullptr);
+    slot.ctxRanges = bufferRanges(addedRanges(before, anonMappings()), bufferSizes);
+    if (opt.hugePages != HugePageMode::Off) {
+        TRACE_SCOPE("huge_pages");
+        int errors = 0;
+        slot.ctxHuge = adviseHugePages(slot.ctxRanges, opt.hugePages, errors);
+        collapseErrors_.fetch_add(errors, std::memory_order_relaxed);
+    }
+    LOGI("Context reset: ctx=%d batch=%d threads=%d kv=%s%s%s", config_.ctxSize, config_.nBatch,
+         config_.nThreads, ggml_type_name(config_.kvType), opt.profileOps ? " (op profiling)" : "",
+         opt.hugePages != HugePageMode::Off ? " (huge pages)" : "");
+    return true;
+}
+
+bool Engine::resetContext() {
+    return live_ && createContext(*live_, slotOptions(), true);
+}
+
+// Sets the state on the metrics page and republishes the status snapshot from the
+// live model and context. Model metadata is read here, under the generation mutex,
+// so status readers never touch the live slot themselves.
+void Engine::publishStatus(EngineState state) {
+    EngineStatus s;
+    s.state     = state;
+    s.loadCount = loadCount_;
+    s.nThreads  = config_.nThreads;
+    s.nBatch    = config_.nBatch;
+    s.kvType    = config_.kvType;
+    if (s.loaded() && hasContext()) {
+        const llama_model* model = live_->model;
+        s.nVocab     = llama_vocab_n_tokens(llama_model_get_vocab(model));
+        s.nCtxTrain  = llama_model_n_ctx_train(model);
+        s.nLayer     = llama_model_n_layer(model);
+        s.nParams    = (int64_t)llama_model_n_params(model);
+        s.modelBytes = (int64_t)llama_model_size(model);
+        llama_model_desc(model, s.desc, sizeof(s.desc));
+        snprintf(s.templateName, sizeof(s.templateName), "%s", live_->chat.templateName());
+        s.nCtx       = (int)llama_n_ctx(live_->ctx);
+    } else if (s.loaded()) {
+        s.state = EngineState::Error;    // no context to report as ready
+    }
+    status_.publish(s);
+    metricsSetState(s.state);
+}
+
+// Ready <-> Generating around each request: the metadata is unchanged, so only the
+// state of the current snapshot is republished.
+void Engine::publishState(EngineState state) {
+    EngineStatus s = status_.read();
+    s.state = state;
+    status_.publish(s);
+    metricsSetState(state);
+}
+
+bool Engine::load(const std::string& path, const LoadProgressFn& onProgress) {
+    cancelLoad_.store(false, std::memory_order_relaxed);
+    return loadModel(path, onProgress);
+}
+
+bool Engine::loadAsync(const std::string& path, LoadProgressFn onProgress, LoadDoneFn onDone) {
+    std::lock_guard<std::mutex> lock(loaderMutex_);
+    if (loaderBusy_) return false;
+    if (loader_.joinable()) loader_.join();    // finished — reap it
+    loaderBusy_ = true;
+    cancelLoad_.store(false, std::memory_order_relaxed);
+    loader_ = std::thread([this, path, onProgress = std::move(onProgress), onDone = std::move(onDone)] {
+        const bool ok = loadModel(path, onProgress);
+        if (onDone) onDone(ok);
+        std::lock_guard<std::mutex> lock(loaderMutex_);
+        loaderBusy_ = false;
+    });
+    return true;
+}
+
+SwapResult Engine::swapAsync(const std::string& path, LoadProgressFn onProgress, LoadDoneFn onDone) {
+    std::lock_guard<std::mutex> lock(loaderMutex_);
+    if (loaderBusy_) return SwapResult::Busy;
+    {
+        std::shared_lock<std::shared_mutex> modelLock(modelMutex_);
+        if (!live_ || !live_->ctx) return SwapResult::NotLoaded;
+        if (!fitsBesidePrimary(path)) return SwapResult::NoMemory;
+    }
+    if (loader_.joinable()) loader_.join();
+    loaderBusy_ = true;
+    cancelLoad_.store(false, std::memory_order_relaxed);
+    loader_ = std::thread([this, path, onProgress = std::move(onProgress), onDone = std::move(onDone)] {
+        const bool ok = swapModel(path, onProgress);
+        if (onDone) onDone(ok);
+        std::lock_guard<std::mutex> lock(loaderMutex_);
+        loaderBusy_ = false;
+    });
+    return SwapResult::Started;
+}
+
+// Both models must fit at once: the new file (mapped or copied, it ends up resident)
+// and a context the size of the primary one, over what the system has available.
+// The primary's resident file pages count as available page cache, but evicting
+// them would stall the model that keeps serving, so they are taken off.
+bool Engine::fitsBesidePrimary(const std::string& path) const {
+    struct stat st;
+    const int64_t fileBytes = stat(path.c_str(), &st) == 0 ? (int64_t)st.st_size : 0;
+    const MemoryStats m = memoryStatsCollect(live_->model);
+    const int64_t need = fileBytes + m.kvBytes + m.computeBytes + SWAP_HEADROOM;
+    const int64_t available = memoryAvailableBytes() - m.weightsResidentBytes;
+    if (available >= need) return true;
+    LOGW("Refused: %s needs %.0f MiB, %.0f MiB available beside the primary model", path.c_str(),
+         need / (1024.0 * 1024.0), available / (1024.0 * 1024.0));
+    return false;
+}
+
+// llama_progress_callback: called on the loading thread as tensors are read.
+// cancel is cancelLoad_ for the loads cancelLoad() abandons, null otherwise.
+struct Engine::LoadCall {
+    std::atomic<bool>*    cancel;
+    const LoadProgressFn* onProgress;
+};
+
+bool Engine::onLoadProgress(float progress, void* userData) {
+    const LoadCall* call = static_cast<const LoadCall*>(userData);
+    metricsSetLoadProgress(progress);
+    bool go = !call->cancel || !call->cancel->load(std::memory_order_relaxed);
+    if (go && *call->onProgress) go = (*call->onProgress)(progress);
+    if (!go && call->cancel) call->cancel->store(true, std::memory_order_relaxed);
+    return go;
+}
+
+// A new slot with path's weights loaded, their anonymous copies advised for huge
+// pages and the weights policy applied; no context yet. Takes no engine lock.
+// Null if the load failed or was cancelled (cancel set, or onProgress false).
+std::unique_ptr<Engine::Slot> Engine::loadSlot(const std::string& path,
+                                               const LoadProgressFn& onProgress,
+                                               const SlotOptions& opt,
+                                               std::atomic<bool>* cancel) {
+    auto slot = std::make_unique<Slot>();
+    slot->path = path;
+    const std::vector<MemRange> before =
+        opt.hugePages != HugePageMode::Off ? anonMappings() : std::vector<MemRange>();
+
+    memoryStatsInstallLogHook();
+    if (opt.primary) memoryStatsOnModelLoad(path);
+    else slot->memory.modelPath = path;
+    LoadCall call{cancel, &onProgress};
+    std::vector<int64_t> bufferSizes;
+    llama_model_params mp = llama_model_default_params();
+    mp.n_gpu_layers                = 0;
+    mp.use_mmap                    = opt.weights.useMmap;
+    mp.use_mlock                   = opt.weights.useMlock;
+    mp.progress_callback           = onLoadProgress;
+    mp.progress_callback_user_data = &call;
+    {
+        TRACE_SCOPE("model_load");
+        memoryStatsRecordInto(opt.primary ? nullptr : &slot->memory);
+        memoryStatsBeginCapture();
+        slot->model = llama_model_load_from_file(path.c_str(), mp);
+        bufferSizes = memoryStatsEndCapture();
+        memoryStatsRecordInto(nullptr);
+    }
+    if (!slot->model) return nullptr;
+
+    slot->chat.reset(slot->model);
+    if (opt.hugePages != HugePageMode::Off) {
+        // Anonymous weight copies: everything with use_mmap off, repacked tensors otherwise.
+        // Only the new mappings sized like them — another model may be serving meanwhile.
+        int errors = 0;
+        slot->weightsHuge = adviseHugePages(bufferRanges(addedRanges(before, anonMappings()), bufferSizes),
+                                            opt.hugePages, errors);
+        collapseErrors_.fetch_add(errors, std::memory_order_relaxed);
+    }
+    if (opt.weights.useMmap) slot->pager.attach(path);
+    applyWeightsPolicy(*slot, opt.weights);
+    return slot;
+}
+
+bool Engine::loadModel(const std::string& path, const LoadProgressFn& onProgress) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    LOGI("Loading model: %s", path.c_str());
+
+    std::unique_lock<std::shared_mutex> modelLock(modelMutex_);
+    publishStatus(EngineState::Loading);
+    metricsSetLoadProgress(0);
+    metrics().kvCellsTotal.store(0, std::memory_order_relaxed);
+    metricsSetKvCells(0);
+
+    // Saved KV state belongs to the outgoing model.
+    dropPrimarySessions();
+    live_.reset();
+
+    // The threadpool does not depend on the model, so the first load starts it
+    // alongside the weights rather than after them — unless huge pages are on: the
+    // mappings that appear during the load are advised, and its thread stacks must
+    // not be among them.
+    std::thread poolThread;
+    if (!threadpool_ && hugePages_ != HugePageMode::Off) createThreadpool();
+    if (!threadpool_) poolThread = std::thread([this] { createThreadpool(); });
+    const SlotOptions opt = slotOptions();
+    std::unique_ptr<Slot> slot = loadSlot(path, onProgress, opt, &cancelLoad_);
+    if (poolThread.joinable()) poolThread.join();
+
+    metricsUpdateRss();
+    if (!slot) {
+        if (cancelLoad_.load(std::memory_order_relaxed)) {
+            LOGI("Model load cancelled");
+            publishStatus(EngineState::NotLoaded);
+        } else {
+            LOGE("Model load failed");
+            publishStatus(EngineState::Error);
+        }
+        return false;
+    }
+    live_ = std::move(slot);
+    if (!createContext(*live_, opt, true)) {
+        publishStatus(EngineState::Error);
+        return false;
+    }
+
+    metrics().kvCellsTotal.store(llama_n_ctx(live_->ctx), std::memory_order_relaxed);
+    metricsSetLoadProgress(1);
+    loadCount_++;
+    publishStatus(EngineState::Ready);
+    LOGI("Model ready — ctx=%d kv=%s threads=%d", config_.ctxSize,
+         ggml_type_name(config_.kvType), config_.nThreads);
+    return true;
+}
+
+// The loader thread's half of swapAsync(). Everything up to the switch runs beside
+// the live model; a failure anywhere leaves it serving.
+bool Engine::swapModel(const std::string& path, const LoadProgressFn& onProgress) {
+    TRACE_SCOPE("model_swap");
+    LOGI("Swapping in model: %s", path.c_str());
+    SlotOptions opt;
+    uint64_t loads = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::shared_lock<std::shared_mutex> modelLock(modelMutex_);
+        opt   = slotOptions();
+        loads = loadCount_;
+    }
+    opt.profileOps = false;    // the profiler and memory stats describe the
+    opt.primary    = false;    // serving model until the switch
+    metricsSetLoadProgress(0);
+    std::unique_ptr<Slot> next = loadSlot(path, onProgress, opt, &cancelLoad_);
+    metricsSetLoadProgress(1);
+    if (!next) {
+        if (cancelLoad_.load(std::memory_order_relaxed)) LOGI("Swap cancelled — old model keeps serving");
+        else LOGE("Swap failed: model load failed — old model keeps serving");
+        return false;
+    }
+    if (!createContext(*next, opt, false) || !warmSlot(*next, nullptr).ok) {
+        LOGE("Swap failed: context not ready — old model keeps serving");
+        return false;
+    }
+
+    std::unique_ptr<Slot> old;
+    {
+        // Waits for the request in flight; requests queued behind it get the new model.
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_lock<std::shared_mutex> modelLock(modelMutex_);
+        if (!live_ || loadCount_ != loads) {
+            LOGW("Swap abandoned: the model was unloaded or replaced meanwhile");
+            return false;
+        }
+        old   = std::move(live_);
+        live_ = std::move(next);
+        memoryStatsCommit(live_->memory);
+        // Settings changed during the swap apply to the context now.
+        const SlotOptions now = slotOptions();
+        bool ok = true;
+        if (now.profileOps != opt.profileOps || now.hugePages != opt.hugePages) {
+            ok = createContext(*live_, now, true);
+        } else if (threadpool_) {
+            llama_attach_threadpool(live_->ctx, threadpool_, nullptr);
+        }
+        dropPrimarySessions();    // saved KV state belongs to the outgoing model
+        metrics().kvCellsTotal.store(ok ? llama_n_ctx(live_->ctx) : 0, std::memory_order_relaxed);
+        metricsSetKvCells(0);
+        loadCount_++;
+        publishStatus(ok ? EngineState::Ready : EngineState::Error);
+    }
+    const auto t = std::chrono::steady_clock::now();
+    const std::string oldPath = old->path;
+    old.reset();
+    metricsUpdateRss();
+    LOGI("Swapped to %s; freed %s in %.0f ms", path.c_str(), oldPath.c_str(), elapsedMs(t));
+    return true;
+}
+
+// Like swapModel() up to the switch, but the slot joins the registry instead of
+// replacing the primary. Runs on the caller's thread.
+bool Engine::addModel(const std::string& name, const std::string& path) {
+    if (name.empty() || name.find(SESSION_NS) != std::string::npos) return false;
+    TRACE_SCOPE("model_add");
+    LOGI("Adding model \"%s\": %s", name.c_str(), path.c_str());
+    SlotOptions opt;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::shared_lock<std::shared_mutex> modelLock(modelMutex_);
+        if (live_ && !fitsBesidePrimary(path)) return false;
+        opt = slotOptions();
+    }
+    opt.profileOps = false;    // the profiler, memory stats and warm-up stats
+    opt.primary    = false;    // describe the primary model
+    // Not cancellable: cancelLoad() belongs to the background load or swap.
+    std::unique_ptr<Slot> slot = loadSlot(path, LoadProgressFn(), opt, nullptr);
+    if (!slot) {
+        LOGE("Model \"%s\" failed to load", name.c_str());
+        return false;
+    }
+    if (!createContext(*slot, opt, false) || !warmSlot(*slot, nullptr).ok) {
+        LOGE("Model \"%s\": context not ready", name.c_str());
+        return false;
+    }
+
+    std::unique_ptr<Slot> old;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_lock<std::shared_mutex> modelLock(modelMutex_);
+        if (!threadpool_) createThreadpool();
+        if (threadpool_) llama_attach_threadpool(slot->ctx, threadpool_, nullptr);
+        std::unique_ptr<Slot>& entry = named_[name];
+        old   = std::move(entry);
+        entry = std::move(slot);
+        sessions_.removePrefix(modelSessionPrefix(name));    // a replaced model's
+    }
+    old.reset();    // a model of the same name, freed outside the locks
+    metricsUpdateRss();
+    LOGI("Model \"%s\" ready", name.c_str());
+    return true;
+}
+
+bool Engine::removeModel(const std::string& name) {
+    std::unique_ptr<Slot> old;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_lock<std::shared_mutex> modelLock(modelMutex_);
+        const auto it = named_.find(name);
+        if (it == named_.end()) return false;
+        old = std::move(it->second);
+        named_.erase(it);
+        sessions_.removePrefix(modelSessionPrefix(name));
+    }
+    old.reset();
+    metricsUpdateRss();
+    LOGI("Model \"%s\" removed", name.c_str());
+    return true;
+}
+
+// The primary's keys are the ones outside the named models' namespace.
+void Engine::dropPrimarySessions() {
+    sessions_.removeIf([](const std::string& key) { return key.empty() || key[0] != SESSION_NS; });
+}
+
+std::vector<std::string> Engine::modelNames() const {
+    std::shared_lock<std::shared_mutex> modelLock(modelMutex_);
+    std::vector<std::string> names;
+    for (const auto& entry : named_) names.push_back(entry.first);
+    return names;
+}
+
+void Engine::unload() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_lock<std::shared_mutex> modelLock(modelMutex_);
+    sessions_.clear();
+    named_.clear();
+    live_.reset();
+    metrics().kvCellsTotal.store(0, std::memory_order_relaxed);
+    metricsSetKvCells(0);
+    publishStatus(EngineState::NotLoaded);
+    metricsUpdateRss();
+    LOGI("Model unloaded");
+}
+
+// Prepare seq 0 for `tokens`: restore the session for key (if any), drop the cached
+// cells past the common prefix, and return how many leading tokens are already in
+// the KV cache. At least the last prompt token is always left to decode so the
+// sampler has fresh logits.
+int Engine::restoreSession(Slot& slot, const std::string& key,
+                           const std::vector<llama_token>& tokens) {
+    llama_memory_t mem = llama_get_memory(slot.ctx);
+    llama_memory_clear(mem, true);
+    if (key.empty()) return 0;
+
+    std::vector<llama_token> cached;
+    if (!sessions_.restore(slot.ctx, key, 0, cached)) return 0;
+
+    int common = 0;
+    const int limit = (int)std::min(cached.size(), tokens.size() - 1);
+    while (common < limit && cached[common] == tokens[common]) common++;
+
+    if (!llama_memory_seq_rm(mem, 0, common, -1)) {
+        // Partial removal unsupported (e.g. recurrent memory) — start clean.
+        llama_memory_clear(mem, true);
+        return 0;
+    }
+    LOGI("Session %s: reusing %d/%zu prompt tokens", key.c_str(), common, tokens.size());
+    return common;
+}
+
+// Generate a reply for prompt tokens in seq 0. Caller holds the generation lock and
+// has checked that a model is loaded. tokenizeMs: time the caller spent assembling
+// the prompt (part of TTFT). The run's stats are published for lastStats().
+std::string Engine::runGeneration(Slot& slot, std::vector<llama_token> tokens, int maxTokens,
+                                  const SamplingParams& sp, const std::string& sessionKey,
+                                  double tokenizeMs, Confidence* confidence, bool count) {
+    TRACE_SCOPE("generate");
+    const auto tStart = std::chrono::steady_clock::now();
+    GenerationStats st;
+    st.tokenizeMs   = tokenizeMs;
+    st.promptTokens = (int)tokens.size();
+    auto publish = [&]() {
+        st.totalMs = tokenizeMs + elapsedMs(tStart);
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        lastStats_ = st;
+    };
+
+    const int n = (int)tokens.size();
+    const int ctxLimit = config_.ctxSize - config_.ctxMargin;
+    if (n == 0) {
+        LOGE("Empty prompt");
+        publish();
+        return "";
+    }
+    LOGI("Prompt tokens: %d  max_new: %d  ctx: %d", n, maxTokens, config_.ctxSize);
+
+    if (n >= ctxLimit) {
+        LOGE("Prompt too long: %d tokens (limit %d)", n, ctxLimit);
+        st.stopReason = StopReason::Error;
+        publish();
+        return "Prompt too long for context window.";
+    }
+
+    const llama_vocab* vocab = llama_model_get_vocab(slot.model);
+    const int nVocab = llama_vocab_n_tokens(vocab);
+    llama_sampler* sampler = makeSampler(sp);
+    llama_perf_context_reset(slot.ctx);
+
+    // Restores the contact's session (if any) and skips its shared prefix.
+    auto t = std::chrono::steady_clock::now();
+    int n_past = 0;
+    {
+        TRACE_SCOPE("session_restore");
+        n_past = restoreSession(slot, sessionKey, tokens);
+    }
+    st.restoreMs    = elapsedMs(t);
+    st.reusedTokens = n_past;
+
+    llama_batch batch = llama_batch_init(config_.nBatch, 0, 1);
+    // This thread computes too; the pool workers are counted since createThreadpool().
+    PerfCounters hw;
+    auto readHw = [&]() { return poolCounters_ ? hw.read() + poolCounters_->read() : hw.read(); };
+    const HwCounters hwStart = readHw();
+    t = std::chrono::steady_clock::now();
+    bool prefilled = false;
+    {
+        TRACE_SCOPE("prefill");
+        prefilled = prefill(slot.ctx, batch, tokens, n_past, n, 0, true);
+    }
+    if (!prefilled) {
+        llama_batch_free(batch);
+        llama_sampler_free(sampler);
+        st.stopReason = StopReason::Error;
+        publish();
+        return "";
+    }
+    st.prefillMs  = elapsedMs(t);
+    st.prefillTps = st.prefillMs > 0 ? (n - n_past) * 1000.0 / st.prefillMs : 0;
+    const HwCounters hwPrefill = readHw();
+    st.prefillCounters = hwPrefill - hwStart;
+
+    std::string result;
+    int pos = n;
+    bool kvConsistent = true;
+    st.stopReason = StopReason::MaxTokens;
+    metricsSetKvCells(pos);
+    auto tSample = std::chrono::steady_clock::now();
+
+    // From here `tokens` tracks every token whose KV cell is in seq 0 — the prompt
+    // plus each decoded reply token — so it can be saved with the session.
+
+    for (int i = 0; i < maxTokens; i++) {
+        llama_token tok;
+        {
+            TRACE_SCOPE("sample");
+            tok = llama_sampler_sample(sampler, slot.ctx, -1);
+        }
+        if (confidence) {
+            TRACE_SCOPE("confidence");
+            confidence->add(llama_get_logits_ith(slot.ctx, -1), nVocab, tok);
+        }
+        if (i == 0) st.ttftMs = tokenizeMs + elapsedMs(tStart);
+        bool stop = false;
+        {
+            TRACE_SCOPE("detokenize");
+            result += tokenPiece(vocab, tok, stop);
+        }
+        if (stop) {
+            LOGI("EOS at pos %d", pos);
+            st.stopReason = StopReason::EndOfGeneration;
+            break;
+        }
+
+        // Reuse slot 0 for single-token decode
+        batch.n_tokens     = 1;
+        batch.token[0]     = tok;
+        batch.pos[0]       = pos;
+        batch.n_seq_id[0]  = 1;
+        batch.seq_id[0][0] = 0;
+        batch.logits[0]    = 1;
+
+        int rc;
+        {
+            TRACE_SCOPE("decode");
+            rc = llama_decode(slot.ctx, batch);
+        }
+        if (rc != 0) {
+            LOGE("Decode failed at pos %d", pos);
+            kvConsistent = false;
+            st.stopReason = StopReason::Error;
+            break;
+        }
+        tokens.push_back(tok);
+        pos++;
+
+        if ((i + 1) % METRICS_SAMPLE_TOKENS == 0) {
+            const double ms = elapsedMs(tSample);
+            if (ms > 0 && count) metricsRecordRate(METRICS_SAMPLE_TOKENS * 1000.0 / ms);
+            metricsSetKvCells(pos);
+            tSample = std::chrono::steady_clock::now();
+        }
+
+        if (pos >= ctxLimit) {
+            LOGI("Context limit approaching at pos %d — stopping", pos);
+            st.stopReason = StopReason::ContextFull;
+            break;
+        }
+    }
+
+    st.decodeCounters = readHw() - hwPrefill;
+    const llama_perf_context_data perf  = llama_perf_context(slot.ctx);
+    const llama_perf_sampler_data sperf = llama_perf_sampler(sampler);
+    st.generatedTokens = pos - n;
+    st.decodeMs        = perf.t_eval_ms;
+    st.decodeTps       = perf.t_eval_ms > 0 ? perf.n_eval * 1000.0 / perf.t_eval_ms : 0;
+    st.samplerMs       = sperf.t_sample_ms;
+    st.peakKvCells     = (int)llama_memory_seq_pos_max(llama_get_memory(slot.ctx), 0) + 1;
+
+    llama_batch_free(batch);
+    llama_sampler_free(sampler);
+    publish();
+    metricsSetKvCells(st.peakKvCells);
+    if (count) countRequest(st, true);
+    LOGI("Generated %zu chars in %d tokens (prefill %d, reused %d) — prefill %.0f tok/s, "
+         "decode %.1f tok/s, ttft %.0f ms",
+         result.size(), st.generatedTokens, n - n_past, n_past, st.prefillTps, st.decodeTps, st.ttftMs);
+
+    if (!sessionKey.empty() && kvConsistent) {
+        TRACE_SCOPE("session_save");
+        sessions_.save(slot.ctx, sessionKey, 0, tokens);
+    }
+    return result;
+}
+
+// One answered request on the metrics page: its tokens, and its overall decode rate
+// when the run took no tok/s samples (too short, or not counted while it ran).
+void Engine::countRequest(const GenerationStats& st, bool sampled) {
+    metricsAddTokens(st.generatedTokens, st.promptTokens - st.reusedTokens);
+    metrics().totalRequests.fetch_add(1, std::memory_order_relaxed);
+    if ((!sampled || st.generatedTokens < METRICS_SAMPLE_TOKENS) && st.decodeTps > 0) {
+        metricsRecordRate(st.decodeTps);
+    }
+}
+
+// Largest prompt that leaves maxTokens (+ margin) free in the context.
+int Engine::promptLimit(int maxTokens) const {
+    return std::max(1, config_.ctxSize - config_.ctxMargin - std::max(maxTokens, 0));
+}
+
+// Summarizable spans are resolved (see summarize.h) — summarized only when
+// summarizeAbove > 0 and a span exceeds it. Only a model with think tokens gets
+// the empty think block; to any other it would be plain text in every chunk.
+// Caller holds the generation lock.
+void Engine::resolveSpans(Slot& slot, std::vector<ChatMessage>& msgs, int summarizeAbove) {
+    if (!slot.ctx) return;
+    SummarizeParams sp;
+    sp.threshold = summarizeAbove;
+    sp.ctxMargin = config_.ctxMargin;
+    if (slot.chat.hasThinkTokens()) sp.assistantPrefill = EMPTY_THINK_PREFILL;
+    summarizeSpans(slot.ctx, slot.chat, msgs, sp);
+}
+
+// The slot a request asked for, if it has a context; logs and returns null otherwise.
+Engine::Slot* Engine::requestSlot(const std::string& model, const char* what) {
+    Slot* slot = live_.get();
+    if (!model.empty()) {
+        const auto it = named_.find(model);
+        slot = it != named_.end() ? it->second.get() : nullptr;
+    }
+    if (slot && slot->ctx) return slot;
+    if (model.empty()) LOGE("%s called — no model loaded", what);
+    else LOGE("%s called — model \"%s\" not loaded", what, model.c_str());
+    return nullptr;
+}
+
+std::string Engine::generate(const std::string& prompt, int maxTokens, const SamplingParams& sp,
+                             const std::string& sessionKey, const std::string& model) {
+    GenerationLock lock(*this);
+    Slot* slot = requestSlot(model, "Generate");
+    if (!slot) return "";
+
+    const auto t0 = std::chrono::steady_clock::now();
+    std::vector<llama_token> tokens;
+    {
+        TRACE_SCOPE("tokenize");
+        tokens = ::tokenize(llama_model_get_vocab(slot->model), prompt, true);
+    }
+    if (tokens.empty()) {
+        LOGE("Tokenize failed");
+        return "";
+    }
+    return runGeneration(*slot, std::move(tokens), maxTokens, sp, activeSessionKey(sessionKey, model),
+                         elapsedMs(t0));
+}
+
+std::string Engine::generateChat(std::vector<ChatMessage> msgs, const std::string& assistantPrefill,
+                                 int segmentBudget, int summarizeAbove, int maxTokens,
+                                 const SamplingParams& sp, const std::string& sessionKey,
+                                 const std::string& model) {
+    GenerationLock lock(*this);
+    Slot* slot = requestSlot(model, "Generate");
+    if (!slot) return "";
+
+    const auto t0 = std::chrono::steady_clock::now();
+    resolveSpans(*slot, msgs, summarizeAbove);
+    std::vector<llama_token> tokens =
+        slot->chat.buildFitted(msgs, assistantPrefill, promptLimit(maxTokens), segmentBudget);
+    if (tokens.empty()) {
+        LOGE("Chat prompt build failed");
+        return "";
+    }
+    return runGeneration(*slot, std::move(tokens), maxTokens, sp, activeSessionKey(sessionKey, model),
+                         elapsedMs(t0));
+}
+
+std::string Engine::generateCascade(std::vector<ChatMessage> msgs, const std::string& assistantPrefill,
+                                    int segmentBudget, int maxTokens, const SamplingParams& sp,
+                                    const std::string& sessionKey, const CascadeParams& cascade) {
+    GenerationLock lock(*this);
+    Slot* large = requestSlot("", "Cascade");
+    if (!large) return "";
+    Slot* small = cascade.small.empty() ? nullptr : requestSlot(cascade.small, "Cascade");
+
+    auto t0 = std::chrono::steady_clock::now();
+    double draftMs = 0;
+    Confidence conf;
+    if (small) {
+        TRACE_SCOPE("cascade_draft");
+        // Capped, so an escalated draft costs at most draftMaxTokens small-model tokens.
+        const int draftTokens = cascade.draftMaxTokens > 0 ? std::min(cascade.draftMaxTokens, maxTokens)
+                                                           : maxTokens;
+        const SamplingParams greedy{0.0f, 1.0f};
+        std::vector<ChatMessage> draftMsgs = msgs;
+        resolveSpans(*small, draftMsgs, 0);
+        std::vector<llama_token> tokens =
+            small->chat.buildFitted(draftMsgs, assistantPrefill, promptLimit(draftTokens), segmentBudget);
+        // The draft reaches the metrics page only if it is kept: a cascade is one
+        // request, counted once, at the tier that answered.
+        std::string draft;
+        if (!tokens.empty()) {
+            draft = runGeneration(*small, std::move(tokens), draftTokens, greedy,
+                                  activeSessionKey(sessionKey, cascade.small), elapsedMs(t0), &conf,
+                                  false);
+        }
+        draftMs = elapsedMs(t0);
+        const bool finished = lastStats().stopReason == StopReason::EndOfGeneration;
+        const bool confident = finished && !draft.empty() && conf.tokens > 0 &&
+                               conf.meanEntropy() <= cascade.maxMeanEntropy &&
+                               conf.minProb >= cascade.minTokenProb;
+        LOGI("Cascade draft: %d tokens, entropy %.2f, min p %.3f%s — %s", conf.tokens,
+             conf.meanEntropy(), conf.minProb, finished ? "" : " (unfinished)",
+             confident ? "kept" : "escalating");
+        if (confident) {
+            countRequest(lastStats(), false);
+            std::lock_guard<std::mutex> statsLock(statsMutex_);
+            lastStats_.cascadeTier      = CascadeTier::Small;
+            lastStats_.draftMeanEntropy = conf.meanEntropy();
+            lastStats_.draftMinProb     = conf.minProb;
+            lastStats_.draftMs          = draftMs;
+            return draft;
+        }
+    }
+
+    t0 = std::chrono::steady_clock::now();
+    resolveSpans(*large, msgs, 0);
+    std::vector<llama_token> tokens =
+        large->chat.buildFitted(msgs, assistantPrefill, promptLimit(maxTokens), segmentBudget);
+    if (tokens.empty()) {
+        LOGE("Chat prompt build failed");
+        return "";
+    }
+    std::string reply = runGeneration(*large, std::move(tokens), maxTokens, sp,
+                                      activeSessionKey(sessionKey), elapsedMs(t0));
+    std::lock_guard<std::mutex> statsLock(statsMutex_);
+    lastStats_.cascadeTier      = CascadeTier::Large;
+    lastStats_.draftMeanEntropy = conf.meanEntropy();
+    lastStats_.draftMinProb     = conf.tokens ? conf.minProb : 0;
+    lastStats_.draftMs          = draftMs;
+    lastStats_.ttftMs          += draftMs;
+    lastStats_.totalMs         += draftMs;
+    return reply;
+}
+
+std::vector<std::string> Engine::generateBulk(const std::string& systemPrompt,
+                                              const std::vector<std::string>& userMessages,
+                                              int segmentBudget, int maxTokens,
+                                              const SamplingParams& sp) {
+    GenerationLock lock(*this);
+    const size_t count = userMessages.size();
+    if (!hasContext()) {
+        LOGE("Bulk generate called — no model loaded");
+        return std::vector<std::string>(count);
+    }
+    if (count == 0) return {};
+
+    std::vector<std::vector<llama_token>> prompts(count);
+    const std::vector<llama_token>* first = nullptr;    // first prompt that fits
+    size_t common = SIZE_MAX;
+    for (size_t i = 0; i < count; i++) {
+        prompts[i] = live_->chat.buildFitted({{"system", systemPrompt}, {"user", userMessages[i]}},
+                                             "", promptLimit(maxTokens), segmentBudget);
+        // A prompt that cannot fit comes back empty: it gets no suffix, so only its
+        // reply is "", and it takes no part in the common prefix.
+        if (prompts[i].empty()) continue;
+
+        // Longest common prefix, leaving every suffix at least one token.
+        size_t k = 0;
+        const size_t limit = prompts[i].size() - 1;
+        if (!first) {
+            first = &prompts[i];
+            k = limit;
+        } else {
+            while (k < limit && k < common && (*first)[k] == prompts[i][k]) k++;
+        }
+        common = std::min(common, k);
+    }
+    if (!first) {
+        LOGE("Bulk generate: none of %zu prompts fits the context", count);
+        return std::vector<std::string>(count);
+    }
+
+    const std::vector<llama_token> prefix(first->begin(), first->begin() + common);
+    std::vector<std::vector<llama_token>> suffixes(count);
+    for (size_t i = 0; i < count; i++) {
+        if (!prompts[i].empty()) suffixes[i].assign(prompts[i].begin() + common, prompts[i].end());
+    }
+    LOGI("Bulk generate: %zu prompts, shared prefix %zu tokens, max_new %d",
+         count, prefix.size(), maxTokens);
+    return generateShared(live_->ctx, prefix, suffixes, maxTokens, config_.ctxMargin, sp);
+}
+
+std::string Engine::generateTokens(std::vector<llama_token> tokens, int maxTokens,
+                                   const SamplingParams& sp, const std::string& sessionKey) {
+    GenerationLock lock(*this);
+    if (!hasContext()) {
+        LOGE("Generate called — no model loaded");
+        return "";
+    }
+
+    const int nVocab = llama_vocab_n_tokens(llama_model_get_vocab(live_->model));
+    for (llama_token t : tokens) {
+        if (t < 0 || t >= nVocab) {
+            LOGE("Token id %d out of range (vocab %d)", t, nVocab);
+            return "";
+        }
+    }
+    // Tokenized by the caller — its time is not seen here.
+    return runGeneration(*live_, std::move(tokens), maxTokens, sp, activeSessionKey(sessionKey), 0.0);
+}
+
+std::vector<llama_token> Engine::tokenize(const std::string& text, bool addSpecial) const {
+    std::shared_lock<std::shared_mutex> modelLock(modelMutex_);
+    if (!live_) return {};
+    return ::tokenize(llama_model_get_vocab(live_->model), text, addSpecial);
+}
+
+int Engine::countTokens(const std::string& text) const {
+    std::shared_lock<std::shared_mutex> modelLock(modelMutex_);
+    if (!live_) return -1;
+    if (text.empty()) return 0;
+    const int n = llama_tokenize(llama_model_get_vocab(live_->model), text.data(), (int32_t)text.size(),
+                                 nullptr, 0, false, true);
+    return n < 0 ? -n : n;
+}
+
+// Takes the generation lock: the primary's segment cache is shared with generation.
+std::vector<llama_token> Engine::tokenizeChat(std::vector<ChatMessage> msgs,
+                                              const std::string& assistantPrefill,
+                                              int reserveTokens, int segmentBudget) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!live_) return {};
+    resolveSpans(*live_, msgs, 0);
+    return live_->chat.buildFitted(msgs, assistantPrefill, promptLimit(reserveTokens), segmentBudget);
+}
+
+int Engine::contextSize() const {
+    const EngineStatus s = status();
+    return s.loaded() ? s.nCtx : 0;
+}
+
+std::string Engine::modelInfo() const {
+    const EngineStatus s = status();
+    if (!s.loaded()) return "No model loaded";
+    char info[256];
+    snprintf(info, sizeof(info),
+             "Vocab: %d | Ctx: %d | Threads: %d | KV: %s | Batch: %d | Template: %s",
+             s.nVocab, s.nCtx, s.nThreads, ggml_type_name((ggml_type)s.kvType), s.nBatch,
+             s.templateName);
+    return info;
+}
+
+GenerationStats Engine::lastStats() const {
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    return lastStats_;
+}
+
+MemoryStats Engine::memoryStats() const {
+    std::shared_lock<std::shared_mutex> modelLock(modelMutex_);
+    return memoryStatsCollect(live_ ? live_->model : nullptr);
+}
+
+bool Engine::setOpProfiling(bool enable) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (profileOps_ == enable) return true;
+    profileOps_ = enable;
+    opProfiler_.reset();
+    if (!live_) return true;    // applied at the next load
+    std::unique_lock<std::shared_mutex> modelLock(modelMutex_);
+    const bool ok = resetContext();
+    publishStatus(ok ? EngineState::Ready : EngineState::Error);
+    return ok;
+}
+
+std::string Engine::opProfileReport(bool reset) {
+    std::string report = opProfiler_.report();
+    if (reset) opProfiler_.reset();
+    return report;
+}
+
+bool Engine::setHugePages(HugePageMode mode) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_lock<std::shared_mutex> modelLock(modelMutex_);
+    if (hugePages_ == mode) return true;
+    hugePages_ = mode;
+    LOGI("Huge pages: mode %d, kernel THP \"%s\" — weights from the next load", (int)mode,
+         thpSetting().c_str());
+    if (!live_) return true;
+    const bool ok = resetContext();
+    publishStatus(ok ? EngineState::Ready : EngineState::Error);
+    return ok;
+}
+
+HugePageStats Engine::hugePageStats() const {
+    std::shared_lock<std::shared_mutex> modelLock(modelMutex_);
+    HugePageStats s;
+    s.thp = thpSetting();
+    std::vector<MemRange> ranges;
+    if (live_) {
+        ranges = live_->weightsHuge;
+        ranges.insert(ranges.end(), live_->ctxHuge.begin(), live_->ctxHuge.end());
+    }
+    for (const MemRange& r : ranges) s.advisedBytes += (int64_t)(r.end - r.start);
+    s.hugeBytes      = anonHugeBytes(ranges);
+    s.collapseErrors = collapseErrors_.load(std::memory_order_relaxed);
+    return s;
+}
+
+// modelMutex_ held (either way) for the live slot: the pager's mappings stay valid.
+void Engine::applyWeightsPolicy(Slot& slot, const WeightsPolicy& policy) {
+    slot.pager.advise(policy.advice);
+    if (policy.touchPages) slot.pager.startTouch();
+}
+
+void Engine::setWeightsPolicy(const WeightsPolicy& policy) {
+    std::unique_lock<std::shared_mutex> modelLock(modelMutex_);
+    weightsPolicy_ = policy;
+    LOGI("Weights policy: mmap=%d mlock=%d advice=%d touch=%d", policy.useMmap, policy.useMlock,
+         (int)policy.advice, policy.touchPages);
+    if (live_) applyWeightsPolicy(*live_, weightsPolicy_);
+}
+
+void Engine::prefetchWeights() {
+    std::shared_lock<std::shared_mutex> modelLock(modelMutex_);
+    if (live_) applyWeightsPolicy(*live_, weightsPolicy_);
+}
+
+WeightsResidency Engine::weightsResidency() const {
+    std::shared_lock<std::shared_mutex> modelLock(modelMutex_);
+    return live_ ? live_->pager.residency() : WeightsResidency();
+}
+
+WarmupStats Engine::warmup() {
+    GenerationLock lock(*this);
+    if (!hasContext()) {
+        LOGE("Warm-up: no model loaded");
+        return WarmupStats();
+    }
+    return warmSlot(*live_, threadpool_);
+}
+
+// Four stages, each timed: wake the threadpool; fault in the context's own buffers
+// (slot.ctxRanges, nothing another thread mapped meanwhile); one graph over
+// [BOS, EOS] in llama.cpp's warm-up mode, which runs every weight (all experts of
+// an MoE) once; one single-token decode, the shape of every generated token. The
+// KV cache is cleared again afterwards. The caller owns slot's context for the
+// duration — the generation lock for the live slot.
+WarmupStats Engine::warmSlot(Slot& slot, ggml_threadpool* pool) {
+    TRACE_SCOPE("warmup");
+    WarmupStats w;
+    const auto t0 = std::chrono::steady_clock::now();
+
+    auto t = std::chrono::steady_clock::now();
+    if (pool) ggml_threadpool_resume(pool);
+    w.threadsMs = elapsedMs(t);
+
+    t = std::chrono::steady_clock::now();
+    {
+        TRACE_SCOPE("warmup_touch");
+        w.touchedBytes = populateRanges(slot.ctxRanges);
+    }
+    w.touchMs = elapsedMs(t);
+
+    const llama_vocab* vocab = llama_model_get_vocab(slot.model);
+    std::vector<llama_token> tokens;
+    const llama_token bos = llama_vocab_bos(vocab);
+    const llama_token eos = llama_vocab_eos(vocab);
+    if (bos != LLAMA_TOKEN_NULL) tokens.push_back(bos);
+    if (eos != LLAMA_TOKEN_NULL) tokens.push_back(eos);
+    if (tokens.empty()) tokens.push_back(0);
+    llama_memory_t mem = llama_get_memory(slot.ctx);
+    llama_memory_clear(mem, true);
+
+    t = std::chrono::steady_clock::now();
+    {
+        TRACE_SCOPE("warmup_graph");
+        llama_set_warmup(slot.ctx, true);
+        w.ok = llama_decode(slot.ctx, llama_batch_get_one(tokens.data(), (int)tokens.size())) == 0;
+        llama_synchronize(slot.ctx);
+        llama_set_warmup(slot.ctx, false);
+    }
+    w.graphMs = elapsedMs(t);
+
+    if (w.ok) {
+        t = std::chrono::steady_clock::now();
+        TRACE_SCOPE("warmup_decode");
+        llama_token tok = tokens[0];
+        w.ok = llama_decode(slot.ctx, llama_batch_get_one(&tok, 1)) == 0;
+        llama_synchronize(slot.ctx);
+        w.decodeMs = elapsedMs(t);
+    }
+    llama_memory_clear(mem, true);
+    llama_perf_context_reset(slot.ctx);
+    w.totalMs = elapsedMs(t0);
+
+    if (w.ok) {
+        LOGI("Warm-up %.1f ms: threads %.1f, touch %.1f (%.0f MiB), graph %.1f, decode %.1f",
+             w.totalMs, w.threadsMs, w.touchMs, w.touchedBytes / (1024.0 * 1024.0), w.graphMs,
+             w.decodeMs);
+    } else {
+        LOGE("Warm-up decode failed");
+    }
+    return w;
+}
+
+void Engine::configureSessions(const std::string& dir, size_t ramBudget, size_t diskBudget) {
+    sessions_.configure(dir, ramBudget, diskBudget);
+}
@@ -0,0 +1,318 @@
+// engine.h — the inference engine: model lifetime, generation, tokenization, stats.
+//
+// Everything the app's native layer does, without JNI: llama_jni.cpp converts Java
+// arguments and forwards to one Engine; engine_api.h wraps it in a small C API for
+// host tools (benchmarks, tests) built on a developer machine.
+//
+// Locking. Generation entry points, load/unload and anything touching the context
+// or the chat segment cache serialize on the engine's generation mutex (requests
+// are counted on the metrics page while they wait and while they run). Readers
+// that only need the vocab — tokenize(), countTokens() — take the model mutex
+// shared and never wait behind a generation; load/unload take it exclusively,
+// under the generation mutex. Status queries — isLoaded(), status(),
+// contextSize(), modelInfo() — take no lock at all: they read the snapshot the
+// engine publishes on every state change (engine_state.h), so they answer during
+// a load or a generation and never see a model that unload() is freeing.
+// lastStats() and sessionStats() have their own small locks.
+//
+// Models. The model load() / swapAsync() install is the primary one: status,
+// memory stats, warm-up, op profiling and huge pages describe it. addModel()
+// registers further models by name — say a small one for command parsing beside a
+// large one for replies. generate() and generateChat() take the name of the model
+// to run ("" = primary). All models share the threadpool and the generation mutex,
+// so requests still run one at a time; a cheap one simply finishes sooner. Saved
+// sessions are kept per model: replacing the primary drops only the primary's.
+//
+// Hot swap. swapAsync() loads, sets up and warms the next model in a second slot
+// without any engine lock, while the live model keeps serving. It then takes the
+// generation mutex — which waits for the request in flight, the only one there can
+// be — and the model mutex, switches the slots, and frees the old model after
+// releasing both.
+//
+// The metrics page (metrics.h) is process-wide; one Engine per process publishes
+// to it.
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "chat_prompt.h"
+#include "engine_state.h"
+#include "generation.h"
+#include "huge_pages.h"
+#include "llama.h"
+#include "memory_stats.h"
+#include "op_profile.h"
+#include "perf_counters.h"
+#include "session_cache.h"
+#include "weights_residency.h"
+
+// Defaults tuned for Snapdragon 8 Gen 3 (S24 Ultra).
+struct EngineConfig {
+    int       ctxSize   = 8192;
+    int       nThreads  = 6;
+    int       nBatch    = 256;
+    int       nSeqMax   = 8;                // seq 0 + up to 7 forked bulk replies
+    ggml_type kvType    = GGML_TYPE_Q8_0;
+    int       ctxMargin = 32;               // cells kept free below n_ctx
+};
+
+// Stage timings of Engine::warmup().
+struct WarmupStats {
+    bool    ok           = false;
+    double  threadsMs    = 0;    // wake the threadpool
+    double  touchMs      = 0;    // fault in KV cache and compute buffers
+    int64_t touchedBytes = 0;
+    double  graphMs      = 0;    // warm-up graph over every weight
+    double  decodeMs     = 0;    // one single-token decode
+    double  totalMs      = 0;
+};
+
+// Load progress in [0, 1], called on the loading thread; return false to cancel.
+using LoadProgressFn = std::function<bool(float progress)>;
+using LoadDoneFn     = std::function<void(bool ok)>;
+
+enum class SwapResult : int {
+    Started   = 0,
+    Busy      = 1,    // a background load or swap is running
+    NoMemory  = 2,    // both models would not fit in MemAvailable
+    NotLoaded = 3,    // nothing to keep serving — use loadAsync()
+};
+
+// Draft with a small registered model; keep the draft only if the model was sure of
+// it (Confidence in generation.h), otherwise answer with the primary model.
+struct CascadeParams {
+    std::string small;                  // addModel() name
+    float       maxMeanEntropy = 1.5f;  // nats per token
+    float       minTokenProb   = 0.01f; // every drafted token at least this likely
+    int         draftMaxTokens = 96;    // a draft not done by then escalates; 0 = maxTokens
+};
+
+class Engine {
+public:
+    explicit Engine(const EngineConfig& config = EngineConfig());
+    ~Engine();
+    Engine(const Engine&) = delete;
+    Engine& operator=(const Engine&) = delete;
+
+    // Loads a GGUF model (replacing any loaded one) and creates its context.
+    // Progress goes to onProgress (if set) and the metrics page as weights load;
+    // cancelLoad() or onProgress returning false abandons the load — the engine is
+    // then left unloaded and load() returns false.
+    bool load(const std::string& path, const LoadProgressFn& onProgress = nullptr);
+
+    // load() on a background thread; onDone(ok) runs on that thread at the end and
+    // must not call loadAsync() itself. False if a background load is running.
+    bool loadAsync(const std::string& path, LoadProgressFn onProgress, LoadDoneFn onDone);
+
+    // Replaces the live model without a gap in service — see "Hot swap" above.
+    // Refused unless MemAvailable covers the new file and a context like the live
+    // one on top of the live model's resident weights. onDone(ok) runs on the loader
+    // thread once the new model serves (true) or the swap was abandoned (false, the
+    // old model still serving).
+    SwapResult swapAsync(const std::string& path, LoadProgressFn onProgress, LoadDoneFn onDone);
+
+    // Abandons the load or swap in progress at its next progress report; no-op otherwise.
+    // addModel() is not affected.
+    void cancelLoad() { cancelLoad_.store(true, std::memory_order_relaxed); }
+
+    // Frees the primary model and every named one.
+    void unload();
+
+    // Brings a freshly loaded model to steady state without generating: threads
+    // awake, buffers faulted in, every weight and kernel touched once. Leaves the
+    // KV cache empty; the first request then runs at normal speed.
+    WarmupStats warmup();
+
+    // Lock-free status snapshot; see engine_state.h.
+    EngineStatus status() const { return status_.read(); }
+    bool isLoaded() const { return status().loaded(); }
+
+    // Raw prompt text, tokenized with BOS. sessionKey: per-contact KV reuse
+    // (session_cache.h); "" = stateless. model: registered name, "" = primary.
+    // Empty string if nothing could be generated.
+    std::string generate(const std::string& prompt, int maxTokens, const SamplingParams& sp,
+                         const std::string& sessionKey = "", const std::string& model = "");
+
+    // Messages rendered with the model's chat template. assistantPrefill is appended
+    // after the assistant header verbatim. segmentBudget caps each truncatable span
+    // (0 = cut only to fit); spans marked summarizable and longer than
+    // summarizeAbove tokens are summarized first (0 = never).
+    std::string generateChat(std::vector<ChatMessage> msgs, const std::string& assistantPrefill,
+                             int segmentBudget, int summarizeAbove, int maxTokens,
+                             const SamplingParams& sp, const std::string& sessionKey = "",
+                             const std::string& model = "");
+
+    // generateChat() on the small model of cascade, greedily and for at most
+    // draftMaxTokens, and again on the primary model with sp unless the draft ended on
+    // its own with a mean entropy of at most maxMeanEntropy and no token less likely
+    // than minTokenProb. Greedy, each drafted token is the mode of the distribution
+    // its confidence is scored on. lastStats().cascadeTier says which answered.
+    // sessionKey is kept per model, so each tier reuses its own KV state.
+    std::string generateCascade(std::vector<ChatMessage> msgs, const std::string& assistantPrefill,
+                                int segmentBudget, int maxTokens, const SamplingParams& sp,
+                                const std::string& sessionKey, const CascadeParams& cascade);
+
+    // One reply per user message, all sharing systemPrompt; the common token prefix
+    // is decoded once and forked. Replies in order, "" where none was produced.
+    std::vector<std::string> generateBulk(const std::string& systemPrompt,
+                                          const std::vector<std::string>& userMessages,
+                                          int segmentBudget, int maxTokens, const SamplingParams& sp);
+
+    // Generation from prompt tokens the caller already has (e.g. tokenizeChat()).
+    // Ids outside the vocab are rejected.
+    std::string generateTokens(std::vector<llama_token> tokens, int maxTokens,
+                               const SamplingParams& sp, const std::string& sessionKey = "");
+
+    // Text as-is (no chat template); addSpecial adds BOS where the vocab wants it.
+    std::vector<llama_token> tokenize(const std::string& text, bool addSpecial) const;
+
+    // Token count of text as it would appear inside a prompt (no BOS); -1 if no model.
+    int countTokens(const std::string& text) const;
+
+    // Exactly the tokens generateChat() would decode with maxTokens = reserveTokens.
+    std::vector<llama_token> tokenizeChat(std::vector<ChatMessage> msgs,
+                                          const std::string& assistantPrefill,
+                                          int reserveTokens, int segmentBudget);
+
+    int contextSize() const;
+    std::string modelInfo() const;
+    const EngineConfig& config() const { return config_; }
+
+    // Stats of the last generate()/generateChat()/generateCascade()/generateTokens() call.
+    GenerationStats lastStats() const;
+
+    MemoryStats memoryStats() const;
+
+    // Op profiling (op_profile.h). Switching recreates the context. False if that failed.
+    bool setOpProfiling(bool enable);
+    std::string opProfileReport(bool reset);
+
+    // Weight mapping policy (weights_residency.h). mmap / mlock apply from the next
+    // load; advice and page touching also run now if a model is loaded.
+    void setWeightsPolicy(const WeightsPolicy& policy);
+
+    // Re-issues the policy's advice and touch pass — e.g. when a request is likely
+    // after an idle period. Returns at once; does not wait behind a generation.
+    void prefetchWeights();
+
+    WeightsResidency weightsResidency() const;
+
+    // Transparent huge pages for the KV cache, compute buffers and anonymous weight
+    // copies (huge_pages.h). Recreates the context now (KV cleared); weights are
+    // advised from the next load. False if the context could not be recreated.
+    bool setHugePages(HugePageMode mode);
+    HugePageStats hugePageStats() const;
+
+    // Loads path as model `name` (replacing one of that name) and warms it, while
+    // requests keep running; blocks for the load. Refused, like swapAsync(), when it
+    // would not fit beside the primary model. Sessions saved on a model of that name
+    // are dropped; the primary's are kept. Names must not contain '\x1f' (the session
+    // namespace separator). cancelLoad() does not abandon it. False on failure.
+    bool addModel(const std::string& name, const std::string& path);
+    bool removeModel(const std::string& name);
+
+    // Names of the models addModel() registered, sorted.
+    std::vector<std::string> modelNames() const;
+
+    // Session cache; ramBudget 0 disables reuse.
+    void configureSessions(const std::string& dir, size_t ramBudget, size_t diskBudget);
+    std::string sessionStats() const { return sessions_.statsString(); }
+    SessionCache::Stats sessionCounters() const { return sessions_.stats(); }
+
+private:
+    class GenerationLock;
+    struct LoadCall;
+
+    // One model with its context and everything bound to it.
+    struct Slot {
+        ~Slot();
+        std::string           path;
+        llama_model*          model = nullptr;
+        llama_context*        ctx   = nullptr;
+        ChatPrompt            chat;            // bound to model
+        WeightsPager          pager;           // file mappings of model
+        std::vector<MemRange> weightsHuge;     // advised anonymous weight copies
+        std::vector<MemRange> ctxRanges;       // the context's own buffers (bufferRanges())
+        std::vector<MemRange> ctxHuge;         // of those, advised
+        MemoryRecord          memory;          // recorded beside the primary (!primary)
+    };
+
+    // Settings a slot is built with, read under the engine's locks.
+    struct SlotOptions {
+        WeightsPolicy weights;
+        HugePageMode  hugePages  = HugePageMode::Off;
+        bool          profileOps = false;
+        bool          primary    = true;     // feeds memory_stats.h, else slot.memory
+    };
+
+    bool loadModel(const std::string& path, const LoadProgressFn& onProgress);
+    bool swapModel(const std::string& path, const LoadProgressFn& onProgress);
+    bool fitsBesidePrimary(const std::string& path) const;  // modelMutex_ held
+    std::unique_ptr<Slot> loadSlot(const std::string& path, const LoadProgressFn& onProgress,
+                                   const SlotOptions& opt, std::atomic<bool>* cancel);
+    bool createContext(Slot& slot, const SlotOptions& opt, bool attachPool);
+    WarmupStats warmSlot(Slot& slot, ggml_threadpool* pool);
+    static bool onLoadProgress(float progress, void* userData);
+    void createThreadpool();
+    SlotOptions slotOptions() const;                        // mutex_ + modelMutex_ held
+    void applyWeightsPolicy(Slot& slot, const WeightsPolicy& policy);
+    bool resetContext();                                    // mutex_ + modelMutex_ held
+    bool hasContext() const { return live_ && live_->ctx; } // mutex_ held
+    void publishStatus(EngineState state);                  // mutex_ held
+    void publishState(EngineState state);                   // mutex_ held; state only
+    Slot* requestSlot(const std::string& model, const char* what);   // mutex_ held
+    int restoreSession(Slot& slot, const std::string& key, const std::vector<llama_token>& tokens);
+    std::string runGeneration(Slot& slot, std::vector<llama_token> tokens, int maxTokens,
+                              const SamplingParams& sp, const std::string& sessionKey,
+                              double tokenizeMs, Confidence* confidence = nullptr,
+                              bool count = true);    // false: leave the metrics page to the caller
+    void countRequest(const GenerationStats& st, bool sampled);
+    int promptLimit(int maxTokens) const;
+    void resolveSpans(Slot& slot, std::vector<ChatMessage>& msgs, int summarizeAbove);
+    // Sessions of named models are kept apart from the primary's: KV state only
+    // restores into the model that saved it. Their keys are modelSessionPrefix(model)
+    // + key; a key containing SESSION_NS could pass for one and is not cached.
+    std::string activeSessionKey(const std::string& key, const std::string& model = "") const {
+        if (!sessions_.enabled() || key.empty() || key.find(SESSION_NS) != std::string::npos) {
+            return std::string();
+        }
+        return model.empty() ? key : modelSessionPrefix(model) + key;
+    }
+    static std::string modelSessionPrefix(const std::string& model) {
+        return SESSION_NS + model + SESSION_NS;
+    }
+    static constexpr char SESSION_NS = '\x1f';    // never in a cached key or model name
+    void dropPrimarySessions();                     // mutex_ held
+
+    const EngineConfig        config_;
+    std::unique_ptr<Slot>     live_;           // primary model; null when unloaded
+    std::map<std::string, std::unique_ptr<Slot>> named_;   // addModel() (mutex_ + modelMutex_)
+    ggml_threadpool*          threadpool_ = nullptr;   // decode + batch, kept across loads
+    std::unique_ptr<PerfCounters> poolCounters_;     // threadpool_'s workers; null if unavailable
+    std::mutex                mutex_;          // generation lock
+    mutable std::shared_mutex modelMutex_;     // model lifetime for vocab readers
+
+    SessionCache              sessions_;       // disabled until configureSessions()
+    OpProfiler                opProfiler_;     // cb_eval while profileOps_ (mutex_)
+    bool                      profileOps_ = false;
+    WeightsPolicy             weightsPolicy_;  // modelMutex_
+    HugePageMode              hugePages_ = HugePageMode::Off;  // mutex_ + modelMutex_
+    std::atomic<int>          collapseErrors_{0};
+    EngineStatusCell          status_;         // written under mutex_, read lock-free
+    uint64_t                  loadCount_ = 0;  // mutex_
+
+    std::atomic<bool>         cancelLoad_{false};
+    std::mutex                loaderMutex_;    // loader_, loaderBusy_
+    std::thread               loader_;         // loadAsync()
+    bool                      loaderBusy_ = false;
+
+    GenerationStats           lastStats_;
+    mutable std::mutex        statsMutex_;
+};
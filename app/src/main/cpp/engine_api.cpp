@@ -0,0 +1,136 @@
+// engine_api.cpp — see engine_api.h.
+
+#include "engine_api.h"
+#include "engine.h"
+
+#include <cstdlib>
+#include <cstring>
+
+struct aigentik_engine {
+    explicit aigentik_engine(const EngineConfig& config) : engine(config) {}
+    Engine engine;
+};
+
+namespace {
+
+char* copyString(const std::string& s) {
+    char* out = static_cast<char*>(std::malloc(s.size() + 1));
+    if (!out) return nullptr;
+    std::memcpy(out, s.data(), s.size());
+    out[s.size()] = '\0';
+    return out;
+}
+
+std::string str(const char* s) {
+    return s ? std::string(s) : std::string();
+}
+
+} // namespace
+
+aigentik_engine* aigentik_engine_create(const aigentik_engine_config* config) {
+    EngineConfig c;
+    if (config) {
+        if (config->ctx_size  > 0) c.ctxSize  = config->ctx_size;
+        if (config->n_threads > 0) c.nThreads = config->n_threads;
+        if (config->n_batch   > 0) c.nBatch   = config->n_batch;
+        if (config->n_seq_max > 0) c.nSeqMax  = config->n_seq_max;
+        if (config->kv_type  >= 0) c.kvType   = (ggml_type)config->kv_type;
+    }
+    return new aigentik_engine(c);
+}
+
+void aigentik_engine_free(aigentik_engine* engine) {
+    delete engine;
+}
+
+bool aigentik_engine_load(aigentik_engine* engine, const char* model_path) {
+    return engine && model_path && engine->engine.load(model_path);
+}
+
+void aigentik_engine_unload(aigentik_engine* engine) {
+    if (engine) engine->engine.unload();
+}
+
+char* aigentik_engine_generate(aigentik_engine* engine, const char* prompt, int32_t max_tokens,
+                               float temperature, float top_p, const char* session_key) {
+    if (!engine || !prompt) return nullptr;
+    return copyString(engine->engine.generate(prompt, max_tokens, {temperature, top_p},
+                                              str(session_key)));
+}
+
+char* aigentik_engine_generate_chat(aigentik_engine* engine, const char* const* roles,
+                                    const char* const* contents, size_t n_messages,
+                                    const char* assistant_prefill, int32_t max_tokens,
+                                    float temperature, float top_p, const char* session_key) {
+    if (!engine || (n_messages && (!roles || !contents))) return nullptr;
+    std::vector<ChatMessage> msgs(n_messages);
+    for (size_t i = 0; i < n_messages; i++) {
+        msgs[i].role    = str(roles[i]);
+        msgs[i].content = str(contents[i]);
+    }
+    return copyString(engine->engine.generateChat(std::move(msgs), str(assistant_prefill), 0, 0,
+                                                  max_tokens, {temperature, top_p},
+                                                  str(session_key)));
+}
+
+int32_t aigentik_engine_tokenize(aigentik_engine* engine, const char* text, bool add_special,
+                                 int32_t* tokens, int32_t capacity) {
+    if (!engine || !text) return 0;
+    const std::vector<llama_token> t = engine->engine.tokenize(text, add_special);
+    const int32_t n = (int32_t)t.size();
+    if (n > capacity || (n && !tokens)) return -n;
+    if (n) std::memcpy(tokens, t.data(), t.size() * sizeof(int32_t));
+    return n;
+}
+
+char* aigentik_engine_generate_tokens(aigentik_engine* engine, const int32_t* tokens,
+                                      size_t n_tokens, int32_t max_tokens,
+                                      float temperature, float top_p, const char* session_key) {
+    if (!engine || (n_tokens && !tokens)) return nullptr;
+    std::vector<llama_token> t(tokens, tokens + n_tokens);
+    return copyString(engine->engine.generateTokens(std::move(t), max_tokens, {temperature, top_p},
+                                                    str(session_key)));
+}
+
+int32_t aigentik_engine_context_size(aigentik_engine* engine) {
+    return engine ? engine->engine.contextSize() : 0;
+}
+
+void aigentik_engine_last_stats(aigentik_engine* engine, aigentik_stats* out) {
+    if (!out) return;
+    std::memset(out, 0, sizeof(*out));
+    if (!engine) return;
+    const GenerationStats st = engine->engine.lastStats();
+    out->tokenize_ms      = st.tokenizeMs;
+    out->prompt_tokens    = st.promptTokens;
+    out->reused_tokens    = st.reusedTokens;
+    out->restore_ms       = st.restoreMs;
+    out->prefill_ms       = st.prefillMs;
+    out->prefill_tps      = st.prefillTps;
+    out->ttft_ms          = st.ttftMs;
+    out->decode_ms        = st.decodeMs;
+    out->decode_tps       = st.decodeTps;
+    out->sampler_ms       = st.samplerMs;
+    out->generated_tokens = st.generatedTokens;
+    out->stop_reason      = (int32_t)st.stopReason;
+    out->peak_kv_cells    = st.peakKvCells;
+    out->total_ms         = st.totalMs;
+    out->prefill_cycles        = st.prefillCounters.cycles;
+    out->prefill_instructions  = st.prefillCounters.instructions;
+    out->prefill_cache_misses  = st.prefillCounters.cacheMisses;
+    out->prefill_branch_misses = st.prefillCounters.branchMisses;
+    out->decode_cycles         = st.decodeCounters.cycles;
+    out->decode_instructions   = st.decodeCounters.instructions;
+    out->decode_cache_misses   = st.decodeCounters.cacheMisses;
+    out->decode_branch_misses  = st.decodeCounters.branchMisses;
+    out->prefill_dtlb_misses   = st.prefillCounters.dtlbMisses;
+    out->decode_dtlb_misses    = st.decodeCounters.dtlbMisses;
+}
+
+char* aigentik_engine_model_info(aigentik_engine* engine) {
+    return engine ? copyString(engine->engine.modelInfo()) : nullptr;
+}
+
+void aigentik_string_free(char* s) {
+    std::free(s);
+}
@@ -0,0 +1,97 @@
+/* engine_api.h — C API over Engine (engine.h) for host tools and other languages.
+ *
+ *   aigentik_engine* e = aigentik_engine_create(NULL);
+ *   if (aigentik_engine_load(e, "model.gguf")) {
+ *       char* reply = aigentik_engine_generate(e, "Hello", 64, 0.7f, 0.9f, NULL);
+ *       ...
+ *       aigentik_string_free(reply);
+ *   }
+ *   aigentik_engine_free(e);
+ *
+ * Strings are UTF-8. Returned strings are heap-allocated and owned by the caller
+ * (aigentik_string_free); NULL means the call failed. An engine may be used from
+ * several threads — calls serialize the same way Engine's methods do.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct aigentik_engine aigentik_engine;
+
+/* Zero / negative fields keep the engine default (EngineConfig). */
+typedef struct {
+    int32_t ctx_size;
+    int32_t n_threads;
+    int32_t n_batch;
+    int32_t n_seq_max;
+    int32_t kv_type;       /* ggml_type; < 0 = default (Q8_0) */
+} aigentik_engine_config;
+
+/* Mirrors GenerationStats (generation.h). Hardware counters are -1 when unavailable. */
+typedef struct {
+    double  tokenize_ms;
+    int32_t prompt_tokens;
+    int32_t reused_tokens;
+    double  restore_ms;
+    double  prefill_ms;
+    double  prefill_tps;
+    double  ttft_ms;
+    double  decode_ms;
+    double  decode_tps;
+    double  sampler_ms;
+    int32_t generated_tokens;
+    int32_t stop_reason;   /* StopReason */
+    int32_t peak_kv_cells;
+    double  total_ms;
+    int64_t prefill_cycles, prefill_instructions, prefill_cache_misses, prefill_branch_misses;
+    int64_t decode_cycles,  decode_instructions,  decode_cache_misses,  decode_branch_misses;
+    int64_t prefill_dtlb_misses, decode_dtlb_misses;
+} aigentik_stats;
+
+/* config may be NULL (defaults). */
+aigentik_engine* aigentik_engine_create(const aigentik_engine_config* config);
+void             aigentik_engine_free(aigentik_engine* engine);
+
+bool aigentik_engine_load(aigentik_engine* engine, const char* model_path);
+void aigentik_engine_unload(aigentik_engine* engine);
+
+/* Raw prompt, tokenized with BOS. session_key may be NULL (stateless). */
+char* aigentik_engine_generate(aigentik_engine* engine, const char* prompt, int32_t max_tokens,
+                               float temperature, float top_p, const char* session_key);
+
+/* n_messages role/content pairs rendered with the model's chat template.
+ * assistant_prefill and session_key may be NULL. */
+char* aigentik_engine_generate_chat(aigentik_engine* engine, const char* const* roles,
+                                    const char* const* contents, size_t n_messages,
+                                    const char* assistant_prefill, int32_t max_tokens,
+                                    float temperature, float top_p, const char* session_key);
+
+/* Writes up to capacity token ids. Returns the token count, or -count if capacity
+ * is too small (nothing written), or 0 if nothing was tokenized. */
+int32_t aigentik_engine_tokenize(aigentik_engine* engine, const char* text, bool add_special,
+                                 int32_t* tokens, int32_t capacity);
+
+/* Generation from prompt token ids. */
+char* aigentik_engine_generate_tokens(aigentik_engine* engine, const int32_t* tokens,
+                                      size_t n_tokens, int32_t max_tokens,
+                                      float temperature, float top_p, const char* session_key);
+
+int32_t aigentik_engine_context_size(aigentik_engine* engine);
+
+/* Stats of the last single-prompt generation. */
+void aigentik_engine_last_stats(aigentik_engine* engine, aigentik_stats* out);
+
+/* Model / context summary line. */
+char* aigentik_engine_model_info(aigentik_engine* engine);
+
+void aigentik_string_free(char* s);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,78 @@
+// engine_state.h — the engine's status, published for lock-free readers.
+//
+// isLoaded(), contextSize() and modelInfo() are polled from the UI thread (state
+// label, dashboard, settings screens). They must not wait behind a generation or a
+// multi-second model load, and must not look at llama_model / llama_context
+// pointers that unload() is about to free. So the engine copies what they need —
+// state, model metadata, config — into an EngineStatus whenever it changes, and
+// readers only ever see that copy.
+//
+// Publishing is a sequence lock: the single writer (the engine, under its
+// generation mutex) makes the sequence odd, stores the payload, and makes it even
+// again. A reader copies the payload between two loads of the sequence and retries
+// if they differ or were odd. Readers take no lock and never block the writer;
+// a read only repeats if it overlapped a publish, which happens on load, unload
+// and at the start and end of each generation. The payload is held in relaxed
+// atomic words so a torn read is a retry rather than a data race.
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "metrics.h"
+
+struct EngineStatus {
+    EngineState state      = EngineState::NotLoaded;
+    uint64_t    loadCount  = 0;     // bumped by every successful load
+    int32_t     nVocab     = 0;
+    int32_t     nCtx       = 0;     // of the live context
+    int32_t     nCtxTrain  = 0;
+    int32_t     nLayer     = 0;
+    int32_t     nThreads   = 0;
+    int32_t     nBatch     = 0;
+    int32_t     kvType     = 0;     // ggml_type
+    int64_t     nParams    = 0;
+    int64_t     modelBytes = 0;
+    char        desc[64]         = {};    // llama_model_desc(), e.g. "qwen3 1.7B Q4_0"
+    char        templateName[32] = {};    // ChatPrompt::templateName()
+
+    // Model and context exist (generating counts as loaded).
+    bool loaded() const { return state == EngineState::Ready || state == EngineState::Generating; }
+};
+
+class EngineStatusCell {
+public:
+    EngineStatusCell() { publish(EngineStatus()); }
+
+    // Single writer — callers serialize (Engine holds its generation mutex).
+    void publish(const EngineStatus& s) {
+        uint64_t w[kWords] = {};
+        memcpy(w, &s, sizeof(s));
+        const uint64_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kWords; i++) words_[i].store(w[i], std::memory_order_relaxed);
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    EngineStatus read() const {
+        uint64_t w[kWords];
+        for (;;) {
+            const uint64_t before = seq_.load(std::memory_order_acquire);
+            if (before & 1) continue;
+            for (size_t i = 0; i < kWords; i++) w[i] = words_[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) == before) break;
+        }
+        EngineStatus s;
+        memcpy(&s, w, sizeof(s));
+        return s;
+    }
+
+private:
+    static_assert(std::is_trivially_copyable<EngineStatus>::value, "EngineStatus is copied bytewise");
+    static constexpr size_t kWords = (sizeof(EngineStatus) + 7) / 8;
+    std::atomic<uint64_t> seq_{0};
+    std::atomic<uint64_t> words_[kWords];
+};
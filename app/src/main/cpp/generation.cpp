@@ -0,0 +1,278 @@
+// generation.cpp — see generation.h.
+
+#define LOG_TAG "Generation"
+#include "generation.h"
+#include "aigentik_log.h"
+#include "metrics.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+void batchAdd(llama_batch& batch, llama_token tok, llama_pos pos, llama_seq_id seq, bool logits) {
+    const int i = batch.n_tokens++;
+    batch.token[i]     = tok;
+    batch.pos[i]       = pos;
+    batch.n_seq_id[i]  = 1;
+    batch.seq_id[i][0] = seq;
+    batch.logits[i]    = logits ? 1 : 0;
+}
+
+// One reply being generated in its own sequence during a bulk wave.
+struct Slot {
+    size_t         index;          // position in the caller's suffix list
+    llama_seq_id   seq;
+    llama_sampler* sampler;
+    llama_pos      pos;            // next free position in seq
+    llama_token    last   = -1;    // sampled, not yet decoded
+    int            logitIdx = -1;  // batch index holding this slot's logits
+    int            generated = 0;
+    bool           done   = false;
+};
+
+} // namespace
+
+llama_sampler* makeSampler(const SamplingParams& sp) {
+    llama_sampler_chain_params params = llama_sampler_chain_default_params();
+    params.no_perf = false;    // sampler time feeds GenerationStats
+    llama_sampler* chain = llama_sampler_chain_init(params);
+    if (sp.temperature <= 0.0f) {
+        llama_sampler_chain_add(chain, llama_sampler_init_greedy());
+    } else {
+        llama_sampler_chain_add(chain, llama_sampler_init_temp(sp.temperature));
+        llama_sampler_chain_add(chain, llama_sampler_init_top_p(sp.topP, 1));
+        llama_sampler_chain_add(chain, llama_sampler_init_dist(LLAMA_DEFAULT_SEED));
+    }
+    return chain;
+}
+
+std::vector<llama_token> tokenize(const llama_vocab* vocab, const std::string& text,
+                                  bool addSpecial) {
+    const int len = (int)text.size();
+    int n = -llama_tokenize(vocab, text.data(), len, nullptr, 0, addSpecial, true);
+    if (n <= 0) return {};
+    std::vector<llama_token> tokens(n);
+    if (llama_tokenize(vocab, text.data(), len, tokens.data(), n, addSpecial, true) != n) {
+        return {};
+    }
+    return tokens;
+}
+
+std::string detokenize(const llama_vocab* vocab, const std::vector<llama_token>& tokens,
+                       size_t from, size_t to) {
+    to = std::min(to, tokens.size());
+    if (from >= to) return {};
+    const int32_t n = (int32_t)(to - from);
+    std::string text(n * 4, '\0');
+    int32_t len = llama_detokenize(vocab, tokens.data() + from, n, &text[0], (int32_t)text.size(),
+                                   false, true);
+    if (len < 0) {
+        text.resize(-len);
+        len = llama_detokenize(vocab, tokens.data() + from, n, &text[0], (int32_t)text.size(),
+                               false, true);
+    }
+    text.resize(len > 0 ? len : 0);
+
+    // Byte-fallback tokens can split a character: skip leading continuation bytes
+    // and cut a lead byte whose sequence runs past the end.
+    size_t begin = 0;
+    while (begin < text.size() && ((unsigned char)text[begin] & 0xC0) == 0x80) begin++;
+    size_t end = text.size();
+    for (size_t back = 1; back <= 4 && back <= end - begin; back++) {
+        const unsigned char c = (unsigned char)text[end - back];
+        if ((c & 0xC0) == 0x80) continue;             // continuation — keep looking
+        const size_t need = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        if (need > back) end -= back;                 // incomplete trailing sequence
+        break;
+    }
+    return text.substr(begin, end - begin);
+}
+
+bool prefill(llama_context* ctx, llama_batch& batch, const std::vector<llama_token>& tokens,
+             int from, int to, llama_seq_id seq, bool wantLogits) {
+    const int nBatch = (int)llama_n_batch(ctx);
+    for (int start = from; start < to; start += nBatch) {
+        const int end = std::min(start + nBatch, to);
+        batch.n_tokens = 0;
+        for (int p = start; p < end; p++) {
+            batchAdd(batch, tokens[p], p, seq, wantLogits && p == to - 1);
+        }
+        if (llama_decode(ctx, batch) != 0) {
+            LOGE("Prompt decode failed at pos %d (seq %d)", start, seq);
+            return false;
+        }
+    }
+    return true;
+}
+
+// With l' = l - max: Z = sum e^l', p_i = e^l'_i / Z, H = log Z - sum p_i l'_i.
+void Confidence::add(const float* logits, int nVocab, llama_token tok) {
+    if (!logits || nVocab <= 0 || tok < 0 || tok >= nVocab) return;
+    const float maxLogit = *std::max_element(logits, logits + nVocab);
+    double z = 0, weighted = 0;
+    for (int i = 0; i < nVocab; i++) {
+        const double l = logits[i] - maxLogit;
+        const double e = std::exp(l);
+        z        += e;
+        weighted += e * l;
+    }
+    entropySum += std::log(z) - weighted / z;
+    minProb     = std::min(minProb, std::exp(logits[tok] - maxLogit) / z);
+    tokens++;
+}
+
+std::string tokenPiece(const llama_vocab* vocab, llama_token tok, bool& stop) {
+    stop = tok < 0 || llama_vocab_is_eog(vocab, tok);
+    if (stop) return {};
+
+    char buf[256];
+    int len = llama_token_to_piece(vocab, tok, buf, sizeof(buf), 0, false);
+    std::string piece;
+    if (len < 0) {
+        piece.resize(-len);
+        len = llama_token_to_piece(vocab, tok, &piece[0], (int)piece.size(), 0, false);
+        piece.resize(len > 0 ? len : 0);
+    } else {
+        piece.assign(buf, len);
+    }
+    // Some GGUF conversions do not flag <|im_end|> as EOG — catch it as text too.
+    if (piece.find("<|im_end|>") != std::string::npos) {
+        stop = true;
+        return {};
+    }
+    return piece;
+}
+
+std::vector<std::string> generateShared(llama_context* ctx,
+                                        const std::vector<llama_token>& prefix,
+                                        const std::vector<std::vector<llama_token>>& suffixes,
+                                        int maxTokens, int ctxMargin, const SamplingParams& sp) {
+    std::vector<std::string> replies(suffixes.size());
+    const llama_vocab* vocab = llama_model_get_vocab(llama_get_model(ctx));
+    const int nCtx    = (int)llama_n_ctx(ctx);
+    const int nBatch  = (int)llama_n_batch(ctx);
+    const int maxSeqs = (int)llama_n_seq_max(ctx) - 1;   // seq 0 holds the prefix
+    const int nPrefix = (int)prefix.size();
+    const int room    = nCtx - ctxMargin - nPrefix;      // cells left for suffix + reply
+
+    llama_memory_t mem = llama_get_memory(ctx);
+    llama_memory_clear(mem, true);
+
+    if (maxSeqs < 1 || nPrefix == 0 || room <= 0) {
+        LOGE("Bulk generate: unusable setup (seqs=%d prefix=%d ctx=%d)", maxSeqs, nPrefix, nCtx);
+        return replies;
+    }
+
+    llama_batch batch = llama_batch_init(std::max(nBatch, maxSeqs), 0, 1);
+    bool prefixDone = false;
+    {
+        TRACE_SCOPE("bulk_prefix_prefill");
+        prefixDone = prefill(ctx, batch, prefix, 0, nPrefix, 0, false);
+    }
+    if (!prefixDone) {
+        llama_batch_free(batch);
+        return replies;
+    }
+
+    // Sample each slot whose logits landed in the batch that was just decoded.
+    auto sampleReady = [&](std::vector<Slot>& slots) {
+        for (Slot& s : slots) {
+            if (s.logitIdx < 0) continue;
+            const llama_token tok = llama_sampler_sample(s.sampler, ctx, s.logitIdx);
+            s.logitIdx = -1;
+            bool stop = false;
+            std::string piece = tokenPiece(vocab, tok, stop);
+            if (stop) { s.done = true; continue; }
+            replies[s.index] += piece;
+            s.last = tok;
+            if (++s.generated >= maxTokens) s.done = true;
+        }
+    };
+
+    size_t next = 0;
+    int waves = 0;
+    while (next < suffixes.size()) {
+        // Assemble a wave: as many suffixes as there are free sequences and KV room.
+        std::vector<Slot> slots;
+        int budget = room;
+        while (next < suffixes.size() && (int)slots.size() < maxSeqs) {
+            const int cost = (int)suffixes[next].size() + maxTokens;
+            if (suffixes[next].empty() || cost > room) {
+                LOGE("Bulk item %zu does not fit (%d tokens + %d new, room %d) — skipped",
+                     next, (int)suffixes[next].size(), maxTokens, room);
+                next++;
+                continue;
+            }
+            if (cost > budget) break;
+            budget -= cost;
+            const llama_seq_id seq = (llama_seq_id)slots.size() + 1;
+            llama_memory_seq_cp(mem, 0, seq, -1, -1);
+            slots.push_back(Slot{next++, seq, makeSampler(sp), (llama_pos)nPrefix});
+        }
+        if (slots.empty()) continue;
+        waves++;
+        TRACE_SCOPE("bulk_wave");
+
+        // Prefill every suffix in shared batches; a slot's first token is sampled
+        // as soon as the chunk holding its last suffix token has been decoded.
+        bool ok = true;
+        batch.n_tokens = 0;
+        for (Slot& s : slots) {
+            const auto& suffix = suffixes[s.index];
+            for (size_t t = 0; t < suffix.size() && ok; t++) {
+                const bool last = t + 1 == suffix.size();
+                if (last) s.logitIdx = batch.n_tokens;
+                batchAdd(batch, suffix[t], s.pos++, s.seq, last);
+                if (batch.n_tokens == nBatch) {
+                    ok = llama_decode(ctx, batch) == 0;
+                    if (ok) sampleReady(slots);
+                    batch.n_tokens = 0;
+                }
+            }
+        }
+        if (ok && batch.n_tokens > 0) {
+            ok = llama_decode(ctx, batch) == 0;
+            if (ok) sampleReady(slots);
+        }
+        if (!ok) LOGE("Bulk suffix prefill failed in wave %d", waves);
+
+        // Decode all live replies together — one token per sequence per step.
+        while (ok) {
+            batch.n_tokens = 0;
+            for (Slot& s : slots) {
+                if (s.done) continue;
+                s.logitIdx = batch.n_tokens;
+                batchAdd(batch, s.last, s.pos++, s.seq, true);
+            }
+            if (batch.n_tokens == 0) break;
+            if (llama_decode(ctx, batch) != 0) {
+                LOGE("Bulk decode failed in wave %d", waves);
+                break;
+            }
+            sampleReady(slots);
+        }
+
+        // Wave totals for the metrics page; cells = shared prefix + every fork's tail.
+        int waveTokens = 0, wavePrompt = 0, cells = nPrefix;
+        for (const Slot& s : slots) {
+            waveTokens += s.generated;
+            wavePrompt += (int)suffixes[s.index].size();
+            cells      += s.pos - nPrefix;
+        }
+        metricsSetKvCells(cells);
+        metricsAddTokens(waveTokens, wavePrompt + (waves == 1 ? nPrefix : 0));
+
+        // Free the forked cells; the prefix in seq 0 stays for the next wave.
+        for (Slot& s : slots) {
+            llama_memory_seq_rm(mem, s.seq, -1, -1);
+            llama_sampler_free(s.sampler);
+        }
+    }
+
+    llama_batch_free(batch);
+    LOGI("Bulk generated %zu replies in %d wave(s), shared prefix %d tokens",
+         suffixes.size(), waves, nPrefix);
+    return replies;
+}
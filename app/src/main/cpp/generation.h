@@ -0,0 +1,117 @@
+// generation.h — JNI-free building blocks of the decode loop.
+//
+// Everything here operates on a caller-owned llama_context under the caller's
+// generation lock. Engine (engine.h) uses these for single-prompt generation and the
+// bulk (prefix-shared) path.
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include "llama.h"
+#include "perf_counters.h"
+
+struct SamplingParams {
+    float temperature = 0.7f;
+    float topP        = 0.9f;
+};
+
+// Why a generation ended. Values are part of the nativeLastStats() record.
+enum class StopReason : int {
+    None            = 0,    // did not run (empty prompt, no model)
+    EndOfGeneration = 1,    // model emitted an end-of-generation token
+    MaxTokens       = 2,    // maxTokens reached
+    ContextFull     = 3,    // ran into n_ctx - margin
+    Error           = 4,    // decode failure or prompt rejected
+};
+
+// Which model of a cascade answered. Values are part of the nativeLastStats() record.
+enum class CascadeTier : int {
+    None  = 0,    // not a cascade
+    Small = 1,    // the small model's draft was confident enough
+    Large = 2,    // escalated, or no small model was loaded
+};
+
+// Timings and counts of one single-prompt generation. Times are milliseconds.
+// decode and sampler figures come from llama_perf_context / llama_perf_sampler;
+// the rest from our own timers around each stage.
+struct GenerationStats {
+    double     tokenizeMs      = 0;   // prompt assembly: template, tokenize, summarize
+    int        promptTokens    = 0;
+    int        reusedTokens    = 0;   // restored from the KV session, not prefilled
+    double     restoreMs       = 0;   // KV session restore
+    double     prefillMs       = 0;
+    double     prefillTps      = 0;   // prefilled tokens per second
+    double     ttftMs          = 0;   // request start → first token sampled
+    double     decodeMs        = 0;
+    double     decodeTps       = 0;
+    double     samplerMs       = 0;
+    int        generatedTokens = 0;
+    StopReason stopReason      = StopReason::None;
+    int        peakKvCells     = 0;   // highest KV cell count in use
+    double     totalMs         = 0;
+    HwCounters prefillCounters;       // perf_counters.h — unavailable unless enabled
+    HwCounters decodeCounters;        // sampling + decode loop
+    // Cascade (Engine::generateCascade): the model that answered and how sure the
+    // small model was of its draft. When it escalated, the other fields describe the
+    // large model's run, and ttftMs / totalMs include draftMs.
+    CascadeTier cascadeTier      = CascadeTier::None;
+    double      draftMeanEntropy = 0;   // nats per token
+    double      draftMinProb     = 0;
+    double      draftMs          = 0;   // the small model's attempt
+};
+
+// How sure a model was of the tokens it sampled, from the softmax of the full logits
+// each was sampled from (temperature 1, no top-p): the entropy of that distribution
+// and the probability of the token drawn. That is the distribution a greedy sampler
+// takes the mode of; for a tempered or top-p sampler it is not the one drawn from.
+// Costs one pass over the vocabulary per token.
+struct Confidence {
+    int    tokens     = 0;
+    double entropySum = 0;    // nats
+    double minProb    = 1;
+
+    void add(const float* logits, int nVocab, llama_token tok);
+    double meanEntropy() const { return tokens ? entropySum / tokens : 0; }
+};
+
+inline double elapsedMs(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+// Sampler chain based on temperature:
+//   temperature == 0.0 → greedy (deterministic, used for command parsing)
+//   temperature  > 0.0 → temp → top_p → dist (stochastic, better for conversation)
+llama_sampler* makeSampler(const SamplingParams& sp);
+
+// Tokenize UTF-8 text. addSpecial adds BOS where the vocab wants it — true only for
+// the first segment of a prompt. Special tokens (<|im_start|> etc.) are parsed.
+std::vector<llama_token> tokenize(const llama_vocab* vocab, const std::string& text,
+                                  bool addSpecial);
+
+// Text of tokens[from, to) (special tokens rendered as text). A multi-byte UTF-8
+// character split at either end of the range is dropped, so any sub-range of a
+// prompt yields valid UTF-8.
+std::string detokenize(const llama_vocab* vocab, const std::vector<llama_token>& tokens,
+                       size_t from, size_t to);
+
+// Decode tokens[from, to) at positions from..to-1 into seq in chunks of at most
+// llama_n_batch(ctx). Logits are requested only for the final token when
+// wantLogits is set. batch must have room for llama_n_batch(ctx) tokens.
+bool prefill(llama_context* ctx, llama_batch& batch, const std::vector<llama_token>& tokens,
+             int from, int to, llama_seq_id seq, bool wantLogits);
+
+// Text of one sampled token; sets stop when generation should end there
+// (end-of-generation token or a ChatML end marker rendered as text).
+std::string tokenPiece(const llama_vocab* vocab, llama_token tok, bool& stop);
+
+// Prefix-shared bulk generation: prefix is decoded once into seq 0 and forked with
+// llama_memory_seq_cp into one sequence per suffix; the suffixes are prefilled and
+// all replies are decoded together, one batched llama_decode per step.
+// Suffixes are processed in waves bounded by llama_n_seq_max(ctx) - 1 sequences and
+// by what fits in llama_n_ctx(ctx) - ctxMargin alongside the prefix and maxTokens
+// per reply. A suffix that cannot fit even alone yields an empty reply. Clears the KV cache.
+std::vector<std::string> generateShared(llama_context* ctx,
+                                        const std::vector<llama_token>& prefix,
+                                        const std::vector<std::vector<llama_token>>& suffixes,
+                                        int maxTokens, int ctxMargin, const SamplingParams& sp);
@@ -0,0 +1,16 @@
+// hash_util.h — small non-cryptographic hash shared by the native caches.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64-bit FNV-1a. Fast and good enough for cache keys; callers that cannot
+// tolerate a collision keep the original text alongside and compare it.
+inline uint64_t fnv1a64(const void* data, size_t len, uint64_t h = 1469598103934665603ULL) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < len; i++) { h ^= p[i]; h *= 1099511628211ULL; }
+    return h;
+}
+
+inline uint64_t fnv1a64(const std::string& s) { return fnv1a64(s.data(), s.size()); }
@@ -0,0 +1,162 @@
+// huge_pages.cpp — see huge_pages.h.
+
+#define LOG_TAG "HugePages"
+#include "huge_pages.h"
+#include "aigentik_log.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sys/mman.h>
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23    // Linux 5.14
+#endif
+#ifndef MADV_COLLAPSE
+#define MADV_COLLAPSE 25    // Linux 6.1; older headers lack it
+#endif
+
+namespace {
+
+constexpr uintptr_t HUGE_PAGE = 2u << 20;
+
+// A size logged as "%.2f MiB" is off by up to 0.005 MiB; on top of that, a mapping
+// may be larger than the buffer by the allocator's header and page rounding.
+constexpr int64_t SIZE_ROUNDING = 8 << 10;
+constexpr int64_t SIZE_SLACK    = 128 << 10;
+
+bool isAnon(const char* name) {
+    if (*name == '\0') return true;
+    return std::strncmp(name, "[anon:", 6) == 0 && std::strncmp(name, "[anon:dalvik-", 13) != 0;
+}
+
+} // namespace
+
+std::string thpSetting() {
+    FILE* f = std::fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (!f) return "";
+    char line[128] = {};
+    const bool ok = std::fgets(line, sizeof(line), f) != nullptr;
+    std::fclose(f);
+    const char* open  = ok ? std::strchr(line, '[') : nullptr;
+    const char* close = open ? std::strchr(open, ']') : nullptr;
+    return close ? std::string(open + 1, close) : std::string();
+}
+
+std::vector<MemRange> anonMappings() {
+    std::vector<MemRange> out;
+    FILE* f = std::fopen("/proc/self/maps", "r");
+    if (!f) return out;
+    char line[512];
+    while (std::fgets(line, sizeof(line), f)) {
+        unsigned long start = 0, end = 0;
+        char perms[8] = {};
+        int nameAt = 0;
+        if (std::sscanf(line, "%lx-%lx %7s %*s %*s %*s %n", &start, &end, perms, &nameAt) < 3 || !nameAt) continue;
+        char* name = line + nameAt;
+        name[std::strcspn(name, "\n")] = '\0';
+        if (perms[0] == 'r' && perms[1] == 'w' && isAnon(name)) out.push_back({start, end});
+    }
+    std::fclose(f);
+    return out;
+}
+
+std::vector<MemRange> addedRanges(const std::vector<MemRange>& before,
+                                  const std::vector<MemRange>& after) {
+    std::vector<MemRange> out;
+    size_t b = 0;
+    for (const MemRange& a : after) {
+        uintptr_t cur = a.start;
+        while (b < before.size() && before[b].end <= cur) b++;
+        for (size_t i = b; i < before.size() && before[i].start < a.end; i++) {
+            if (before[i].start > cur) out.push_back({cur, before[i].start});
+            cur = std::max(cur, before[i].end);
+        }
+        if (cur < a.end) out.push_back({cur, a.end});
+    }
+    return out;
+}
+
+std::vector<MemRange> bufferRanges(const std::vector<MemRange>& added,
+                                   const std::vector<int64_t>& sizes) {
+    std::vector<MemRange> out;
+    std::vector<bool> used(sizes.size(), false);
+    for (const MemRange& r : added) {
+        const int64_t len = (int64_t)(r.end - r.start);
+        for (size_t i = 0; i < sizes.size(); i++) {
+            int64_t sum = 0;
+            size_t j = i;
+            for (; j < sizes.size() && !used[j]; j++) {
+                const int64_t n = (int64_t)(j - i + 1);
+                sum += sizes[j];
+                if (len < sum - n * SIZE_ROUNDING) { j = sizes.size(); break; }
+                if (len <= sum + n * (SIZE_ROUNDING + SIZE_SLACK)) break;
+            }
+            if (j >= sizes.size() || used[j]) continue;
+            for (size_t k = i; k <= j; k++) used[k] = true;
+            out.push_back(r);
+            break;
+        }
+    }
+    return out;
+}
+
+std::vector<MemRange> adviseHugePages(const std::vector<MemRange>& ranges, HugePageMode mode,
+                                      int& collapseErrors) {
+    std::vector<MemRange> advised;
+    if (mode == HugePageMode::Off) return advised;
+    for (const MemRange& r : ranges) {
+        const uintptr_t start = (r.start + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+        const uintptr_t end   = r.end & ~(HUGE_PAGE - 1);
+        if (end <= start) continue;
+        void* addr = reinterpret_cast<void*>(start);
+        if (madvise(addr, end - start, MADV_HUGEPAGE) != 0) {
+            LOGW("MADV_HUGEPAGE failed on %zu bytes: %s", (size_t)(end - start), strerror(errno));
+            continue;
+        }
+        if (mode == HugePageMode::Collapse && madvise(addr, end - start, MADV_COLLAPSE) != 0) {
+            if (collapseErrors++ == 0) LOGW("MADV_COLLAPSE failed: %s", strerror(errno));
+        }
+        advised.push_back({start, end});
+    }
+    return advised;
+}
+
+int64_t anonHugeBytes(const std::vector<MemRange>& ranges) {
+    if (ranges.empty()) return 0;
+    FILE* f = std::fopen("/proc/self/smaps", "r");
+    if (!f) return 0;
+    char line[512];
+    bool inRange = false;
+    int64_t kb = 0;
+    while (std::fgets(line, sizeof(line), f)) {
+        unsigned long start = 0, end = 0;
+        char dash = 0;
+        // Mapping headers start with "<start>-<end> "; field lines with "<Name>:".
+        if (std::sscanf(line, "%lx%c%lx ", &start, &dash, &end) == 3 && dash == '-') {
+            inRange = std::any_of(ranges.begin(), ranges.end(), [&](const MemRange& r) {
+                return r.start < end && start < r.end;
+            });
+        } else if (inRange && std::strncmp(line, "AnonHugePages:", 14) == 0) {
+            long long v = 0;
+            if (std::sscanf(line + 14, "%lld", &v) == 1) kb += v;
+        }
+    }
+    std::fclose(f);
+    return kb * 1024;
+}
+
+int64_t populateRanges(const std::vector<MemRange>& ranges) {
+    int64_t bytes = 0;
+    bool warned = false;
+    for (const MemRange& r : ranges) {
+        if (madvise(reinterpret_cast<void*>(r.start), r.end - r.start, MADV_POPULATE_WRITE) != 0) {
+            if (!warned) LOGW("MADV_POPULATE_WRITE failed: %s", strerror(errno));
+            warned = true;
+            continue;
+        }
+        bytes += (int64_t)(r.end - r.start);
+    }
+    return bytes;
+}
@@ -0,0 +1,88 @@
+// huge_pages.h — transparent huge pages for the engine's anonymous buffers, and
+// pre-faulting them.
+//
+// Decode streams the weights and the KV cache through the cores once per token;
+// with 4 KiB pages that is one TLB entry per 4 KiB, and a 2 GiB model plus a few
+// hundred MiB of KV overflow the L2 TLB many times over. Backing the same memory
+// with 2 MiB pages cuts the page walks by 512×.
+//
+// llama.cpp allocates the KV cache, the compute buffers and any anonymous weight
+// copies (use_mmap off, CPU_REPACK) through ggml's CPU buffer type, with no hook
+// for the allocator. So the engine snapshots the process's anonymous mappings
+// around model load and context creation, keeps the address ranges that appeared
+// and whose sizes match the buffers llama.cpp reported meanwhile on that thread
+// (memoryStatsBeginCapture() in memory_stats.h), and advises their 2 MiB-aligned
+// interiors:
+//
+//   Advise    MADV_HUGEPAGE — pages faulted from now on may be huge, and
+//             khugepaged collapses already-populated ranges in the background.
+//             llama.cpp clears the KV cache when it creates it, so without
+//             Collapse it is khugepaged that converts it, over seconds to minutes.
+//   Collapse  Advise plus MADV_COLLAPSE (Linux 6.1+): collapse synchronously now.
+//             Costs a copy of each region at context creation.
+//
+// Nothing happens unless the kernel's THP setting is "always" or "madvise"
+// (thpSetting()); many Android kernels ship with "never". Mapped weight files
+// are left alone — file-backed THP needs CONFIG_READ_ONLY_THP_FOR_FS, which phones
+// do not enable. Mappings other threads create during the window (the ART heap,
+// malloc arenas, another model loading or serving) are dropped unless one happens
+// to have exactly a reported buffer's size. A buffer the allocator placed inside
+// an existing mapping, or rounded up past the slack (jemalloc size classes), is
+// not advised.
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class HugePageMode : int {
+    Off      = 0,
+    Advise   = 1,
+    Collapse = 2,
+};
+
+struct MemRange {
+    uintptr_t start;
+    uintptr_t end;
+};
+
+struct HugePageStats {
+    std::string thp;                 // kernel setting; "" if THP is not built in
+    int64_t     advisedBytes   = 0;  // 2 MiB-aligned bytes given MADV_HUGEPAGE
+    int64_t     hugeBytes      = 0;  // AnonHugePages inside those ranges now
+    int         collapseErrors = 0;  // MADV_COLLAPSE calls that failed
+};
+
+// "always", "madvise" or "never" from /sys/kernel/mm/transparent_hugepage/enabled.
+std::string thpSetting();
+
+// Anonymous read-write mappings of this process, sorted by address. ART's heaps
+// ([anon:dalvik-*]) are never llama.cpp's and are left out.
+std::vector<MemRange> anonMappings();
+
+// Parts of `after` not covered by `before` (both sorted) — what an allocation added,
+// including growth merged into an existing mapping.
+std::vector<MemRange> addedRanges(const std::vector<MemRange>& before,
+                                  const std::vector<MemRange>& after);
+
+// The ranges of added (from addedRanges()) that are buffers of the given sizes, in
+// bytes: a range matches one size, or the sum of a run of consecutive sizes when the
+// kernel merged adjacent allocations into one mapping, within the rounding of
+// llama.cpp's MiB log lines plus allocator overhead. Each size is used once; ranges
+// that match none are dropped.
+std::vector<MemRange> bufferRanges(const std::vector<MemRange>& added,
+                                   const std::vector<int64_t>& sizes);
+
+// Advises the 2 MiB-aligned interior of every range of at least 2 MiB; returns the
+// advised ranges. collapseErrors counts failed MADV_COLLAPSE calls.
+std::vector<MemRange> adviseHugePages(const std::vector<MemRange>& ranges, HugePageMode mode,
+                                      int& collapseErrors);
+
+// AnonHugePages of the mappings overlapping ranges, from /proc/self/smaps.
+int64_t anonHugeBytes(const std::vector<MemRange>& ranges);
+
+// Faults in every page of ranges as if written, without changing their contents
+// (MADV_POPULATE_WRITE, Linux 5.14+), so a later first write does not stop for a
+// page fault. Returns the bytes populated; ranges the kernel refuses are skipped.
+// Commits every page, so only for ranges the caller owns (bufferRanges()).
+int64_t populateRanges(const std::vector<MemRange>& ranges);
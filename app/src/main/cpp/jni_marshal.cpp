@@ -0,0 +1,205 @@
+// jni_marshal.cpp — see jni_marshal.h. Conversion helpers moved out of
+// llama_jni.cpp in v3.0; their history is in that file's header.
+
+#include "jni_marshal.h"
+
+#include <algorithm>
+#include <cstring>
+#include "trace.h"
+
+#define LOG_TAG "LlamaJNI"
+#include "aigentik_log.h"
+
+namespace {
+
+// Global refs resolved once by jniMarshalInit(); read-only afterwards.
+struct JniRefs {
+    jclass    stringClass     = nullptr;
+    jmethodID stringFromBytes = nullptr;   // String(byte[], Charset)
+    jobject   utf8            = nullptr;   // StandardCharsets.UTF_8
+    jclass    byteArrayClass  = nullptr;   // byte[] — element type of reply arrays
+};
+JniRefs g_refs;
+
+jclass globalClass(JNIEnv* env, const char* name) {
+    jclass local = env->FindClass(name);
+    if (!local) return nullptr;
+    jclass global = (jclass)env->NewGlobalRef(local);
+    env->DeleteLocalRef(local);
+    return global;
+}
+
+} // namespace
+
+bool jniMarshalInit(JNIEnv* env) {
+    if (g_refs.utf8) return true;
+    JniRefs r;
+    r.stringClass    = globalClass(env, "java/lang/String");
+    r.byteArrayClass = globalClass(env, "[B");
+    jclass charsets  = env->FindClass("java/nio/charset/StandardCharsets");
+    if (r.stringClass && r.byteArrayClass && charsets) {
+        r.stringFromBytes = env->GetMethodID(r.stringClass, "<init>", "([BLjava/nio/charset/Charset;)V");
+        jfieldID field = env->GetStaticFieldID(charsets, "UTF_8", "Ljava/nio/charset/Charset;");
+        jobject utf8 = field ? env->GetStaticObjectField(charsets, field) : nullptr;
+        if (utf8) {
+            r.utf8 = env->NewGlobalRef(utf8);
+            env->DeleteLocalRef(utf8);
+        }
+    }
+    if (charsets) env->DeleteLocalRef(charsets);
+    if (env->ExceptionCheck()) env->ExceptionClear();
+    if (!r.stringFromBytes || !r.utf8) {
+        LOGE("jniMarshalInit: String / StandardCharsets lookup failed");
+        if (r.stringClass)    env->DeleteGlobalRef(r.stringClass);
+        if (r.byteArrayClass) env->DeleteGlobalRef(r.byteArrayClass);
+        if (r.utf8)           env->DeleteGlobalRef(r.utf8);
+        return false;
+    }
+    g_refs = r;
+    return true;
+}
+
+// Safe std::string → jstring conversion.
+// JNI NewStringUTF() requires Modified UTF-8: it does NOT support 4-byte standard
+// UTF-8 sequences (emoji, supplementary Unicode U+10000+). When an LLM produces
+// such bytes, NewStringUTF() calls abort() — killing the process immediately.
+// This helper creates a Java byte[] from raw bytes and uses the String(byte[], Charset)
+// constructor to decode standard UTF-8 safely in Java, supporting all Unicode.
+// The class, constructor and UTF_8 charset are the refs cached by jniMarshalInit()
+// — no FindClass / GetMethodID / charset-name string per call.
+//
+// JNI exception hygiene (v1.6 hardening):
+//   Per JNI spec, calling most JNI functions with a pending exception is undefined
+//   behaviour (only a small set of functions — DeleteLocalRef, ExceptionCheck,
+//   ExceptionClear, ExceptionOccurred — are safe to call with a pending exception).
+//   NewStringUTF("") as a fallback after a failed allocation is NOT in that safe set.
+//   Fix: ExceptionCheck()+ExceptionClear() before every fallback NewStringUTF("") call.
+jstring toJavaString(JNIEnv* env, const std::string& s) {
+    TRACE_SCOPE("jni_string_out");
+    if (s.empty()) return env->NewStringUTF("");
+
+    // toJavaBytes() clears the pending exception if the allocation fails.
+    jbyteArray arr = toJavaBytes(env, s);
+    if (!arr) return env->NewStringUTF("");
+
+    // NewObject can fail (OOM) and set a pending exception.
+    jstring result = (jstring)env->NewObject(g_refs.stringClass, g_refs.stringFromBytes,
+                                             arr, g_refs.utf8);
+    if (!result && env->ExceptionCheck()) env->ExceptionClear();
+    env->DeleteLocalRef(arr);
+    return result ? result : env->NewStringUTF("");
+}
+
+jbyteArray toJavaBytes(JNIEnv* env, const std::string& s) {
+    TRACE_SCOPE("jni_bytes_out");
+    jbyteArray arr = env->NewByteArray((jsize)s.size());
+    if (!arr) {
+        if (env->ExceptionCheck()) env->ExceptionClear();
+        return nullptr;
+    }
+    if (!s.empty()) {
+        env->SetByteArrayRegion(arr, 0, (jsize)s.size(), reinterpret_cast<const jbyte*>(s.data()));
+    }
+    return arr;
+}
+
+// One copy straight out of the array — no modified-UTF-8 conversion, no length scan.
+std::string fromJavaBytes(JNIEnv* env, jbyteArray arr) {
+    TRACE_SCOPE("jni_bytes_in");
+    if (!arr) return {};
+    const jsize n = env->GetArrayLength(arr);
+    std::string s((size_t)n, '\0');
+    if (n > 0) env->GetByteArrayRegion(arr, 0, n, reinterpret_cast<jbyte*>(&s[0]));
+    return s;
+}
+
+// jstring → std::string (null → ""). Kotlin strings never contain U+0000, so the
+// modified-UTF-8 bytes equal standard UTF-8 except for supplementary characters.
+std::string fromJavaString(JNIEnv* env, jstring js) {
+    TRACE_SCOPE("jni_string_in");
+    if (!js) return {};
+    const char* chars = env->GetStringUTFChars(js, nullptr);
+    if (!chars) {
+        if (env->ExceptionCheck()) env->ExceptionClear();
+        return {};
+    }
+    std::string s(chars, (size_t)env->GetStringUTFLength(js));
+    env->ReleaseStringUTFChars(js, chars);
+    return s;
+}
+
+// Read parallel role/content byte[] arrays into messages.
+std::vector<ChatMessage> toMessages(JNIEnv* env, jobjectArray roles, jobjectArray contents) {
+    const jsize count = std::min(env->GetArrayLength(roles), env->GetArrayLength(contents));
+    std::vector<ChatMessage> msgs(count);
+    for (jsize i = 0; i < count; i++) {
+        jbyteArray r = (jbyteArray)env->GetObjectArrayElement(roles, i);
+        jbyteArray c = (jbyteArray)env->GetObjectArrayElement(contents, i);
+        msgs[i].role    = fromJavaBytes(env, r);
+        msgs[i].content = fromJavaBytes(env, c);
+        if (r) env->DeleteLocalRef(r);
+        if (c) env->DeleteLocalRef(c);
+    }
+    return msgs;
+}
+
+// Copy tokens into a direct ByteBuffer of native-order int32 slots. Returns the
+// token count, or -count if the buffer is too small (caller grows it and retries).
+// 0 means nothing was tokenized.
+jint writeTokens(JNIEnv* env, jobject buf, const std::vector<llama_token>& tokens) {
+    if (tokens.empty()) return 0;
+    auto* dst = static_cast<int32_t*>(env->GetDirectBufferAddress(buf));
+    const jlong cap = env->GetDirectBufferCapacity(buf) / (jlong)sizeof(int32_t);
+    if (!dst || cap < 0) {
+        LOGE("Token buffer is not a direct buffer");
+        return 0;
+    }
+    const jint n = (jint)tokens.size();
+    if (n > cap) return -n;
+    std::memcpy(dst, tokens.data(), tokens.size() * sizeof(int32_t));
+    return n;
+}
+
+// Flattened GenerationStats — index order must match GenerationStats.fromArray() in
+// LlamaJNI.kt.
+std::vector<jdouble> statsToArray(const GenerationStats& st) {
+    return {
+        st.tokenizeMs, (jdouble)st.promptTokens, (jdouble)st.reusedTokens, st.restoreMs,
+        st.prefillMs, st.prefillTps, st.ttftMs, st.decodeMs, st.decodeTps, st.samplerMs,
+        (jdouble)st.generatedTokens, (jdouble)(int)st.stopReason, (jdouble)st.peakKvCells,
+        st.totalMs,
+        (jdouble)st.prefillCounters.cycles, (jdouble)st.prefillCounters.instructions,
+        (jdouble)st.prefillCounters.cacheMisses, (jdouble)st.prefillCounters.branchMisses,
+        (jdouble)st.decodeCounters.cycles, (jdouble)st.decodeCounters.instructions,
+        (jdouble)st.decodeCounters.cacheMisses, (jdouble)st.decodeCounters.branchMisses,
+        (jdouble)st.prefillCounters.dtlbMisses, (jdouble)st.decodeCounters.dtlbMisses,
+        (jdouble)(int)st.cascadeTier, st.draftMeanEntropy, st.draftMinProb, st.draftMs,
+    };
+}
+
+// byte[][] of replies; null (exception cleared) if the array cannot be allocated.
+// A reply whose bytes cannot be allocated is left null.
+jobjectArray toJavaBytesArray(JNIEnv* env, const std::vector<std::string>& values) {
+    jobjectArray out = env->NewObjectArray((jsize)values.size(), g_refs.byteArrayClass, nullptr);
+    if (!out) {
+        if (env->ExceptionCheck()) env->ExceptionClear();
+        return nullptr;
+    }
+    for (jsize i = 0; i < (jsize)values.size(); i++) {
+        jbyteArray bytes = toJavaBytes(env, values[i]);
+        if (!bytes) continue;
+        env->SetObjectArrayElement(out, i, bytes);
+        env->DeleteLocalRef(bytes);
+    }
+    return out;
+}
+
+jdoubleArray toJavaDoubleArray(JNIEnv* env, const std::vector<jdouble>& values) {
+    jdoubleArray arr = env->NewDoubleArray((jsize)values.size());
+    if (!arr) {
+        if (env->ExceptionCheck()) env->ExceptionClear();
+        return nullptr;
+    }
+    env->SetDoubleArrayRegion(arr, 0, (jsize)values.size(), values.data());
+    return arr;
+}
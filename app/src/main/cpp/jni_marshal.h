@@ -0,0 +1,46 @@
+// jni_marshal.h — conversions between JNI types and the engine's C++ types.
+//
+// Used by llama_jni.cpp for every argument and result, and by the host JNI
+// microbenchmark (bench/jni_bench.cpp), which runs these same functions under a
+// desktop JVM. Text on the hot path crosses as UTF-8 byte[] — prompts in, replies
+// out — so neither side goes through modified UTF-8; jstring is left for paths and
+// diagnostic strings. Failures never leave a Java exception pending: an allocation
+// that fails clears it and the helper returns an empty / null result.
+#pragma once
+
+#include <jni.h>
+#include <string>
+#include <vector>
+#include "chat_prompt.h"
+#include "generation.h"
+
+// Caches global refs to java.lang.String, its (byte[], Charset) constructor,
+// StandardCharsets.UTF_8 and the byte[] class. Call once (JNI_OnLoad) before any
+// other helper; false if a lookup failed.
+bool jniMarshalInit(JNIEnv* env);
+
+// UTF-8 byte[] ↔ std::string. fromJavaBytes: null → "". toJavaBytes: null if the
+// array cannot be allocated.
+std::string fromJavaBytes(JNIEnv* env, jbyteArray arr);
+jbyteArray  toJavaBytes(JNIEnv* env, const std::string& s);
+
+// std::string (standard UTF-8, may hold 4-byte sequences) → java.lang.String.
+// Never null: "" on failure.
+jstring toJavaString(JNIEnv* env, const std::string& s);
+
+// jstring → std::string; null → "".
+std::string fromJavaString(JNIEnv* env, jstring js);
+
+// Parallel role / content byte[] arrays → messages (the shorter array sets the count).
+std::vector<ChatMessage> toMessages(JNIEnv* env, jobjectArray roles, jobjectArray contents);
+
+// Token ids into a direct ByteBuffer of native-order int32 slots. Returns the
+// count, -count if the buffer is too small, 0 if tokens is empty.
+jint writeTokens(JNIEnv* env, jobject buf, const std::vector<llama_token>& tokens);
+
+// GenerationStats flattened in GenerationStats.fromArray() order (LlamaJNI.kt).
+std::vector<jdouble> statsToArray(const GenerationStats& st);
+
+// byte[][] / double[] results; null if the array cannot be allocated.
+jobjectArray toJavaBytesArray(JNIEnv* env, const std::vector<std::string>& values);
+jdoubleArray toJavaDoubleArray(JNIEnv* env, const std::vector<jdouble>& values);
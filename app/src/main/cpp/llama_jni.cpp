@@ -1,4 +1,154 @@
-// llama_jni.cpp v1.6
+// llama_jni.cpp v3.9
+// v3.9: Cascade. nativeGenerateCascade() drafts the reply with a small registered
+//   model and keeps the draft when the model was confident: it finished on its own,
+//   its mean token entropy stays under a limit, and no sampled token was less likely
+//   than a floor. Otherwise the primary model answers. nativeLastStats() appends the
+//   answering tier and the draft's entropy, min probability and time. The draft is
+//   greedy and capped at draftMaxTokens.
+// v3.8: Model registry. nativeAddModel(name, path) loads and warms a further model
+//   beside the primary one, blocking the caller; nativeRemoveModel(name) frees it and
+//   nativeModelNames() lists them. nativeGenerate() and nativeGenerateChat() take a
+//   trailing model name (null = primary), so a small model can serve command parsing
+//   while the large one writes replies.
+// v3.7: Hot swap. nativeSwapModelAsync(path, listener) loads and warms the new model
+//   while the current one keeps serving. It then switches new requests over once
+//   the request in flight finishes and frees the old model. It is refused
+//   (NO_MEMORY) when MemAvailable cannot hold both, and returns NOT_LOADED when
+//   there is nothing to keep serving. The listener reports progress and completion
+//   as for nativeLoadModelAsync().
+// v3.6: nativeWarmup() replaces the 4-token chat generation the app ran after load.
+//   It wakes the threadpool, faults in the KV cache and compute buffers
+//   (MADV_POPULATE_WRITE), and runs one llama_set_warmup graph over every weight plus
+//   one single-token decode, with no context reset and no sampling. It returns the
+//   time spent in each stage.
+// v3.5: Transparent huge pages (huge_pages.h). nativeSetHugePages(mode) advises the
+//   KV cache, compute buffers and anonymous weight copies with MADV_HUGEPAGE, and
+//   in Collapse mode also MADV_COLLAPSE, recreating the context if one exists.
+//   nativeHugePageInfo() reports the kernel THP setting and how many of the advised
+//   bytes are huge. GenerationStats carries dTLB read misses per phase at indices
+//   22-23 when the library is built with AIGENTIK_PERF_COUNTERS.
+// v3.4: Weight residency policy (weights_residency.h). nativeSetWeightsPolicy()
+//   chooses use_mmap / use_mlock for the next load and an madvise() hint
+//   (WILLNEED / SEQUENTIAL / RANDOM) plus an optional background page-touch pass
+//   applied after load. nativePrefetchWeights() re-applies the hint and the touch
+//   pass, e.g. before the first request after an idle period, and never waits behind
+//   a generation. nativeWeightsResidency() reports mapped, resident (mincore) and
+//   locked bytes and the duration of the last touch pass.
+// v3.3: Background model load. nativeLoadModelAsync(path, listener) loads on the
+//   engine's loader thread and returns at once; llama.cpp's progress_callback
+//   drives LoadListener.onProgress (once per percent) and a new loadProgressMilli
+//   field on the metrics page (layout version 2), and onComplete(ok) fires when the
+//   context is ready. nativeCancelLoad() stops the load at its next progress report,
+//   leaving the engine unloaded. The engine now owns one paused ggml threadpool,
+//   created on the first load in parallel with the weights and attached to every
+//   context, so decode no longer spins up a throwaway pool per graph.
+// v3.2: Lock-free status. nativeIsLoaded(), nativeGetContextSize() and
+//   nativeGetModelInfo() read a snapshot the engine republishes under its
+//   generation mutex on load, unload and around every request (engine_state.h) —
+//   state, vocab / context / layer counts, parameter count, model size, template
+//   and config. They no longer read the model and context pointers (isLoaded() did
+//   so unlocked and could race nativeUnload()) or wait for g_modelMutex, which a
+//   model load holds for seconds.
+// v3.1: JNI fast path. JNI_OnLoad caches global refs (java.lang.String, its
+//   (byte[], Charset) constructor, StandardCharsets.UTF_8, byte[]) and binds every
+//   native with RegisterNatives — the functions are no longer exported by their
+//   Java_ names, and a signature mismatch fails System.loadLibrary() instead of the
+//   first call. Prompts, chat messages, session keys and tokenizer input arrive as
+//   UTF-8 byte[] (one GetByteArrayRegion copy; no GetStringUTFChars modified-UTF-8
+//   conversion or length scan), and generated replies return as UTF-8 byte[] that
+//   Kotlin decodes — no String construction upcall from native code. toJavaString()
+//   uses the cached refs instead of FindClass / GetMethodID / NewStringUTF("UTF-8")
+//   per call; it remains for paths and diagnostic strings.
+// v3.0: Argument / result conversions (toJavaString, fromJavaString, toMessages,
+//   writeTokens, statsToArray) moved to jni_marshal.cpp, plus toJavaStringArray()
+//   and toJavaDoubleArray() for the bulk and stats results, so the host JNI
+//   microbenchmark (bench/jni_bench.cpp) measures the code the app ships.
+// v2.9: Thin JNI adapter over Engine (engine.h). Model/context lifetime, locking,
+//   generation, tokenization, stats and profiling moved into a JNI-free Engine
+//   class (with a C API in engine_api.h) that also builds on x86_64 Linux without
+//   the NDK; this file only converts Java arguments and results. The history below
+//   describes code that now lives in engine.cpp.
+// v2.8: nativeMemoryStats() (memory_stats.h) — weights mmap'd vs anonymous and
+//   resident, KV K/V bytes, compute buffers, malloc arena, RSS/PSS/swap and peak
+//   RSS since load. llama.cpp's log now goes to logcat (it went to stderr).
+// v2.7: Hardware counters (perf_counters.h) — cycles, instructions, cache and
+//   branch misses for the prefill and decode phases of each single-prompt
+//   generation, appended to the nativeLastStats() record (-1 when unavailable).
+//   Only built with AIGENTIK_PERF_COUNTERS=ON.
+// v2.6: Opt-in op profiling (op_profile.h). nativeSetOpProfiling(true) recreates the
+//   context with the profiler as its eval callback; wall time and call counts then
+//   accumulate per op type, tensor role and layer across generations until
+//   nativeOpProfileReport(reset) returns the sorted report.
+// v2.5: Trace spans (trace.h) around each pipeline stage — JNI string conversion,
+//   tokenize / chat template, session restore and save, prefill, per-token sample,
+//   detokenize and decode, context creation and model load. nativeTraceDump()
+//   returns Chrome trace JSON. Compiled out unless built with AIGENTIK_TRACE=ON.
+// v2.4: Zero-JNI metrics page (metrics.h). nativeMetricsBuffer() hands Kotlin a
+//   DirectByteBuffer over a fixed-layout block of atomics — engine state, active
+//   requests, queue depth, decode tok/s EWMA, KV cells, RSS, token totals — which
+//   the engine updates as it works. Generation entry points take g_mutex through
+//   GenerationLock so waiting and running requests are counted.
+//   nativeGetModelInfo() now holds g_modelMutex (shared) instead of reading the
+//   model and context unlocked.
+// v2.3: Per-generation stats. runGeneration() fills a GenerationStats record —
+//   prompt assembly time, session restore, prefill ms and tok/s, time to first
+//   token, decode tok/s and sampler time (llama_perf_context/llama_perf_sampler,
+//   now enabled with no_perf = false), tokens generated, stop reason and peak KV
+//   cells. nativeLastStats() returns the last record as a double[] (layout in
+//   statsToArray()); it takes only g_statsMutex, never the generation lock.
+// v2.2: Map-reduce summarization of over-length threads (summarize.h).
+//   nativeGenerateChat() takes summarizeAbove: content spans Kotlin marks as
+//   summarizable and that exceed it are chunked, summarized chunk-parallel through
+//   generateShared(), re-summarized if still too long, and replaced by the result
+//   before the reply prompt is built. Other entry points strip the span markers.
+// v2.1: Prompts that fit by construction. Chat entry points build through
+//   ChatPrompt::buildFitted(): content spans Kotlin marks as truncatable (an email
+//   body, a pasted message) are cut to segmentBudget tokens and, if the prompt plus
+//   maxTokens would still overflow n_ctx - ctxMargin, cut further — head and tail
+//   kept, an omission marker in between. Prefill length is bounded and long emails
+//   no longer come back as "Prompt too long". nativeTokenizeChat() takes the reply
+//   budget to reserve; bulk prompts are fitted individually (each fork needs the
+//   same room as a single prompt).
+// v2.0: Token-level API for Kotlin-side prompt budgeting.
+//   nativeTokenize() and nativeTokenizeChat() write token ids into a caller-owned
+//   direct ByteBuffer (no per-call int[] allocation); nativeCountTokens() returns
+//   just the count; nativeGenerateTokens() generates from a token array the caller
+//   already holds, so a prompt that was measured is not tokenized a second time.
+//   Plain tokenization only reads the vocab, so it takes g_modelMutex (shared)
+//   instead of g_mutex and does not wait behind a running generation.
+// v1.9: Model-native chat templates (chat_prompt.h).
+//   nativeGenerateChat() takes structured messages (role + content) and renders them
+//   with the loaded model's own template via llama_chat_apply_template (ChatML when
+//   the GGUF has none). Each message's rendered segment is tokenized separately
+//   through a hash-keyed cache, so unchanged system/persona segments are never
+//   re-tokenized. nativeGenerateBulk() now takes a system prompt plus user messages;
+//   the shared prefix is the longest common token prefix of the rendered prompts,
+//   so it follows whatever template the model uses.
+//   The decode loop shared by all entry points lives in runGeneration().
+// v1.8: Prefix-sharing bulk generation (nativeGenerateBulk).
+//   The shared system/persona prefix is prefilled once into seq 0 and forked with
+//   llama_memory_seq_cp into one sequence per email; every suffix is prefilled and
+//   all replies decode together in one batched llama_decode per step. Fork cells are
+//   shared in the unified KV cache, so memory stays close to one prefix's worth.
+//   Context now has N_SEQ_MAX sequences with kv_unified=true (without it n_ctx is
+//   split evenly across sequences and single prompts would lose 7/8 of the window).
+//   Sampler construction, chunked prefill and token→text moved to generation.cpp;
+//   end of generation now uses llama_vocab_is_eog() (covers <|im_end|> and
+//   <|endoftext|>) rather than EOS alone.
+// v1.7: Per-contact KV session cache (session_cache.h).
+//   nativeGenerate() takes an optional sessionKey. When set, the KV state saved for
+//   that key after its previous generation is restored into seq 0 and only the
+//   tokens after the longest common prefix are prefilled; the resulting state is
+//   saved back afterwards. Sessions are kept in RAM under a configurable budget and
+//   least-recently-used ones are spilled as zlib-compressed files (see
+//   nativeConfigureSessions / nativeGetSessionStats).
+//   Between generations the KV cache is now cleared with llama_memory_clear()
+//   instead of destroying and recreating the context — the llama_memory_* API
+//   replaces the llama_kv_self_* names that v1.5 found missing. resetContext() is
+//   still used on model load.
+//   Prompt prefill is decoded in N_BATCH chunks — llama_decode() rejects batches
+//   larger than the context's n_batch.
+//   Logging macros moved to aigentik_log.h (shared with the other native sources).
 // v1.6: toJavaString() JNI exception hygiene hardening.
 //   If NewByteArray() fails (OOM), a Java OutOfMemoryError is pending. Calling
 //   NewStringUTF("") with a pending exception is undefined behaviour per JNI spec
@@ -34,264 +184,442 @@
 //   - context safety margin increased 10 → 32 tokens
 
 #include <jni.h>
+#include <cstdio>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
-#include <mutex>
-#include <cstring>
-#include <android/log.h>
-#include "llama.h"
+#include "engine.h"
+#include "jni_marshal.h"
+#include "metrics.h"
+#include "trace.h"
 
 #define LOG_TAG "LlamaJNI"
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO,  LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
-
-// Inference configuration — tuned for Snapdragon 8 Gen 3 (S24 Ultra)
-static const int      CTX_SIZE  = 8192;
-static const int      N_THREADS = 6;
-static const int      N_BATCH   = 256;
-static const ggml_type KV_TYPE  = GGML_TYPE_Q8_0;
-
-static llama_model*   g_model = nullptr;
-static llama_context* g_ctx   = nullptr;
-static std::mutex     g_mutex;
-
-// Safe std::string → jstring conversion.
-// JNI NewStringUTF() requires Modified UTF-8: it does NOT support 4-byte standard
-// UTF-8 sequences (emoji, supplementary Unicode U+10000+). When an LLM produces
-// such bytes, NewStringUTF() calls abort() — killing the process immediately.
-// This helper creates a Java byte[] from raw bytes and uses the String(byte[], charset)
-// constructor to decode standard UTF-8 safely in Java, supporting all Unicode.
-//
-// JNI exception hygiene (v1.6 hardening):
-//   Per JNI spec, calling most JNI functions with a pending exception is undefined
-//   behaviour (only a small set of functions — DeleteLocalRef, ExceptionCheck,
-//   ExceptionClear, ExceptionOccurred — are safe to call with a pending exception).
-//   NewStringUTF("") as a fallback after a failed allocation is NOT in that safe set.
-//   Fix: ExceptionCheck()+ExceptionClear() before every fallback NewStringUTF("") call.
-static jstring toJavaString(JNIEnv* env, const std::string& s) {
-    if (s.empty()) return env->NewStringUTF("");
-
-    // Step 1: Allocate byte array. NewByteArray can fail (OOM) and set a pending exception.
-    jbyteArray arr = env->NewByteArray((jsize)s.size());
-    if (!arr) {
-        if (env->ExceptionCheck()) env->ExceptionClear();
-        return env->NewStringUTF("");
-    }
-    env->SetByteArrayRegion(arr, 0, (jsize)s.size(),
-                            reinterpret_cast<const jbyte*>(s.data()));
+#include "aigentik_log.h"
 
-    // Step 2: Resolve java.lang.String. FindClass can theoretically fail under OOM.
-    jclass strClass = env->FindClass("java/lang/String");
-    if (!strClass) {
-        env->DeleteLocalRef(arr);
-        if (env->ExceptionCheck()) env->ExceptionClear();
-        return env->NewStringUTF("");
-    }
+// The app's one engine. Never destroyed — the process exits with it.
+static Engine& engine() {
+    static Engine* e = new Engine();
+    return *e;
+}
 
-    jmethodID ctor  = env->GetMethodID(strClass, "<init>", "([BLjava/lang/String;)V");
-    jstring charset = env->NewStringUTF("UTF-8");
+static jboolean nativeLoadModel(JNIEnv* env, jobject, jstring modelPath) {
+    return engine().load(fromJavaString(env, modelPath)) ? JNI_TRUE : JNI_FALSE;
+}
 
-    // Step 3: Construct the String. NewObject can fail (OOM) and set a pending exception.
-    jstring result = nullptr;
-    if (ctor && charset) {
-        result = (jstring)env->NewObject(strClass, ctor, arr, charset);
-        if (!result && env->ExceptionCheck()) env->ExceptionClear();
+// LlamaJNI.LoadListener, resolved in JNI_OnLoad.
+static JavaVM*   g_vm;
+static jmethodID g_onLoadProgress;    // (F)V
+static jmethodID g_onLoadComplete;    // (Z)V
+
+// The calling thread's JNIEnv. A native thread is attached to the VM on its first
+// upcall and stays attached until it exits, so a load's progress upcalls cost one
+// attach, not one each (every attach creates a java.lang.Thread). Null if the
+// thread cannot be attached.
+static JNIEnv* threadEnv() {
+    struct Attachment {
+        bool attached = false;
+        ~Attachment() {
+            if (attached) g_vm->DetachCurrentThread();
+        }
+    };
+    JNIEnv* e = nullptr;
+    if (g_vm->GetEnv(reinterpret_cast<void**>(&e), JNI_VERSION_1_6) == JNI_OK) return e;
+    thread_local Attachment attachment;
+    if (g_vm->AttachCurrentThread(&e, nullptr) != JNI_OK) {
+        LOGE("Cannot attach thread to the VM — load listener not called");
+        return nullptr;
     }
+    attachment.attached = true;
+    return e;
+}
 
-    env->DeleteLocalRef(arr);
-    if (charset) env->DeleteLocalRef(charset);
-    env->DeleteLocalRef(strClass);
+// A global ref to the listener, deleted when the last callback holding it is
+// destroyed — after onDone on the loader thread, or on the calling thread when the
+// engine refuses the load — so no path leaks it.
+using ListenerRef = std::shared_ptr<_jobject>;
+
+static ListenerRef listenerRef(JNIEnv* env, jobject listener) {
+    if (!listener) return nullptr;
+    return ListenerRef(env->NewGlobalRef(listener), [](jobject ref) {
+        JNIEnv* e = threadEnv();
+        if (e && ref) e->DeleteGlobalRef(ref);
+    });
+}
 
-    return result ? result : env->NewStringUTF("");
+// LoadListener upcalls from the engine's loader thread. Progress reaches the
+// listener once per whole percent (llama.cpp reports per tensor).
+static void listenerCallbacks(const ListenerRef& ref, LoadProgressFn& onProgress,
+                              LoadDoneFn& onDone) {
+    auto lastPercent = std::make_shared<int>(-1);
+    onProgress = [ref, lastPercent](float progress) {
+        const int percent = (int)(progress * 100.0f);
+        if (!ref || percent == *lastPercent) return true;
+        *lastPercent = percent;
+        if (JNIEnv* e = threadEnv()) {
+            e->CallVoidMethod(ref.get(), g_onLoadProgress, (jfloat)progress);
+            if (e->ExceptionCheck()) e->ExceptionClear();
+        }
+        return true;
+    };
+    onDone = [ref](bool ok) {
+        if (!ref) return;
+        if (JNIEnv* e = threadEnv()) {
+            e->CallVoidMethod(ref.get(), g_onLoadComplete, ok ? JNI_TRUE : JNI_FALSE);
+            if (e->ExceptionCheck()) e->ExceptionClear();
+        }
+    };
 }
 
-// Recreate context to clear KV cache between generations
-// Q8_0 KV cache: ~128MB at 8k ctx vs ~512MB F16 — fits comfortably in 6GB RAM
-static bool resetContext() {
-    if (!g_model) return false;
-    if (g_ctx) {
-        llama_free(g_ctx);
-        g_ctx = nullptr;
-    }
-    llama_context_params cp = llama_context_default_params();
-    cp.n_ctx           = CTX_SIZE;
-    cp.n_batch         = N_BATCH;
-    cp.n_ubatch        = N_BATCH;
-    cp.n_threads       = N_THREADS;
-    cp.n_threads_batch = N_THREADS;
-    cp.type_k          = KV_TYPE;
-    cp.type_v          = KV_TYPE;
-    g_ctx = llama_init_from_model(g_model, cp);
-    if (!g_ctx) {
-        LOGE("Context reset failed");
-        return false;
-    }
-    LOGI("Context reset: ctx=%d batch=%d threads=%d kv=Q8_0", CTX_SIZE, N_BATCH, N_THREADS);
-    return true;
+// Background load on the engine's loader thread. False if a load is running.
+static jboolean nativeLoadModelAsync(JNIEnv* env, jobject, jstring modelPath, jobject listener) {
+    LoadProgressFn onProgress;
+    LoadDoneFn onDone;
+    listenerCallbacks(listenerRef(env, listener), onProgress, onDone);
+    const bool started =
+        engine().loadAsync(fromJavaString(env, modelPath), std::move(onProgress), std::move(onDone));
+    return started ? JNI_TRUE : JNI_FALSE;
 }
 
-extern "C"
-JNIEXPORT jboolean JNICALL
-Java_com_aigentik_app_ai_LlamaJNI_nativeLoadModel(
-        JNIEnv* env, jobject, jstring modelPath) {
+// Hot swap — returns a SwapResult ordinal; the listener is only called when the
+// swap started (0).
+static jint nativeSwapModelAsync(JNIEnv* env, jobject, jstring modelPath, jobject listener) {
+    LoadProgressFn onProgress;
+    LoadDoneFn onDone;
+    listenerCallbacks(listenerRef(env, listener), onProgress, onDone);
+    return (jint)engine().swapAsync(fromJavaString(env, modelPath), std::move(onProgress),
+                                    std::move(onDone));
+}
 
-    std::lock_guard<std::mutex> lock(g_mutex);
-    const char* path = env->GetStringUTFChars(modelPath, nullptr);
-    LOGI("Loading model: %s", path);
+static void nativeCancelLoad(JNIEnv*, jobject) {
+    engine().cancelLoad();
+}
 
-    if (g_ctx)   { llama_free(g_ctx);         g_ctx   = nullptr; }
-    if (g_model) { llama_model_free(g_model); g_model = nullptr; }
+// prompt and sessionKey (nullable) are UTF-8; sessionKey: per-contact KV reuse —
+// see engine.h. model (nullable): registered model to run, null = primary. Returns
+// the reply as UTF-8, null if it could not be allocated.
+static jbyteArray nativeGenerate(JNIEnv* env, jobject, jbyteArray prompt, jint maxTokens,
+                                 jfloat temperature, jfloat topP, jbyteArray sessionKey,
+                                 jstring model) {
+    return toJavaBytes(env, engine().generate(fromJavaBytes(env, prompt), maxTokens,
+                                              {temperature, topP}, fromJavaBytes(env, sessionKey),
+                                              fromJavaString(env, model)));
+}
+
+// Structured chat generation: messages are rendered with the model's own template.
+// assistantPrefill (nullable) is appended after the assistant header verbatim.
+// segmentBudget: token cap for each truncatable span (0 = cut only to fit).
+// summarizeAbove: summarizable spans longer than this are summarized (0 = never).
+static jbyteArray nativeGenerateChat(JNIEnv* env, jobject, jobjectArray roles, jobjectArray contents,
+                                     jbyteArray assistantPrefill, jint segmentBudget,
+                                     jint summarizeAbove, jint maxTokens, jfloat temperature,
+                                     jfloat topP, jbyteArray sessionKey, jstring model) {
+    return toJavaBytes(env, engine().generateChat(toMessages(env, roles, contents),
+                                                  fromJavaBytes(env, assistantPrefill),
+                                                  segmentBudget, summarizeAbove, maxTokens,
+                                                  {temperature, topP},
+                                                  fromJavaBytes(env, sessionKey),
+                                                  fromJavaString(env, model)));
+}
 
-    llama_model_params mp = llama_model_default_params();
-    mp.n_gpu_layers = 0;
-    g_model = llama_model_load_from_file(path, mp);
-    env->ReleaseStringUTFChars(modelPath, path);
+// generateChat() through a cascade: small (registered name) drafts, the primary
+// model answers when the draft is not confident enough — see Engine::generateCascade().
+static jbyteArray nativeGenerateCascade(JNIEnv* env, jobject, jobjectArray roles,
+                                        jobjectArray contents, jbyteArray assistantPrefill,
+                                        jint segmentBudget, jint maxTokens, jfloat temperature,
+                                        jfloat topP, jbyteArray sessionKey, jstring small,
+                                        jfloat maxMeanEntropy, jfloat minTokenProb,
+                                        jint draftMaxTokens) {
+    CascadeParams cascade;
+    cascade.small          = fromJavaString(env, small);
+    cascade.maxMeanEntropy = maxMeanEntropy;
+    cascade.minTokenProb   = minTokenProb;
+    cascade.draftMaxTokens = draftMaxTokens;
+    return toJavaBytes(env, engine().generateCascade(toMessages(env, roles, contents),
+                                                     fromJavaBytes(env, assistantPrefill),
+                                                     segmentBudget, maxTokens, {temperature, topP},
+                                                     fromJavaBytes(env, sessionKey), cascade));
+}
 
-    if (!g_model) { LOGE("Model load failed"); return JNI_FALSE; }
-    if (!resetContext()) return JNI_FALSE;
+// Bulk generation: one reply per user message, all sharing systemPrompt; the common
+// token prefix is decoded once and forked. Returns replies in order; a reply is
+// empty if it could not be produced. segmentBudget as nativeGenerateChat().
+static jobjectArray nativeGenerateBulk(JNIEnv* env, jobject, jbyteArray systemPrompt,
+                                       jobjectArray userArr, jint segmentBudget, jint maxTokens,
+                                       jfloat temperature, jfloat topP) {
+    const jsize count = env->GetArrayLength(userArr);
+    std::vector<std::string> users(count);
+    for (jsize i = 0; i < count; i++) {
+        jbyteArray bytes = (jbyteArray)env->GetObjectArrayElement(userArr, i);
+        users[i] = fromJavaBytes(env, bytes);
+        if (bytes) env->DeleteLocalRef(bytes);
+    }
+    return toJavaBytesArray(env, engine().generateBulk(fromJavaBytes(env, systemPrompt), users,
+                                                       segmentBudget, maxTokens,
+                                                       {temperature, topP}));
+}
 
-    LOGI("Model ready — ctx=%d kv=Q8_0 threads=%d", CTX_SIZE, N_THREADS);
-    return JNI_TRUE;
+// Tokenize text as-is (no chat template). addSpecial adds BOS where the vocab wants it.
+static jint nativeTokenize(JNIEnv* env, jobject, jbyteArray text, jboolean addSpecial, jobject buf) {
+    return writeTokens(env, buf, engine().tokenize(fromJavaBytes(env, text), addSpecial));
 }
 
-extern "C"
-JNIEXPORT jstring JNICALL
-Java_com_aigentik_app_ai_LlamaJNI_nativeGenerate(
-        JNIEnv* env, jobject, jstring promptStr, jint maxTokens,
-        jfloat temperature, jfloat topP) {
+// Token count of text as it would appear inside a prompt (no BOS); -1 = no model.
+static jint nativeCountTokens(JNIEnv* env, jobject, jbyteArray text) {
+    return engine().countTokens(fromJavaBytes(env, text));
+}
 
-    std::lock_guard<std::mutex> lock(g_mutex);
+// Full prompt tokens for a chat — exactly what nativeGenerateChat() would decode
+// with maxTokens = reserveTokens.
+static jint nativeTokenizeChat(JNIEnv* env, jobject, jobjectArray roles, jobjectArray contents,
+                               jbyteArray assistantPrefill, jint reserveTokens, jint segmentBudget,
+                               jobject buf) {
+    return writeTokens(env, buf,
+                       engine().tokenizeChat(toMessages(env, roles, contents),
+                                             fromJavaBytes(env, assistantPrefill),
+                                             reserveTokens, segmentBudget));
+}
 
-    if (!g_model || !g_ctx) {
-        LOGE("Generate called — no model loaded");
-        return env->NewStringUTF("");
+// Generation from prompt tokens (e.g. from nativeTokenizeChat).
+static jbyteArray nativeGenerateTokens(JNIEnv* env, jobject, jintArray tokenArr, jint maxTokens,
+                                       jfloat temperature, jfloat topP, jbyteArray sessionKey) {
+    std::vector<llama_token> tokens(tokenArr ? env->GetArrayLength(tokenArr) : 0);
+    if (!tokens.empty()) {
+        env->GetIntArrayRegion(tokenArr, 0, (jsize)tokens.size(), reinterpret_cast<jint*>(tokens.data()));
     }
+    return toJavaBytes(env, engine().generateTokens(std::move(tokens), maxTokens, {temperature, topP},
+                                                    fromJavaBytes(env, sessionKey)));
+}
 
-    // Reset context to clear KV cache from the previous generation.
-    if (!resetContext()) return env->NewStringUTF("");
+// Context window in tokens (0 when no model is loaded).
+static jint nativeGetContextSize(JNIEnv*, jobject) {
+    return engine().contextSize();
+}
 
-    const char* prompt = env->GetStringUTFChars(promptStr, nullptr);
-    const llama_vocab* vocab = llama_model_get_vocab(g_model);
+// Stats of the last single-prompt generation (all zero before the first one).
+static jdoubleArray nativeLastStats(JNIEnv* env, jobject) {
+    return toJavaDoubleArray(env, statsToArray(engine().lastStats()));
+}
 
-    int n = -llama_tokenize(vocab, prompt, (int)strlen(prompt), nullptr, 0, true, true);
-    if (n <= 0) {
-        LOGE("Tokenize failed (n=%d)", n);
-        env->ReleaseStringUTFChars(promptStr, prompt);
-        return env->NewStringUTF("");
-    }
+// The metrics page as a DirectByteBuffer — static storage, valid for the life of
+// the process. Kotlin maps it once (EngineMetrics) and reads it without JNI.
+static jobject nativeMetricsBuffer(JNIEnv* env, jobject) {
+    return env->NewDirectByteBuffer(&metrics(), (jlong)sizeof(MetricsPage));
+}
+
+// Warm-up stage timings as double[] — index order matches WarmupStats.fromArray()
+// in LlamaJNI.kt.
+static jdoubleArray nativeWarmup(JNIEnv* env, jobject) {
+    const WarmupStats w = engine().warmup();
+    return toJavaDoubleArray(env, {
+        w.ok ? 1.0 : 0.0, w.threadsMs, w.touchMs, (jdouble)w.touchedBytes, w.graphMs,
+        w.decodeMs, w.totalMs,
+    });
+}
 
-    std::vector<llama_token> tokens(n);
-    llama_tokenize(vocab, prompt, (int)strlen(prompt), tokens.data(), n, true, true);
-    env->ReleaseStringUTFChars(promptStr, prompt);
+// Weight mapping policy — see weights_residency.h. advice: WeightsAdvice ordinal.
+static void nativeSetWeightsPolicy(JNIEnv*, jobject, jboolean useMmap, jboolean useMlock,
+                                   jint advice, jboolean touchPages) {
+    WeightsPolicy p;
+    p.useMmap    = useMmap;
+    p.useMlock   = useMlock;
+    p.advice     = advice >= 0 && advice <= (jint)WeightsAdvice::Random ? (WeightsAdvice)advice
+                                                                      : WeightsAdvice::None;
+    p.touchPages = touchPages;
+    engine().setWeightsPolicy(p);
+}
 
-    LOGI("Prompt tokens: %d  max_new: %d  ctx: %d", n, (int)maxTokens, CTX_SIZE);
+static void nativePrefetchWeights(JNIEnv*, jobject) {
+    engine().prefetchWeights();
+}
 
-    if (n >= CTX_SIZE - 32) {
-        LOGE("Prompt too long: %d tokens (limit %d)", n, CTX_SIZE - 32);
-        return env->NewStringUTF("Prompt too long for context window.");
+// Weight residency as long[] — index order matches WeightsResidency.fromArray() in
+// LlamaJNI.kt. mincore() over the model mappings; fine for a diagnostics screen.
+static jlongArray nativeWeightsResidency(JNIEnv* env, jobject) {
+    const WeightsResidency w = engine().weightsResidency();
+    const jlong values[] = {
+        w.mappedBytes, w.residentBytes, w.lockedBytes,
+        w.lastTouchMs < 0 ? -1 : (jlong)(w.lastTouchMs * 1000.0), w.touching ? 1 : 0,
+    };
+    const jsize n = (jsize)(sizeof(values) / sizeof(values[0]));
+    jlongArray arr = env->NewLongArray(n);
+    if (!arr) {
+        if (env->ExceptionCheck()) env->ExceptionClear();
+        return nullptr;
     }
+    env->SetLongArrayRegion(arr, 0, n, values);
+    return arr;
+}
 
-    // Build sampler chain based on temperature:
-    //   temperature == 0.0 → greedy (deterministic, used for command parsing)
-    //   temperature  > 0.0 → temp → top_p → dist (stochastic, better for conversation)
-    llama_sampler_chain_params sparams = llama_sampler_chain_default_params();
-    llama_sampler* sampler = llama_sampler_chain_init(sparams);
-    if (temperature <= 0.0f) {
-        llama_sampler_chain_add(sampler, llama_sampler_init_greedy());
-    } else {
-        llama_sampler_chain_add(sampler, llama_sampler_init_temp(temperature));
-        llama_sampler_chain_add(sampler, llama_sampler_init_top_p(topP, 1));
-        llama_sampler_chain_add(sampler, llama_sampler_init_dist(LLAMA_DEFAULT_SEED));
-    }
+// Huge-page mode — see huge_pages.h. mode: HugePageMode ordinal. Recreates the
+// context (KV cleared) when a model is loaded; weights follow on the next load.
+static jboolean nativeSetHugePages(JNIEnv*, jobject, jint mode) {
+    if (mode < 0 || mode > (jint)HugePageMode::Collapse) return JNI_FALSE;
+    return engine().setHugePages((HugePageMode)mode) ? JNI_TRUE : JNI_FALSE;
+}
 
-    // Size batch to max(n, N_BATCH) — handles large prompts safely.
-    int batch_sz = (n > N_BATCH) ? n : N_BATCH;
-    llama_batch batch = llama_batch_init(batch_sz, 0, 1);
-    batch.n_tokens = 0;
-
-    for (int i = 0; i < n; i++) {
-        batch.token[i]     = tokens[i];
-        batch.pos[i]       = i;
-        batch.n_seq_id[i]  = 1;
-        batch.seq_id[i][0] = 0;
-        batch.logits[i]    = (i == n - 1) ? 1 : 0;
-    }
-    batch.n_tokens = n;
+// One line for the diagnostics screen; reads /proc/self/smaps.
+static jstring nativeHugePageInfo(JNIEnv* env, jobject) {
+    const HugePageStats s = engine().hugePageStats();
+    char buf[192];
+    snprintf(buf, sizeof(buf), "THP %s | advised %.0f MB | huge %.0f MB%s",
+             s.thp.empty() ? "unavailable" : s.thp.c_str(), s.advisedBytes / 1048576.0,
+             s.hugeBytes / 1048576.0, s.collapseErrors ? " | collapse failed" : "");
+    return env->NewStringUTF(buf);
+}
+
+// Blocks for the load and warm-up; call off the main thread.
+static jboolean nativeAddModel(JNIEnv* env, jobject, jstring name, jstring modelPath) {
+    return engine().addModel(fromJavaString(env, name), fromJavaString(env, modelPath))
+               ? JNI_TRUE : JNI_FALSE;
+}
+
+static jboolean nativeRemoveModel(JNIEnv* env, jobject, jstring name) {
+    return engine().removeModel(fromJavaString(env, name)) ? JNI_TRUE : JNI_FALSE;
+}
+
+static jobjectArray nativeModelNames(JNIEnv* env, jobject) {
+    return toJavaBytesArray(env, engine().modelNames());
+}
 
-    if (llama_decode(g_ctx, batch) != 0) {
-        LOGE("Prompt decode failed");
-        llama_batch_free(batch);
-        llama_sampler_free(sampler);
-        return env->NewStringUTF("");
+// Memory breakdown as long[] — index order matches MemoryStats.fromArray() in
+// LlamaJNI.kt. Reads /proc/self/smaps; meant for diagnostics, not polling.
+static jlongArray nativeMemoryStats(JNIEnv* env, jobject) {
+    const MemoryStats m = engine().memoryStats();
+    const jlong values[] = {
+        m.weightsBytes, m.weightsMappedBytes, m.weightsAnonBytes, m.weightsResidentBytes,
+        m.kvBytes, m.kvKBytes, m.kvVBytes, (jlong)engine().config().kvType, m.computeBytes,
+        m.mallocArenaBytes, m.mallocMmappedBytes, m.mallocInUseBytes, m.mallocFreeBytes,
+        m.rssBytes, m.pssBytes, m.pssAnonBytes, m.pssFileBytes, m.swapBytes,
+        m.peakRssBytes, m.peakSinceLoad ? 1 : 0,
+    };
+    const jsize n = (jsize)(sizeof(values) / sizeof(values[0]));
+    jlongArray arr = env->NewLongArray(n);
+    if (!arr) {
+        if (env->ExceptionCheck()) env->ExceptionClear();
+        return nullptr;
     }
+    env->SetLongArrayRegion(arr, 0, n, values);
+    return arr;
+}
 
-    std::string result;
-    int pos = n;
-    llama_token eos = llama_vocab_eos(vocab);
+// Chrome trace JSON of the recorded spans; clear = drop them afterwards.
+// Empty trace when the library was built without AIGENTIK_TRACE.
+static jstring nativeTraceDump(JNIEnv* env, jobject, jboolean clear) {
+    std::string json = traceDumpJson();
+    if (clear) traceClear();
+    return toJavaString(env, json);
+}
 
-    for (int i = 0; i < (int)maxTokens; i++) {
-        llama_token tok = llama_sampler_sample(sampler, g_ctx, -1);
-        if (tok == eos || tok < 0) { LOGI("EOS at pos %d", pos); break; }
+static jboolean nativeTraceEnabled(JNIEnv*, jobject) {
+    return kTraceEnabled ? JNI_TRUE : JNI_FALSE;
+}
 
-        char piece[256] = {};
-        int len = llama_token_to_piece(vocab, tok, piece, sizeof(piece) - 1, 0, false);
-        if (len > 0) {
-            std::string p(piece, len);
-            if (p.find("<|im_end|>") != std::string::npos) break;
-            result += p;
-        }
+// Turns op profiling on or off (recreates the context). False if that failed.
+static jboolean nativeSetOpProfiling(JNIEnv*, jobject, jboolean enable) {
+    return engine().setOpProfiling(enable) ? JNI_TRUE : JNI_FALSE;
+}
 
-        // Reuse slot 0 for single-token decode
-        batch.n_tokens     = 1;
-        batch.token[0]     = tok;
-        batch.pos[0]       = pos;
-        batch.n_seq_id[0]  = 1;
-        batch.seq_id[0][0] = 0;
-        batch.logits[0]    = 1;
-
-        if (llama_decode(g_ctx, batch) != 0) {
-            LOGE("Decode failed at pos %d", pos);
-            break;
-        }
-        pos++;
+// Sorted op profile accumulated since profiling was enabled or last reset.
+static jstring nativeOpProfileReport(JNIEnv* env, jobject, jboolean reset) {
+    return toJavaString(env, engine().opProfileReport(reset));
+}
 
-        if (pos >= CTX_SIZE - 32) {
-            LOGI("Context limit approaching at pos %d — stopping", pos);
-            break;
-        }
-    }
+static jboolean nativeIsLoaded(JNIEnv*, jobject) {
+    return engine().isLoaded() ? JNI_TRUE : JNI_FALSE;
+}
 
-    llama_batch_free(batch);
-    llama_sampler_free(sampler);
-    LOGI("Generated %zu chars in %d tokens", result.size(), pos - n);
+static void nativeUnload(JNIEnv*, jobject) {
+    engine().unload();
+}
 
-    // Use toJavaString() instead of NewStringUTF() — see helper comment above.
-    return toJavaString(env, result);
+static jstring nativeGetModelInfo(JNIEnv* env, jobject) {
+    return toJavaString(env, engine().modelInfo());
 }
 
-extern "C"
-JNIEXPORT jboolean JNICALL
-Java_com_aigentik_app_ai_LlamaJNI_nativeIsLoaded(JNIEnv*, jobject) {
-    return (g_model && g_ctx) ? JNI_TRUE : JNI_FALSE;
+// Session cache setup. dir: spill directory for evicted sessions (app storage).
+// ramBudget 0 disables session reuse entirely.
+static void nativeConfigureSessions(JNIEnv* env, jobject, jstring dirStr, jlong ramBudget,
+                                    jlong diskBudget) {
+    engine().configureSessions(fromJavaString(env, dirStr), ramBudget > 0 ? (size_t)ramBudget : 0,
+                               diskBudget > 0 ? (size_t)diskBudget : 0);
 }
 
-extern "C"
-JNIEXPORT void JNICALL
-Java_com_aigentik_app_ai_LlamaJNI_nativeUnload(JNIEnv*, jobject) {
-    std::lock_guard<std::mutex> lock(g_mutex);
-    if (g_ctx)   { llama_free(g_ctx);         g_ctx   = nullptr; }
-    if (g_model) { llama_model_free(g_model); g_model = nullptr; }
-    LOGI("Model unloaded");
+// Never waits on inference — the session cache has its own lock.
+static jstring nativeGetSessionStats(JNIEnv* env, jobject) {
+    return toJavaString(env, engine().sessionStats());
 }
 
-extern "C"
-JNIEXPORT jstring JNICALL
-Java_com_aigentik_app_ai_LlamaJNI_nativeGetModelInfo(JNIEnv* env, jobject) {
-    if (!g_model || !g_ctx) return env->NewStringUTF("No model loaded");
-    const llama_vocab* vocab = llama_model_get_vocab(g_model);
-    char info[256];
-    snprintf(info, sizeof(info),
-             "Vocab: %d | Ctx: %d | Threads: %d | KV: Q8_0 | Batch: %d",
-             llama_vocab_n_tokens(vocab), llama_n_ctx(g_ctx), N_THREADS, N_BATCH);
-    return env->NewStringUTF(info);
+// Signatures must match the external declarations in LlamaJNI.kt.
+static const JNINativeMethod kNatives[] = {
+    {"nativeLoadModel",        "(Ljava/lang/String;)Z",                (void*)nativeLoadModel},
+    {"nativeLoadModelAsync",   "(Ljava/lang/String;Lcom/aigentik/app/ai/LlamaJNI$LoadListener;)Z",
+                                                                       (void*)nativeLoadModelAsync},
+    {"nativeSwapModelAsync",   "(Ljava/lang/String;Lcom/aigentik/app/ai/LlamaJNI$LoadListener;)I",
+                                                                       (void*)nativeSwapModelAsync},
+    {"nativeCancelLoad",       "()V",                                  (void*)nativeCancelLoad},
+    {"nativeGenerate",         "([BIFF[BLjava/lang/String;)[B",        (void*)nativeGenerate},
+    {"nativeGenerateChat",     "([[B[[B[BIIIFF[BLjava/lang/String;)[B",
+                                                                       (void*)nativeGenerateChat},
+    {"nativeGenerateCascade",  "([[B[[B[BIIFF[BLjava/lang/String;FFI)[B",
+                                                                       (void*)nativeGenerateCascade},
+    {"nativeGenerateBulk",     "([B[[BIIFF)[[B",                       (void*)nativeGenerateBulk},
+    {"nativeTokenize",         "([BZLjava/nio/ByteBuffer;)I",          (void*)nativeTokenize},
+    {"nativeCountTokens",      "([B)I",                                (void*)nativeCountTokens},
+    {"nativeTokenizeChat",     "([[B[[B[BIILjava/nio/ByteBuffer;)I",   (void*)nativeTokenizeChat},
+    {"nativeGenerateTokens",   "([IIFF[B)[B",                          (void*)nativeGenerateTokens},
+    {"nativeGetContextSize",   "()I",                                  (void*)nativeGetContextSize},
+    {"nativeIsLoaded",         "()Z",                                  (void*)nativeIsLoaded},
+    {"nativeUnload",           "()V",                                  (void*)nativeUnload},
+    {"nativeGetModelInfo",     "()Ljava/lang/String;",                 (void*)nativeGetModelInfo},
+    {"nativeConfigureSessions","(Ljava/lang/String;JJ)V",              (void*)nativeConfigureSessions},
+    {"nativeGetSessionStats",  "()Ljava/lang/String;",                 (void*)nativeGetSessionStats},
+    {"nativeLastStats",        "()[D",                                 (void*)nativeLastStats},
+    {"nativeMetricsBuffer",    "()Ljava/nio/ByteBuffer;",              (void*)nativeMetricsBuffer},
+    {"nativeTraceEnabled",     "()Z",                                  (void*)nativeTraceEnabled},
+    {"nativeTraceDump",        "(Z)Ljava/lang/String;",                (void*)nativeTraceDump},
+    {"nativeSetOpProfiling",   "(Z)Z",                                 (void*)nativeSetOpProfiling},
+    {"nativeMemoryStats",      "()[J",                                 (void*)nativeMemoryStats},
+    {"nativeOpProfileReport",  "(Z)Ljava/lang/String;",                (void*)nativeOpProfileReport},
+    {"nativeSetWeightsPolicy", "(ZZIZ)V",                              (void*)nativeSetWeightsPolicy},
+    {"nativePrefetchWeights",  "()V",                                  (void*)nativePrefetchWeights},
+    {"nativeWeightsResidency", "()[J",                                 (void*)nativeWeightsResidency},
+    {"nativeWarmup",           "()[D",                                 (void*)nativeWarmup},
+    {"nativeSetHugePages",     "(I)Z",                                 (void*)nativeSetHugePages},
+    {"nativeHugePageInfo",     "()Ljava/lang/String;",                 (void*)nativeHugePageInfo},
+    {"nativeAddModel",         "(Ljava/lang/String;Ljava/lang/String;)Z", (void*)nativeAddModel},
+    {"nativeRemoveModel",      "(Ljava/lang/String;)Z",                (void*)nativeRemoveModel},
+    {"nativeModelNames",       "()[[B",                                (void*)nativeModelNames},
+};
+
+// Runs inside System.loadLibrary(). Returning JNI_ERR makes loadLibrary throw
+// UnsatisfiedLinkError, which LlamaJNI reports as "native library not loaded".
+extern "C" JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void*) {
+    JNIEnv* env = nullptr;
+    if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) return JNI_ERR;
+    if (!jniMarshalInit(env)) return JNI_ERR;
+    g_vm = vm;
+
+    jclass listener = env->FindClass("com/aigentik/app/ai/LlamaJNI$LoadListener");
+    if (!listener) {
+        LOGE("JNI_OnLoad: LlamaJNI.LoadListener not found");
+        return JNI_ERR;
+    }
+    g_onLoadProgress = env->GetMethodID(listener, "onProgress", "(F)V");
+    g_onLoadComplete = env->GetMethodID(listener, "onComplete", "(Z)V");
+    env->DeleteLocalRef(listener);
+    if (!g_onLoadProgress || !g_onLoadComplete) return JNI_ERR;
+
+    jclass cls = env->FindClass("com/aigentik/app/ai/LlamaJNI");
+    if (!cls) {
+        LOGE("JNI_OnLoad: LlamaJNI class not found");
+        return JNI_ERR;
+    }
+    const jint rc = env->RegisterNatives(cls, kNatives, (jint)(sizeof(kNatives) / sizeof(kNatives[0])));
+    env->DeleteLocalRef(cls);
+    if (rc != JNI_OK) {
+        LOGE("JNI_OnLoad: RegisterNatives failed (%d)", rc);
+        return JNI_ERR;
+    }
+    return JNI_VERSION_1_6;
 }
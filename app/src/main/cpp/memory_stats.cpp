@@ -0,0 +1,223 @@
+// memory_stats.cpp — see memory_stats.h.
+
+#define LOG_TAG "llama"
+#include "memory_stats.h"
+#include "aigentik_log.h"
+
+#include <cstdio>
+#include <cstring>
+#include <malloc.h>
+#include <mutex>
+
+namespace {
+
+constexpr double MIB = 1024.0 * 1024.0;
+
+std::mutex   g_parsedMutex;
+MemoryRecord g_parsed;
+thread_local MemoryRecord* t_record = nullptr;    // null: g_parsed
+thread_local bool t_capturing = false;
+thread_local std::vector<int64_t> t_captured;
+
+// "<name> <what> buffer size = <x> MiB" → bytes, and the buffer name.
+bool bufferSize(const char* text, const char* what, std::string& name, int64_t& bytes) {
+    const std::string needle = std::string(" ") + what + " buffer size =";
+    const char* at = std::strstr(text, needle.c_str());
+    if (!at) return false;
+    double mib = 0;
+    if (std::sscanf(at + needle.size(), "%lf MiB", &mib) != 1) return false;
+    const char* begin = at;
+    while (begin > text && begin[-1] == ' ') begin--;
+    const char* end = begin;
+    while (begin > text && begin[-1] != ' ' && begin[-1] != ':') begin--;
+    name.assign(begin, end);
+    bytes = (int64_t)(mib * MIB);
+    return true;
+}
+
+// "... K (q8_0):  576.00 MiB, V (q8_0):  576.00 MiB"
+bool kvSplit(const char* text, int64_t& k, int64_t& v) {
+    const char* ks = std::strstr(text, "K (");
+    const char* vs = ks ? std::strstr(ks, "V (") : nullptr;
+    if (!vs) return false;
+    char type[16];
+    double kMib = 0, vMib = 0;
+    if (std::sscanf(ks, "K (%15[^)]): %lf MiB", type, &kMib) != 2) return false;
+    if (std::sscanf(vs, "V (%15[^)]): %lf MiB", type, &vMib) != 2) return false;
+    k = (int64_t)(kMib * MIB);
+    v = (int64_t)(vMib * MIB);
+    return true;
+}
+
+// Any "... buffer size = <x> MiB" line except the mapped weight file's.
+void captureLine(const char* text) {
+    const char* at = std::strstr(text, " buffer size =");
+    double mib = 0;
+    if (!at || std::strstr(text, "Mapped")) return;
+    if (std::sscanf(at + std::strlen(" buffer size ="), "%lf MiB", &mib) != 1 || mib <= 0) return;
+    t_captured.push_back((int64_t)(mib * MIB));
+}
+
+void parseLine(const char* text) {
+    std::string name;
+    int64_t bytes = 0, k = 0, v = 0;
+    std::lock_guard<std::mutex> lock(g_parsedMutex);
+    MemoryRecord& r = t_record ? *t_record : g_parsed;
+    if (bufferSize(text, "model", name, bytes)) {
+        (name.find("Mapped") != std::string::npos ? r.weightsMapped : r.weightsAnon) += bytes;
+    } else if (bufferSize(text, "KV", name, bytes)) {
+        r.kv += bytes;
+    } else if (bufferSize(text, "compute", name, bytes)) {
+        r.compute += bytes;
+    } else if (kvSplit(text, k, v)) {
+        r.kvK = k;
+        r.kvV = v;
+    }
+}
+
+void logHook(ggml_log_level level, const char* text, void*) {
+    if (!text) return;
+    if (std::strstr(text, "buffer size") || std::strstr(text, "K (")) parseLine(text);
+    if (t_capturing && std::strstr(text, "buffer size")) captureLine(text);
+    switch (level) {
+        case GGML_LOG_LEVEL_ERROR: LOGE("%s", text); break;
+        case GGML_LOG_LEVEL_WARN:  LOGW("%s", text); break;
+        case GGML_LOG_LEVEL_INFO:  LOGI("%s", text); break;
+        default: break;    // debug chatter and progress dots stay off logcat
+    }
+}
+
+// "<Key>:   <n> kB" lines of a /proc file → bytes.
+int64_t procField(const char* path, const char* key) {
+    FILE* f = std::fopen(path, "r");
+    if (!f) return 0;
+    const size_t keyLen = std::strlen(key);
+    char line[256];
+    int64_t kb = 0;
+    while (std::fgets(line, sizeof(line), f)) {
+        if (std::strncmp(line, key, keyLen) == 0 && line[keyLen] == ':') {
+            long long v = 0;
+            if (std::sscanf(line + keyLen + 1, "%lld", &v) == 1) kb = v;
+            break;
+        }
+    }
+    std::fclose(f);
+    return kb * 1024;
+}
+
+// Resident bytes of every mapping of path, from /proc/self/smaps.
+int64_t fileResident(const std::string& path) {
+    if (path.empty()) return 0;
+    FILE* f = std::fopen("/proc/self/smaps", "r");
+    if (!f) return 0;
+    char line[512];
+    bool inFile = false;
+    int64_t kb = 0;
+    while (std::fgets(line, sizeof(line), f)) {
+        // Mapping headers start with "<start>-<end> "; field lines with "<Name>:".
+        const char* colon = std::strchr(line, ':');
+        const char* space = std::strchr(line, ' ');
+        if (space && (!colon || space < colon)) {
+            size_t len = std::strlen(line);
+            if (len && line[len - 1] == '\n') line[--len] = '\0';
+            inFile = len > path.size() && line[len - path.size() - 1] == ' ' &&
+                     path.compare(line + len - path.size()) == 0;
+        } else if (inFile && std::strncmp(line, "Rss:", 4) == 0) {
+            long long v = 0;
+            if (std::sscanf(line + 4, "%lld", &v) == 1) kb += v;
+        }
+    }
+    std::fclose(f);
+    return kb * 1024;
+}
+
+} // namespace
+
+void memoryStatsInstallLogHook() {
+    static std::once_flag once;
+    std::call_once(once, [] { llama_log_set(logHook, nullptr); });
+}
+
+void memoryStatsOnModelLoad(const std::string& modelPath) {
+    MemoryRecord rec;
+    rec.modelPath = modelPath;
+    memoryStatsCommit(rec);
+}
+
+void memoryStatsCommit(const MemoryRecord& rec) {
+    // "5" resets the peak RSS (VmHWM) to the current RSS — Linux 4.0+.
+    bool reset = false;
+    if (FILE* f = std::fopen("/proc/self/clear_refs", "w")) {
+        reset = std::fputs("5", f) >= 0;
+        reset = (std::fclose(f) == 0) && reset;
+    }
+    std::lock_guard<std::mutex> lock(g_parsedMutex);
+    g_parsed = rec;
+    g_parsed.peakReset = reset;
+}
+
+void memoryStatsRecordInto(MemoryRecord* rec) {
+    t_record = rec;
+}
+
+void memoryStatsBeginCapture() {
+    t_captured.clear();
+    t_capturing = true;
+}
+
+std::vector<int64_t> memoryStatsEndCapture() {
+    t_capturing = false;
+    std::vector<int64_t> sizes;
+    sizes.swap(t_captured);
+    return sizes;
+}
+
+void memoryStatsOnContextCreate(MemoryRecord* rec) {
+    std::lock_guard<std::mutex> lock(g_parsedMutex);
+    MemoryRecord& r = rec ? *rec : g_parsed;
+    r.kv = r.kvK = r.kvV = 0;
+    r.compute = 0;
+}
+
+MemoryStats memoryStatsCollect(const llama_model* model) {
+    MemoryStats s;
+    MemoryRecord p;
+    {
+        std::lock_guard<std::mutex> lock(g_parsedMutex);
+        p = g_parsed;
+    }
+    if (model) {
+        s.weightsBytes         = (int64_t)llama_model_size(model);
+        s.weightsMappedBytes   = p.weightsMapped;
+        s.weightsAnonBytes     = p.weightsAnon;
+        s.weightsResidentBytes = fileResident(p.modelPath);
+        s.kvBytes              = p.kv ? p.kv : p.kvK + p.kvV;
+        s.kvKBytes             = p.kvK;
+        s.kvVBytes             = p.kvV;
+        s.computeBytes         = p.compute;
+    }
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    const struct mallinfo2 mi = mallinfo2();
+#else
+    const struct mallinfo mi = mallinfo();    // bionic: fields are size_t already
+#endif
+    s.mallocArenaBytes   = (int64_t)mi.arena;
+    s.mallocMmappedBytes = (int64_t)mi.hblkhd;
+    s.mallocInUseBytes   = (int64_t)mi.uordblks;
+    s.mallocFreeBytes    = (int64_t)mi.fordblks;
+
+    s.rssBytes      = procField("/proc/self/smaps_rollup", "Rss");
+    s.pssBytes      = procField("/proc/self/smaps_rollup", "Pss");
+    s.pssAnonBytes  = procField("/proc/self/smaps_rollup", "Pss_Anon");
+    s.pssFileBytes  = procField("/proc/self/smaps_rollup", "Pss_File");
+    s.swapBytes     = procField("/proc/self/smaps_rollup", "Swap");
+    s.peakRssBytes  = procField("/proc/self/status", "VmHWM");
+    s.peakSinceLoad = p.peakReset;
+    if (s.rssBytes == 0) s.rssBytes = procField("/proc/self/status", "VmRSS");   // no smaps_rollup (< 4.14)
+    return s;
+}
+
+int64_t memoryAvailableBytes() {
+    return procField("/proc/meminfo", "MemAvailable");
+}
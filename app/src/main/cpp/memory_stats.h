@@ -0,0 +1,98 @@
+// memory_stats.h — native memory accounting for nativeMemoryStats().
+//
+// Where the engine's memory goes, in bytes:
+//   weights   — total, the part mmap'd from the GGUF file vs. copied into anonymous
+//               memory (e.g. CPU_REPACK buffers), and how much of the file is resident
+//   KV cache  — K and V buffer sizes
+//   compute   — scheduler compute buffers
+//   malloc    — arena / mmapped / in-use / free (mallinfo2, or mallinfo on bionic)
+//   process   — RSS, PSS (anon / file), swap, and peak RSS (VmHWM)
+//
+// llama.cpp does not expose its buffer sizes, so they are read off its load-time
+// log lines ("... model buffer size = N MiB", "K (q8_0): N MiB", "... compute
+// buffer size = N MiB"). memoryStatsInstallLogHook() routes llama.cpp's log through
+// here and on to logcat. If a llama.cpp update changes those lines the affected
+// fields read 0, except total weights, which always come from llama_model_size().
+//
+// memoryStatsOnModelLoad() resets the kernel's peak-RSS counter (clear_refs), so
+// peakRssBytes is the high-water mark since the last load when that succeeded
+// (peakSinceLoad), or since process start otherwise.
+//
+// The fields describe one model, the engine's primary. A model loaded beside it (a
+// hot swap) records into its own MemoryRecord, installed by memoryStatsCommit()
+// only once that model takes over.
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "llama.h"
+
+struct MemoryStats {
+    int64_t weightsBytes        = 0;   // llama_model_size()
+    int64_t weightsMappedBytes  = 0;   // buffers backed by the mmap'd file
+    int64_t weightsAnonBytes    = 0;   // buffers copied to anonymous memory
+    int64_t weightsResidentBytes = 0;  // model file pages currently in RAM
+    int64_t kvBytes             = 0;
+    int64_t kvKBytes            = 0;
+    int64_t kvVBytes            = 0;
+    int64_t computeBytes        = 0;
+    int64_t mallocArenaBytes    = 0;   // heap obtained via brk/sbrk
+    int64_t mallocMmappedBytes  = 0;   // large allocations served by mmap
+    int64_t mallocInUseBytes    = 0;
+    int64_t mallocFreeBytes     = 0;   // free in the arena — fragmentation
+    int64_t rssBytes            = 0;
+    int64_t pssBytes            = 0;
+    int64_t pssAnonBytes        = 0;
+    int64_t pssFileBytes        = 0;
+    int64_t swapBytes           = 0;
+    int64_t peakRssBytes        = 0;
+    bool    peakSinceLoad       = false;
+};
+
+// Buffer sizes parsed off llama.cpp's log for one model and its context.
+struct MemoryRecord {
+    std::string modelPath;
+    int64_t     weightsMapped = 0;
+    int64_t     weightsAnon   = 0;
+    int64_t     kv            = 0;
+    int64_t     kvK           = 0;
+    int64_t     kvV           = 0;
+    int64_t     compute       = 0;
+    bool        peakReset     = false;
+};
+
+// Routes llama.cpp / ggml logging through the buffer-size parser to logcat.
+// Idempotent.
+void memoryStatsInstallLogHook();
+
+// Call before loading a model: forgets the previous model's buffers, remembers the
+// file for residency accounting and resets the peak-RSS counter.
+void memoryStatsOnModelLoad(const std::string& modelPath);
+
+// Call before creating a context: forgets the previous context's buffers — of rec,
+// or of the described model when null.
+void memoryStatsOnContextCreate(MemoryRecord* rec = nullptr);
+
+// Where buffer-size lines logged on the calling thread are recorded: into rec while
+// a model other than the one described here loads, so its buffers are not added to
+// the primary's; null (the default) for the described model.
+void memoryStatsRecordInto(MemoryRecord* rec);
+
+// Makes rec, recorded beside the described model, the described one and resets the
+// peak-RSS counter — when its model replaces the primary.
+void memoryStatsCommit(const MemoryRecord& rec);
+
+// Sizes of the anonymous (not file-mapped) buffers llama.cpp reports allocating on
+// the calling thread between memoryStatsBeginCapture() and memoryStatsEndCapture(),
+// in log order and regardless of memoryStatsRecordInto(). huge_pages.h uses them
+// to tell the engine's buffers from other mappings that appear meanwhile.
+void memoryStatsBeginCapture();
+std::vector<int64_t> memoryStatsEndCapture();
+
+// Snapshot; model may be null (only process-level fields are filled).
+// Reads /proc/self/smaps for file residency — a few ms, not for hot paths.
+MemoryStats memoryStatsCollect(const llama_model* model);
+
+// System-wide MemAvailable from /proc/meminfo; 0 if unreadable.
+int64_t memoryAvailableBytes();
@@ -0,0 +1,59 @@
+// metrics.cpp — see metrics.h.
+
+#include "metrics.h"
+
+#include <cstdio>
+#include <unistd.h>
+
+namespace {
+
+MetricsPage g_page;
+
+// Weight of the newest sample in the tok/s EWMA.
+constexpr double RATE_ALPHA = 0.3;
+
+void bump() { g_page.updates.fetch_add(1, std::memory_order_relaxed); }
+
+} // namespace
+
+MetricsPage& metrics() { return g_page; }
+
+void metricsSetState(EngineState s) {
+    g_page.state.store((int64_t)s, std::memory_order_relaxed);
+    bump();
+}
+
+void metricsSetKvCells(int64_t used) {
+    g_page.kvCellsUsed.store(used, std::memory_order_relaxed);
+    bump();
+}
+
+void metricsAddTokens(int64_t generated, int64_t prompt) {
+    g_page.totalTokens.fetch_add(generated, std::memory_order_relaxed);
+    g_page.totalPromptTokens.fetch_add(prompt, std::memory_order_relaxed);
+    bump();
+}
+
+void metricsSetLoadProgress(float progress) {
+    g_page.loadProgressMilli.store((int64_t)(progress * 1000.0f), std::memory_order_relaxed);
+    bump();
+}
+
+void metricsRecordRate(double tokPerSec) {
+    // Single writer (the generation thread) — load/store is enough.
+    const double prev = g_page.tokPerSecMilli.load(std::memory_order_relaxed) / 1000.0;
+    const double next = prev <= 0 ? tokPerSec : RATE_ALPHA * tokPerSec + (1 - RATE_ALPHA) * prev;
+    g_page.tokPerSecMilli.store((int64_t)(next * 1000.0), std::memory_order_relaxed);
+    bump();
+}
+
+void metricsUpdateRss() {
+    FILE* f = std::fopen("/proc/self/statm", "r");
+    if (!f) return;
+    long pages = 0, resident = 0;
+    if (std::fscanf(f, "%ld %ld", &pages, &resident) == 2) {
+        g_page.rssBytes.store((int64_t)resident * sysconf(_SC_PAGESIZE), std::memory_order_relaxed);
+        bump();
+    }
+    std::fclose(f);
+}
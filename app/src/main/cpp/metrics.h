@@ -0,0 +1,63 @@
+// metrics.h — engine metrics page shared with Kotlin through a direct ByteBuffer.
+//
+// A fixed-layout block of 64-bit atomics. nativeMetricsBuffer() wraps it in a
+// DirectByteBuffer once; Kotlin (EngineMetrics) then reads fields by offset with
+// plain 8-byte loads — no JNI call and no lock per read, so the dashboard can poll
+// as often as it likes without touching the generation mutex.
+//
+// Writers use relaxed atomics: each field is individually consistent, the page as
+// a whole is not a snapshot. `updates` increments after every change so readers
+// can skip redraws when nothing moved.
+//
+// Layout is append-only: new fields go at the end and bump METRICS_LAYOUT_VERSION.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+constexpr int64_t METRICS_LAYOUT_VERSION = 2;
+
+enum class EngineState : int64_t {
+    NotLoaded  = 0,
+    Loading    = 1,
+    Ready      = 2,
+    Generating = 3,
+    Error      = 4,
+};
+
+struct alignas(64) MetricsPage {
+    std::atomic<int64_t> layoutVersion{METRICS_LAYOUT_VERSION};   // offset 0
+    std::atomic<int64_t> state{(int64_t)EngineState::NotLoaded};   // 8
+    std::atomic<int64_t> activeRequests{0};       // 16 — generations running
+    std::atomic<int64_t> queueDepth{0};           // 24 — callers waiting for the engine
+    std::atomic<int64_t> tokPerSecMilli{0};       // 32 — decode tok/s EWMA × 1000
+    std::atomic<int64_t> kvCellsUsed{0};          // 40
+    std::atomic<int64_t> kvCellsTotal{0};         // 48 — n_ctx
+    std::atomic<int64_t> rssBytes{0};             // 56
+    std::atomic<int64_t> totalTokens{0};          // 64 — tokens generated since start
+    std::atomic<int64_t> totalPromptTokens{0};    // 72 — tokens prefilled since start
+    std::atomic<int64_t> totalRequests{0};        // 80 — generations completed
+    std::atomic<int64_t> updates{0};              // 88 — bumped on every change
+    // v2
+    std::atomic<int64_t> loadProgressMilli{0};    // 96 — model load progress × 1000
+};
+
+static_assert(std::atomic<int64_t>::is_always_lock_free, "metrics page needs lock-free 64-bit atomics");
+static_assert(offsetof(MetricsPage, updates) == 88, "metrics page layout changed — update EngineMetrics.kt");
+static_assert(offsetof(MetricsPage, loadProgressMilli) == 96, "metrics page layout changed — update EngineMetrics.kt");
+
+// The process-wide page.
+MetricsPage& metrics();
+
+// Convenience writers — relaxed stores plus an `updates` bump.
+void metricsSetState(EngineState s);
+void metricsSetKvCells(int64_t used);
+void metricsAddTokens(int64_t generated, int64_t prompt);
+void metricsSetLoadProgress(float progress);    // 0..1
+
+// Folds one decode-rate sample (tokens per second) into the EWMA.
+void metricsRecordRate(double tokPerSec);
+
+// Re-reads resident set size from /proc/self/statm (a few µs).
+void metricsUpdateRss();
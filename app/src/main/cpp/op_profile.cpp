@@ -0,0 +1,148 @@
+// op_profile.cpp — see op_profile.h.
+
+#include "op_profile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+// View-style ops do no work; they are computed together with the next real node.
+bool isEmptyOp(ggml_op op) {
+    switch (op) {
+        case GGML_OP_NONE:
+        case GGML_OP_VIEW:
+        case GGML_OP_RESHAPE:
+        case GGML_OP_PERMUTE:
+        case GGML_OP_TRANSPOSE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// llama.cpp names per-layer tensors "<role>-<layer>" (e.g. "kq-12").
+// Splits that suffix off; layer is -1 for tensors outside the layer stack.
+std::string splitName(const char* name, int& layer) {
+    layer = -1;
+    const size_t len = std::strlen(name);
+    size_t dash = len;
+    while (dash > 0 && std::isdigit((unsigned char)name[dash - 1])) dash--;
+    if (dash > 0 && dash < len && name[dash - 1] == '-') {
+        layer = std::atoi(name + dash);
+        return std::string(name, dash - 1);
+    }
+    return std::string(name, len);
+}
+
+// Matrix ops are keyed with the type of the matrix they stream (weights or the
+// quantized K/V view), so a KV dequantization cost shows up as its own row.
+std::string opKey(const ggml_tensor* t) {
+    std::string key = ggml_op_desc(t);
+    const ggml_tensor* m = nullptr;
+    if (t->op == GGML_OP_MUL_MAT || t->op == GGML_OP_MUL_MAT_ID || t->op == GGML_OP_GET_ROWS) {
+        m = t->src[0];
+    } else if (t->op == GGML_OP_FLASH_ATTN_EXT) {
+        m = t->src[1];    // K
+    }
+    if (m) {
+        key += ' ';
+        key += ggml_type_name(m->type);
+    }
+    return key;
+}
+
+template <typename Row>
+void appendRows(std::string& out, const char* title, std::vector<Row> rows,
+                double totalMs, size_t topN) {
+    std::sort(rows.begin(), rows.end(),
+              [](const Row& a, const Row& b) { return a.second.ms > b.second.ms; });
+    char line[160];
+    snprintf(line, sizeof(line), "\n%-22s %8s %10s %9s %6s\n", title, "calls", "total ms", "avg us", "%");
+    out += line;
+    for (size_t i = 0; i < rows.size() && i < topN; i++) {
+        const auto& acc = rows[i].second;
+        snprintf(line, sizeof(line), "%-22.22s %8llu %10.1f %9.1f %5.1f%%\n",
+                 rows[i].first.c_str(), (unsigned long long)acc.calls, acc.ms,
+                 acc.calls ? acc.ms * 1000.0 / acc.calls : 0.0,
+                 totalMs > 0 ? acc.ms * 100.0 / totalMs : 0.0);
+        out += line;
+    }
+    if (rows.size() > topN) {
+        snprintf(line, sizeof(line), "  (%zu more)\n", rows.size() - topN);
+        out += line;
+    }
+}
+
+} // namespace
+
+bool OpProfiler::evalCallback(ggml_tensor* t, bool ask, void* userData) {
+    auto* self = static_cast<OpProfiler*>(userData);
+    if (ask) {
+        if (isEmptyOp(t->op)) return false;
+        self->askedAt_ = std::chrono::steady_clock::now();
+        return true;
+    }
+    const double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - self->askedAt_).count();
+    self->record(t, ms);
+    return true;    // keep computing
+}
+
+void OpProfiler::record(const ggml_tensor* t, double ms) {
+    int layer = -1;
+    const std::string role = splitName(t->name, layer);
+    const std::string op   = opKey(t);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Acc& o = ops_[op];
+    o.ms += ms;
+    o.calls++;
+    Acc& r = roles_[role.empty() ? op : role];
+    r.ms += ms;
+    r.calls++;
+    if (layer >= 0) {
+        if ((size_t)layer >= layers_.size()) layers_.resize(layer + 1);
+        layers_[layer].ms += ms;
+        layers_[layer].calls++;
+    } else {
+        other_.ms += ms;
+        other_.calls++;
+    }
+    totalMs_ += ms;
+    nodes_++;
+}
+
+void OpProfiler::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ops_.clear();
+    roles_.clear();
+    layers_.clear();
+    other_   = {};
+    totalMs_ = 0;
+    nodes_   = 0;
+}
+
+std::string OpProfiler::report(size_t topN) const {
+    using Row = std::pair<std::string, Acc>;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (nodes_ == 0) return "No ops recorded (profiling off, or nothing generated yet)";
+
+    char line[160];
+    snprintf(line, sizeof(line), "Op profile: %llu nodes, %.1f ms\n",
+             (unsigned long long)nodes_, totalMs_);
+    std::string out = line;
+
+    appendRows(out, "op", std::vector<Row>(ops_.begin(), ops_.end()), totalMs_, topN);
+    appendRows(out, "tensor", std::vector<Row>(roles_.begin(), roles_.end()), totalMs_, topN);
+
+    std::vector<Row> layers;
+    for (size_t i = 0; i < layers_.size(); i++) {
+        if (layers_[i].calls) layers.emplace_back("layer " + std::to_string(i), layers_[i]);
+    }
+    if (other_.calls) layers.emplace_back("outside layers", other_);
+    appendRows(out, "layer", std::move(layers), totalMs_, topN);
+    return out;
+}
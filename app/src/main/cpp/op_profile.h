@@ -0,0 +1,53 @@
+// op_profile.h — opt-in per-op / per-layer graph profiling via the eval callback.
+//
+// When the context is created with cb_eval = OpProfiler::evalCallback, the ggml
+// scheduler asks the callback about every graph node before computing it. The
+// profiler answers "yes" for every non-empty node, so the scheduler computes the
+// graph one node at a time and calls back again when each node is done; the time
+// between the two calls is that node's wall time. Times are accumulated
+// per op type (with the weight / KV type for matrix ops — "MUL_MAT q8_0"),
+// per tensor role (the llama.cpp tensor name without its layer suffix — "kq",
+// "ffn_up") and per layer, until reset.
+//
+// Splitting the graph per node adds a threadpool dispatch to every op, so absolute
+// times run higher than in a normal build — compare shares, not milliseconds, and
+// compare profiled runs only with other profiled runs. Off by default; the
+// engine recreates its context to switch it on or off.
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ggml.h"
+
+class OpProfiler {
+public:
+    // ggml_backend_sched_eval_callback; user_data is the OpProfiler.
+    static bool evalCallback(ggml_tensor* t, bool ask, void* userData);
+
+    void reset();
+
+    // Text report: totals, then ops, tensor roles and layers, each sorted by total
+    // time descending and cut to topN rows.
+    std::string report(size_t topN = 24) const;
+
+private:
+    struct Acc {
+        double   ms    = 0;
+        uint64_t calls = 0;
+    };
+
+    void record(const ggml_tensor* t, double ms);
+
+    mutable std::mutex                      mutex_;
+    std::chrono::steady_clock::time_point   askedAt_;   // decode thread only
+    std::unordered_map<std::string, Acc>    ops_;
+    std::unordered_map<std::string, Acc>    roles_;
+    std::vector<Acc>                        layers_;
+    Acc                                     other_;     // nodes outside any layer
+    double                                  totalMs_ = 0;
+    uint64_t                                nodes_   = 0;
+};
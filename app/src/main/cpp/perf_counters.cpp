@@ -0,0 +1,117 @@
+// perf_counters.cpp — see perf_counters.h.
+
+#define LOG_TAG "PerfCounters"
+#include "perf_counters.h"
+#include "aigentik_log.h"
+
+HwCounters operator-(const HwCounters& end, const HwCounters& start) {
+    HwCounters d;
+    auto sub = [](int64_t a, int64_t b) { return a >= 0 && b >= 0 ? a - b : -1; };
+    d.cycles       = sub(end.cycles, start.cycles);
+    d.instructions = sub(end.instructions, start.instructions);
+    d.cacheMisses  = sub(end.cacheMisses, start.cacheMisses);
+    d.branchMisses = sub(end.branchMisses, start.branchMisses);
+    d.dtlbMisses   = sub(end.dtlbMisses, start.dtlbMisses);
+    return d;
+}
+
+HwCounters operator+(const HwCounters& a, const HwCounters& b) {
+    HwCounters s;
+    auto add = [](int64_t x, int64_t y) { return x >= 0 && y >= 0 ? x + y : -1; };
+    s.cycles       = add(a.cycles, b.cycles);
+    s.instructions = add(a.instructions, b.instructions);
+    s.cacheMisses  = add(a.cacheMisses, b.cacheMisses);
+    s.branchMisses = add(a.branchMisses, b.branchMisses);
+    s.dtlbMisses   = add(a.dtlbMisses, b.dtlbMisses);
+    return s;
+}
+
+#if defined(AIGENTIK_PERF_COUNTERS) && defined(__linux__)
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+const uint64_t EVENTS[] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+// dTLB read misses — a generic cache event, mapped by the kernel to the core's own.
+const uint64_t DTLB_READ_MISS = PERF_COUNT_HW_CACHE_DTLB |
+                                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+int openCounter(uint64_t config, uint32_t type = PERF_TYPE_HARDWARE) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = type;
+    attr.config         = config;
+    attr.inherit        = 1;     // include threads spawned from here on
+    attr.exclude_kernel = 1;     // allowed at perf_event_paranoid <= 2
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0 /* this thread */, -1 /* any cpu */, -1, 0);
+}
+
+int64_t readCounter(int fd) {
+    uint64_t v[3];    // value, time enabled, time running
+    if (fd < 0 || ::read(fd, v, sizeof(v)) != (ssize_t)sizeof(v)) return -1;
+    if (v[2] == 0) return 0;
+    if (v[2] < v[1]) return (int64_t)((double)v[0] * v[1] / v[2]);    // multiplexed
+    return (int64_t)v[0];
+}
+
+} // namespace
+
+PerfCounters::PerfCounters() {
+    static std::atomic<bool> warned{false};
+    for (int i = 0; i < N_EVENTS; i++) {
+        fds_[i] = openCounter(EVENTS[i]);
+        if (fds_[i] < 0) {
+            if (!warned.exchange(true)) {
+                LOGW("perf_event_open failed (%s) — hardware counters unavailable", std::strerror(errno));
+            }
+            for (int j = 0; j <= i; j++) {
+                if (fds_[j] >= 0) close(fds_[j]);
+                fds_[j] = -1;
+            }
+            return;
+        }
+    }
+    dtlbFd_ = openCounter(DTLB_READ_MISS, PERF_TYPE_HW_CACHE);
+}
+
+PerfCounters::~PerfCounters() {
+    for (int fd : fds_) {
+        if (fd >= 0) close(fd);
+    }
+    if (dtlbFd_ >= 0) close(dtlbFd_);
+}
+
+HwCounters PerfCounters::read() const {
+    HwCounters c;
+    if (!available()) return c;
+    c.cycles       = readCounter(fds_[0]);
+    c.instructions = readCounter(fds_[1]);
+    c.cacheMisses  = readCounter(fds_[2]);
+    c.branchMisses = readCounter(fds_[3]);
+    c.dtlbMisses   = readCounter(dtlbFd_);
+    return c;
+}
+
+#else
+
+PerfCounters::PerfCounters() = default;
+PerfCounters::~PerfCounters() = default;
+HwCounters PerfCounters::read() const { return {}; }
+
+#endif
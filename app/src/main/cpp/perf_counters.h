@@ -0,0 +1,57 @@
+// perf_counters.h — hardware performance counters per generation phase (Linux).
+//
+//   PerfCounters pc;                  // opens counters on the calling thread
+//   HwCounters a = pc.read();
+//   ... prefill ...
+//   st.prefillCounters = pc.read() - a;
+//
+// Counts user-space cycles, instructions, last-level cache misses, branch misses
+// and data-TLB load misses via perf_event_open(2). The TLB event is optional —
+// cores without it leave dtlbMisses at -1 and keep the other four. Counters are
+// opened with `inherit`: they cover the calling thread and every thread it starts
+// afterwards, not threads that already exist. The engine's threadpool workers
+// therefore have their own set, opened by the thread that creates the pool just
+// before it does and kept for the pool's lifetime; a phase adds both sets
+// (operator+). Counters the kernel multiplexes are scaled by time enabled / time
+// running.
+//
+// Built only with -DAIGENTIK_PERF_COUNTERS=ON on Linux. Otherwise, or when the
+// kernel refuses (perf_event_paranoid, SELinux on most Android builds), every
+// count reads as -1 ("unavailable") and the generation runs unchanged.
+#pragma once
+
+#include <cstdint>
+
+struct HwCounters {
+    int64_t cycles       = -1;   // -1 = unavailable
+    int64_t instructions = -1;
+    int64_t cacheMisses  = -1;
+    int64_t branchMisses = -1;
+    int64_t dtlbMisses   = -1;
+
+    bool valid() const { return cycles >= 0; }
+};
+
+// Per-field difference; unavailable if either side is.
+HwCounters operator-(const HwCounters& end, const HwCounters& start);
+
+// Per-field sum; unavailable if either side is.
+HwCounters operator+(const HwCounters& a, const HwCounters& b);
+
+class PerfCounters {
+public:
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const { return fds_[0] >= 0; }
+
+    // Counts since construction (only differences are meaningful).
+    HwCounters read() const;
+
+private:
+    static constexpr int N_EVENTS = 4;
+    int fds_[N_EVENTS] = {-1, -1, -1, -1};
+    int dtlbFd_        = -1;
+};
@@ -0,0 +1,347 @@
+// session_cache.cpp — see session_cache.h for the design overview.
+
+#define LOG_TAG "SessionCache"
+#include "session_cache.h"
+#include "aigentik_log.h"
+#include "hash_util.h"
+
+#include <chrono>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+
+// On-disk layout: SpillHeader, keySize bytes of the session key, then compSize
+// bytes of zlib data. Files never outlive the process's in-memory index
+// (configure() wipes the directory), so the format only needs to detect
+// truncation/corruption — and a file named after a key whose hash collides with
+// this one, which is why the key itself is stored and compared on load.
+struct SpillHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t rawSize;
+    uint64_t compSize;
+    uint64_t keySize;
+};
+constexpr uint32_t SPILL_MAGIC   = 0x564B4741;  // "AGKV"
+constexpr uint32_t SPILL_VERSION = 2;
+constexpr const char* SPILL_EXT  = ".kvz";
+constexpr uint64_t    MAX_KEY    = 4096;    // sanity bound on SpillHeader.keySize
+
+// Level 1: KV data is mostly high-entropy quantized values — higher levels cost
+// several times more CPU for a few percent of size.
+constexpr int ZLIB_LEVEL = 1;
+
+double msSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - t0).count();
+}
+
+bool hasSuffix(const char* name, const char* suffix) {
+    size_t n = strlen(name), m = strlen(suffix);
+    return n >= m && strcmp(name + n - m, suffix) == 0;
+}
+
+} // namespace
+
+size_t SessionCache::ramSize(const Entry& e) {
+    return e.state.size() + e.tokens.size() * sizeof(llama_token);
+}
+
+std::string SessionCache::pathFor(const std::string& key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64 "%s", fnv1a64(key), SPILL_EXT);
+    return dir_ + "/" + name;
+}
+
+void SessionCache::configure(const std::string& dir, size_t ramBudget, size_t diskBudget) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& e : lru_) dropFile(e);
+    lru_.clear();
+    index_.clear();
+
+    dir_        = dir;
+    ramBudget_  = ramBudget;
+    diskBudget_ = diskBudget;
+    stats_      = Stats{};
+
+    if (!dir_.empty()) {
+        if (mkdir(dir_.c_str(), 0700) != 0 && errno != EEXIST) {
+            LOGW("Cannot create spill dir %s — sessions stay RAM-only", dir_.c_str());
+            dir_.clear();
+        } else if (DIR* d = opendir(dir_.c_str())) {
+            // Files from a previous process belong to an index we no longer have
+            // (and possibly to a different model) — remove them.
+            while (dirent* ent = readdir(d)) {
+                if (hasSuffix(ent->d_name, SPILL_EXT)) {
+                    unlink((dir_ + "/" + ent->d_name).c_str());
+                }
+            }
+            closedir(d);
+        }
+    }
+    LOGI("Configured: ram=%zuMB disk=%zuMB dir=%s",
+         ramBudget_ >> 20, diskBudget_ >> 20, dir_.empty() ? "(none)" : dir_.c_str());
+}
+
+bool SessionCache::restore(llama_context* ctx, const std::string& key, llama_seq_id seq,
+                           std::vector<llama_token>& tokens) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ramBudget_ == 0) return false;
+    stats_.lookups++;
+
+    auto it = index_.find(key);
+    if (it == index_.end()) { stats_.misses++; return false; }
+    Entry& e = *it->second;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    const bool fromDisk = e.onDisk;
+    if (fromDisk && !load(e)) {
+        dropFile(e);
+        lru_.erase(it->second);
+        index_.erase(it);
+        stats_.misses++;
+        return false;
+    }
+
+    if (llama_state_seq_set_data(ctx, e.state.data(), e.state.size(), seq) == 0) {
+        LOGW("State restore failed for %s — discarding session", key.c_str());
+        lru_.erase(it->second);
+        index_.erase(it);
+        stats_.misses++;
+        return false;
+    }
+    tokens = e.tokens;
+
+    const double ms = msSince(t0);
+    if (fromDisk) { stats_.diskHits++; stats_.diskRestoreMs += ms; }
+    else          { stats_.ramHits++;  stats_.ramRestoreMs  += ms; }
+    if (ms > stats_.maxRestoreMs) stats_.maxRestoreMs = ms;
+
+    lru_.splice(lru_.begin(), lru_, it->second);
+    if (fromDisk) enforceBudget(&lru_.front());
+
+    LOGI("Restored %s from %s: %zu tokens, %zu KB in %.1fms",
+         key.c_str(), fromDisk ? "disk" : "RAM", tokens.size(), e.state.size() >> 10, ms);
+    return true;
+}
+
+void SessionCache::save(llama_context* ctx, const std::string& key, llama_seq_id seq,
+                        const std::vector<llama_token>& tokens) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ramBudget_ == 0 || tokens.empty()) return;
+
+    const size_t size = llama_state_seq_get_size(ctx, seq);
+    if (size == 0) return;
+
+    std::vector<uint8_t> state(size);
+    if (llama_state_seq_get_data(ctx, state.data(), size, seq) != size) {
+        LOGW("State capture failed for %s", key.c_str());
+        return;
+    }
+
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        dropFile(*it->second);
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+
+    lru_.push_front(Entry{key, tokens, std::move(state)});
+    index_[key] = lru_.begin();
+    enforceBudget(&lru_.front());
+}
+
+void SessionCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& e : lru_) dropFile(e);
+    lru_.clear();
+    index_.clear();
+}
+
+void SessionCache::removeIf(const std::function<bool(const std::string& key)>& match) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = lru_.begin(); it != lru_.end();) {
+        if (!match(it->key)) { ++it; continue; }
+        dropFile(*it);
+        index_.erase(it->key);
+        it = lru_.erase(it);
+    }
+}
+
+void SessionCache::removePrefix(const std::string& prefix) {
+    removeIf([&prefix](const std::string& key) { return key.compare(0, prefix.size(), prefix) == 0; });
+}
+
+// Spills LRU sessions until RAM usage fits the budget, then deletes the oldest
+// spilled files until disk usage fits. `keep` is spilled last — only when it
+// alone exceeds the RAM budget.
+void SessionCache::enforceBudget(Entry* keep) {
+    size_t ram = 0, disk = 0;
+    for (const auto& e : lru_) { ram += ramSize(e); disk += e.diskBytes; }
+
+    for (auto it = lru_.rbegin(); it != lru_.rend() && ram > ramBudget_; ++it) {
+        if (it->onDisk || &*it == keep) continue;
+        const size_t before = ramSize(*it);
+        if (spill(*it)) {
+            ram  -= before - ramSize(*it);
+            disk += it->diskBytes;
+        } else {
+            it->state.clear();
+            it->state.shrink_to_fit();
+            ram -= before - ramSize(*it);
+            stats_.drops++;
+        }
+    }
+    if (ram > ramBudget_ && keep && !keep->onDisk) {
+        if (spill(*keep)) disk += keep->diskBytes;
+    }
+
+    // Entries with neither RAM state nor a file are dead — unlink them. Then trim disk.
+    for (auto it = lru_.end(); it != lru_.begin();) {
+        --it;
+        const bool dead = !it->onDisk && it->state.empty();
+        const bool overDisk = it->onDisk && disk > diskBudget_;
+        if (!dead && !overDisk) continue;
+        if (overDisk) { disk -= it->diskBytes; stats_.drops++; }
+        dropFile(*it);
+        index_.erase(it->key);
+        it = lru_.erase(it);
+    }
+}
+
+bool SessionCache::spill(Entry& e) {
+    if (dir_.empty() || e.state.empty()) return false;
+
+    uLongf compSize = compressBound(e.state.size());
+    std::vector<uint8_t> comp(compSize);
+    if (compress2(comp.data(), &compSize, e.state.data(), e.state.size(), ZLIB_LEVEL) != Z_OK) {
+        LOGW("Compress failed for %s", e.key.c_str());
+        return false;
+    }
+
+    // A spilled session whose key hashes to the same file is about to be overwritten;
+    // forget its copy so nothing reads or deletes the file on its behalf.
+    const uint64_t hash = fnv1a64(e.key);
+    for (Entry& o : lru_) {
+        if (o.onDisk && &o != &e && o.key != e.key && fnv1a64(o.key) == hash) {
+            o.onDisk    = false;
+            o.diskBytes = 0;
+            stats_.drops++;
+        }
+    }
+
+    const std::string path = pathFor(e.key);
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        LOGW("Cannot open %s for spill", path.c_str());
+        return false;
+    }
+    SpillHeader h{SPILL_MAGIC, SPILL_VERSION, e.state.size(), compSize, e.key.size()};
+    const bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+                    fwrite(e.key.data(), 1, e.key.size(), f) == e.key.size() &&
+                    fwrite(comp.data(), 1, compSize, f) == compSize;
+    if (fclose(f) != 0 || !ok) {
+        unlink(path.c_str());
+        LOGW("Spill write failed for %s", e.key.c_str());
+        return false;
+    }
+
+    LOGI("Spilled %s: %zu KB → %lu KB", e.key.c_str(), e.state.size() >> 10,
+         (unsigned long)(compSize >> 10));
+    e.state.clear();
+    e.state.shrink_to_fit();
+    e.onDisk    = true;
+    e.diskBytes = sizeof(h) + e.key.size() + compSize;
+    stats_.spills++;
+    return true;
+}
+
+bool SessionCache::load(Entry& e) {
+    const std::string path = pathFor(e.key);
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+
+    SpillHeader h{};
+    std::string key;
+    std::vector<uint8_t> comp;
+    bool ok = fread(&h, sizeof(h), 1, f) == 1 &&
+              h.magic == SPILL_MAGIC && h.version == SPILL_VERSION && h.keySize <= MAX_KEY;
+    if (ok) {
+        key.resize(h.keySize);
+        ok = fread(&key[0], 1, key.size(), f) == key.size();
+    }
+    if (ok && key != e.key) {
+        // Belongs to a key whose hash collides with this one — not ours to delete.
+        fclose(f);
+        LOGW("Spill file for %s holds another session", e.key.c_str());
+        e.onDisk    = false;
+        e.diskBytes = 0;
+        return false;
+    }
+    if (ok) {
+        comp.resize(h.compSize);
+        ok = fread(comp.data(), 1, comp.size(), f) == comp.size();
+    }
+    fclose(f);
+    if (!ok) {
+        LOGW("Corrupt spill file for %s", e.key.c_str());
+        return false;
+    }
+
+    std::vector<uint8_t> state(h.rawSize);
+    uLongf rawSize = h.rawSize;
+    if (uncompress(state.data(), &rawSize, comp.data(), comp.size()) != Z_OK ||
+        rawSize != h.rawSize) {
+        LOGW("Decompress failed for %s", e.key.c_str());
+        return false;
+    }
+
+    dropFile(e);
+    e.state = std::move(state);
+    return true;
+}
+
+void SessionCache::dropFile(Entry& e) {
+    if (!e.onDisk) return;
+    unlink(pathFor(e.key).c_str());
+    e.onDisk    = false;
+    e.diskBytes = 0;
+}
+
+SessionCache::Stats SessionCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats s = stats_;
+    for (const auto& e : lru_) {
+        if (e.onDisk) { s.diskEntries++; s.diskBytes += e.diskBytes; }
+        else          { s.ramEntries++;  s.ramBytes  += ramSize(e); }
+    }
+    s.ramBudget  = ramBudget_;
+    s.diskBudget = diskBudget_;
+    return s;
+}
+
+std::string SessionCache::statsString() const {
+    const Stats s = stats();
+    if (s.ramBudget == 0) return "Session cache disabled";
+
+    const uint64_t hits = s.ramHits + s.diskHits;
+    char buf[384];
+    snprintf(buf, sizeof(buf),
+             "Sessions: %zu RAM (%.1f/%zu MB), %zu disk (%.1f/%zu MB) | "
+             "Hit %.0f%% (ram %" PRIu64 ", disk %" PRIu64 ", miss %" PRIu64 ") | "
+             "Restore ram %.1fms disk %.1fms max %.1fms | Spills %" PRIu64 " drops %" PRIu64,
+             s.ramEntries, s.ramBytes / 1048576.0, s.ramBudget >> 20,
+             s.diskEntries, s.diskBytes / 1048576.0, s.diskBudget >> 20,
+             s.lookups ? 100.0 * hits / s.lookups : 0.0, s.ramHits, s.diskHits, s.misses,
+             s.ramHits  ? s.ramRestoreMs  / s.ramHits  : 0.0,
+             s.diskHits ? s.diskRestoreMs / s.diskHits : 0.0,
+             s.maxRestoreMs, s.spills, s.drops);
+    return buf;
+}
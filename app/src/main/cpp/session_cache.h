@@ -0,0 +1,99 @@
+// session_cache.h — per-contact KV session cache with a RAM budget and disk spill.
+//
+// A "session" is the KV state of one sequence (llama_state_seq_get_data) plus the
+// tokens that produced it. Restoring a session lets the next generation for the same
+// contact skip prefill for the shared prompt prefix (system prompt, persona, history).
+//
+// Sessions live in RAM until the total exceeds ramBudget; the least-recently-used
+// ones are then compressed (zlib) into files under the configured directory. A
+// disk hit is decompressed and promoted back to RAM. Disk usage is bounded by
+// diskBudget — the oldest spilled files are deleted beyond that.
+//
+// KV state is only valid for the model that produced it, so the sessions of a model
+// must be dropped (clear(), removeIf()) whenever it changes. All methods are
+// thread-safe (internal mutex), but the llama_context passed in must be owned by
+// the caller's generation lock.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "llama.h"
+
+class SessionCache {
+public:
+    struct Stats {
+        uint64_t lookups      = 0;
+        uint64_t ramHits      = 0;
+        uint64_t diskHits     = 0;
+        uint64_t misses       = 0;
+        uint64_t spills       = 0;   // RAM → disk
+        uint64_t drops        = 0;   // evicted with no disk copy kept
+        double   ramRestoreMs  = 0;  // cumulative
+        double   diskRestoreMs = 0;  // cumulative
+        double   maxRestoreMs  = 0;
+        size_t   ramBytes     = 0;
+        size_t   diskBytes    = 0;
+        size_t   ramEntries   = 0;
+        size_t   diskEntries  = 0;
+        size_t   ramBudget    = 0;
+        size_t   diskBudget   = 0;
+    };
+
+    // dir: spill directory (created if missing, stale files removed). Empty = RAM only.
+    void configure(const std::string& dir, size_t ramBudget, size_t diskBudget);
+
+    // Loads the session for key into seq of ctx. On success the sequence holds the
+    // cached KV cells and tokens receives the token history they correspond to.
+    // The caller is expected to have cleared seq beforehand.
+    bool restore(llama_context* ctx, const std::string& key, llama_seq_id seq,
+                 std::vector<llama_token>& tokens);
+
+    // Captures seq of ctx as the session for key; tokens must match the KV contents.
+    void save(llama_context* ctx, const std::string& key, llama_seq_id seq,
+              const std::vector<llama_token>& tokens);
+
+    // Drops every session in RAM and on disk (model change / unload).
+    void clear();
+
+    // Drops the sessions whose keys match, in RAM and on disk.
+    void removeIf(const std::function<bool(const std::string& key)>& match);
+    void removePrefix(const std::string& prefix);
+
+    // Lock-free: generations ask while configure() may run on another thread.
+    bool enabled() const { return ramBudget_.load(std::memory_order_relaxed) > 0; }
+
+    Stats stats() const;
+    std::string statsString() const;
+
+private:
+    struct Entry {
+        std::string              key;
+        std::vector<llama_token> tokens;
+        std::vector<uint8_t>     state;      // empty while spilled
+        size_t                   diskBytes = 0;
+        bool                     onDisk    = false;
+    };
+    using Lru = std::list<Entry>;
+
+    std::string pathFor(const std::string& key) const;
+    bool spill(Entry& e);
+    bool load(Entry& e);
+    void dropFile(Entry& e);
+    void enforceBudget(Entry* keep);
+    static size_t ramSize(const Entry& e);
+
+    mutable std::mutex mutex_;
+    Lru                lru_;      // front = most recently used
+    std::unordered_map<std::string, Lru::iterator> index_;
+    std::string        dir_;
+    std::atomic<size_t> ramBudget_{0};    // written under mutex_
+    size_t             diskBudget_ = 0;
+    Stats              stats_;
+};
@@ -0,0 +1,131 @@
+// summarize.cpp — see summarize.h.
+
+#define LOG_TAG "Summarize"
+#include "summarize.h"
+#include "aigentik_log.h"
+#include "generation.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+const char* const SUMMARY_INSTRUCTION =
+    "You summarize one part of a long email thread so a reply can be written later. "
+    "Keep names, dates, amounts, requests, decisions and open questions. "
+    "Write a few plain sentences. Reply with the summary only.";
+
+// Text with <think>…</think> blocks removed, and an unclosed one (cut off by the
+// token budget) dropped to the end; surrounding whitespace trimmed.
+std::string stripThink(std::string text) {
+    size_t at;
+    while ((at = text.find("<think>")) != std::string::npos) {
+        const size_t end = text.find("</think>", at);
+        text.erase(at, end == std::string::npos ? std::string::npos : end + 8 - at);
+    }
+    const size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) return {};
+    return text.substr(first, text.find_last_not_of(" \t\r\n") + 1 - first);
+}
+
+// One map round: text → chunk summaries joined in order.
+std::string summarizeOnce(llama_context* ctx, ChatPrompt& chat,
+                          const std::vector<llama_token>& tokens, const SummarizeParams& p) {
+    TRACE_SCOPE("summarize_round");
+    const llama_vocab* vocab = llama_model_get_vocab(llama_get_model(ctx));
+    const size_t chunkTokens = (size_t)std::max(p.chunkTokens, 64);
+    const size_t nChunks = (tokens.size() + chunkTokens - 1) / chunkTokens;
+    const size_t per     = (tokens.size() + nChunks - 1) / nChunks;   // even chunk sizes
+
+    // Prompts differ only in the user turn, so their common prefix (the instruction
+    // and the user header) is decoded once and forked per chunk.
+    std::vector<std::vector<llama_token>> prompts(nChunks);
+    size_t common = SIZE_MAX;
+    for (size_t i = 0; i < nChunks; i++) {
+        const std::string part = detokenize(vocab, tokens, i * per, (i + 1) * per);
+        prompts[i] = chat.build({{"system", SUMMARY_INSTRUCTION},
+                                 {"user", "Part " + std::to_string(i + 1) + " of " +
+                                          std::to_string(nChunks) + ":\n" + part}},
+                                p.assistantPrefill);
+        if (prompts[i].empty()) return {};
+        size_t k = 0;
+        const size_t limit = std::min(common, prompts[i].size() - 1);
+        if (i == 0) k = limit;
+        else while (k < limit && prompts[0][k] == prompts[i][k]) k++;
+        common = k;
+    }
+
+    const std::vector<llama_token> prefix(prompts[0].begin(), prompts[0].begin() + common);
+    std::vector<std::vector<llama_token>> suffixes(nChunks);
+    for (size_t i = 0; i < nChunks; i++) suffixes[i].assign(prompts[i].begin() + common, prompts[i].end());
+
+    SamplingParams greedy;
+    greedy.temperature = 0.0f;
+    const std::vector<std::string> parts =
+        generateShared(ctx, prefix, suffixes, p.summaryTokens, p.ctxMargin, greedy);
+
+    std::string joined;
+    for (size_t i = 0; i < parts.size(); i++) {
+        const std::string part = stripThink(parts[i]);
+        if (part.empty()) continue;
+        if (!joined.empty()) joined += "\n\n";
+        joined += "Part " + std::to_string(i + 1) + ": " + part;
+    }
+    return joined;
+}
+
+} // namespace
+
+int summarizeSpans(llama_context* ctx, ChatPrompt& chat, std::vector<ChatMessage>& msgs,
+                   const SummarizeParams& params) {
+    const llama_vocab* vocab = llama_model_get_vocab(llama_get_model(ctx));
+    const size_t beginLen = std::strlen(SUMMARIZE_BEGIN);
+    const size_t endLen   = std::strlen(SUMMARIZE_END);
+    int summarized = 0;
+
+    for (ChatMessage& m : msgs) {
+        size_t at = 0;
+        while ((at = m.content.find(SUMMARIZE_BEGIN, at)) != std::string::npos) {
+            size_t end = m.content.find(SUMMARIZE_END, at + beginLen);
+            const size_t textEnd = end == std::string::npos ? m.content.size() : end;
+            end = end == std::string::npos ? m.content.size() : end + endLen;
+            std::string text = m.content.substr(at + beginLen, textEnd - at - beginLen);
+
+            std::vector<llama_token> tokens;
+            if (params.threshold > 0) tokens = tokenize(vocab, text, false);
+            if (params.threshold > 0 && (int)tokens.size() > params.threshold) {
+                const auto t0 = std::chrono::steady_clock::now();
+                const size_t original = tokens.size();
+                std::string summary;
+                int level = 0;
+                while (level < params.maxLevels && (int)tokens.size() > params.threshold) {
+                    std::string next = summarizeOnce(ctx, chat, tokens, params);
+                    level++;
+                    if (next.empty()) break;
+                    std::vector<llama_token> nextTokens = tokenize(vocab, next, false);
+                    if (nextTokens.size() >= tokens.size()) break;   // not converging
+                    summary = std::move(next);
+                    tokens  = std::move(nextTokens);
+                }
+                const long ms = (long)std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - t0).count();
+                if (summary.empty()) {
+                    LOGW("Summarization produced nothing for a %zu-token span — keeping text", original);
+                } else {
+                    LOGI("Summarized span: %zu → %zu tokens in %d level(s), %ld ms",
+                         original, tokens.size(), level, ms);
+                    text = summary;
+                    summarized++;
+                }
+            }
+
+            // The result is still subject to fitting, like any truncatable span.
+            const std::string replacement = std::string(TRUNCATE_BEGIN) + text + TRUNCATE_END;
+            m.content.replace(at, end - at, replacement);
+            at += replacement.size();
+        }
+    }
+    return summarized;
+}
@@ -0,0 +1,41 @@
+// summarize.h — hierarchical map-reduce summarization of over-length prompt spans.
+//
+// Kotlin marks content that may be replaced by a summary (a long email thread)
+// with SUMMARIZE_BEGIN/END. A marked span longer than the caller's threshold is
+// split into token chunks; every chunk is summarized under one shared instruction
+// prefix, the chunks running as parallel sequences via generateShared() (as many
+// per wave as n_seq_max and the KV cache allow). Each chunk's reply starts after
+// assistantPrefill — the engine passes an empty think block to models that have
+// think tokens, so a reasoning model spends its budget on the summary — and any
+// think block a model emits anyway is stripped. If the joined summaries are still
+// over the threshold they are summarized again, up to maxLevels rounds. The span is
+// then replaced by the summaries — marked truncatable, so the final prompt can
+// still be fitted by ChatPrompt::buildFitted().
+//
+// Memory is bounded by one wave of chunks; time by chunk count × summaryTokens.
+// Runs on the caller's context under its generation lock and clears the KV cache.
+#pragma once
+
+#include <string>
+#include <vector>
+#include "chat_prompt.h"
+#include "llama.h"
+
+// U+E002 / U+E003 (private use) in UTF-8 — see TRUNCATE_BEGIN in chat_prompt.h.
+constexpr const char* SUMMARIZE_BEGIN = "\xEE\x80\x82";
+constexpr const char* SUMMARIZE_END   = "\xEE\x80\x83";
+
+struct SummarizeParams {
+    int threshold     = 0;      // spans above this many tokens are summarized; 0 = never
+    int chunkTokens   = 1536;   // input tokens per map chunk
+    int summaryTokens = 192;    // output tokens per chunk summary
+    int maxLevels     = 3;      // map-reduce rounds before giving up on shrinking further
+    int ctxMargin     = 32;     // cells kept free below n_ctx (EngineConfig::ctxMargin)
+    std::string assistantPrefill;   // after each chunk's prompt, e.g. EMPTY_THINK_PREFILL
+};
+
+// Resolves every summarizable span in msgs in place: spans at or under the
+// threshold keep their text, longer ones are replaced by their summary. Span
+// delimiters are always removed. Returns the number of spans summarized.
+int summarizeSpans(llama_context* ctx, ChatPrompt& chat, std::vector<ChatMessage>& msgs,
+                   const SummarizeParams& params);
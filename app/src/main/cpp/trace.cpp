@@ -0,0 +1,132 @@
+// trace.cpp — see trace.h.
+
+#include "trace.h"
+
+#ifdef AIGENTIK_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+namespace {
+
+// Spans kept per thread — ~3 per generated token, so a few long replies.
+constexpr uint64_t RING_CAPACITY = 16384;
+
+int64_t nowNs() {
+    static const auto epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - epoch).count();
+}
+
+// One span slot. seq is odd while the owner writes it and 2 * (index + 1) once
+// complete, so a reader can detect a slot overwritten under it and skip it.
+struct Slot {
+    std::atomic<uint64_t>    seq{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<int64_t>     startNs{0};
+    std::atomic<int64_t>     durNs{0};
+};
+
+// Single-producer ring: only the owning thread writes; dumps read concurrently.
+struct Ring {
+    explicit Ring(long tid) : tid(tid), slots(RING_CAPACITY) {}
+    const long            tid;
+    std::atomic<uint64_t> head{0};     // spans ever written
+    std::vector<Slot>     slots;
+};
+
+std::mutex                         g_registryMutex;   // ring registration and dumps only
+std::vector<std::unique_ptr<Ring>> g_rings;
+
+Ring* threadRing() {
+    thread_local Ring* ring = nullptr;
+    if (!ring) {
+        auto owned = std::make_unique<Ring>((long)syscall(SYS_gettid));
+        ring = owned.get();
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        g_rings.push_back(std::move(owned));       // rings outlive their threads
+    }
+    return ring;
+}
+
+void record(const char* name, int64_t startNs, int64_t durNs) {
+    Ring* r = threadRing();
+    const uint64_t i = r->head.load(std::memory_order_relaxed);
+    Slot& s = r->slots[i % RING_CAPACITY];
+    s.seq.store(2 * i + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s.name.store(name, std::memory_order_relaxed);
+    s.startNs.store(startNs, std::memory_order_relaxed);
+    s.durNs.store(durNs, std::memory_order_relaxed);
+    s.seq.store(2 * (i + 1), std::memory_order_release);
+    r->head.store(i + 1, std::memory_order_release);
+}
+
+void appendJsonString(std::string& out, const char* s) {
+    out += '"';
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') out += '\\';
+        if ((unsigned char)*s >= 0x20) out += *s;
+    }
+    out += '"';
+}
+
+} // namespace
+
+TraceScope::TraceScope(const char* name) : name_(name), startNs_(nowNs()) {}
+
+TraceScope::~TraceScope() {
+    record(name_, startNs_, nowNs() - startNs_);
+}
+
+std::string traceDumpJson() {
+    std::string out = "{\"traceEvents\":[";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    for (const auto& r : g_rings) {
+        const uint64_t head = r->head.load(std::memory_order_acquire);
+        const uint64_t from = head > RING_CAPACITY ? head - RING_CAPACITY : 0;
+        for (uint64_t i = from; i < head; i++) {
+            const Slot& s = r->slots[i % RING_CAPACITY];
+            const uint64_t seq = s.seq.load(std::memory_order_acquire);
+            const char*   name = s.name.load(std::memory_order_relaxed);
+            const int64_t start = s.startNs.load(std::memory_order_relaxed);
+            const int64_t dur   = s.durNs.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq != 2 * (i + 1) || s.seq.load(std::memory_order_relaxed) != seq || !name) {
+                continue;    // overwritten while we were reading
+            }
+            if (!first) out += ',';
+            first = false;
+            out += "{\"name\":";
+            appendJsonString(out, name);
+            out += ",\"ph\":\"X\",\"pid\":" + std::to_string((long)getpid()) +
+                   ",\"tid\":" + std::to_string(r->tid) +
+                   ",\"ts\":" + std::to_string(start / 1000) + "." + std::to_string(start / 100 % 10) +
+                   ",\"dur\":" + std::to_string(dur / 1000) + "." + std::to_string(dur / 100 % 10) + "}";
+        }
+    }
+    out += "],\"displayTimeUnit\":\"ms\"}";
+    return out;
+}
+
+void traceClear() {
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    // Owners keep writing; moving `head` under them would race. Clear the names
+    // instead — dumps skip nameless slots.
+    for (const auto& r : g_rings) {
+        for (Slot& s : r->slots) s.name.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+#else
+
+std::string traceDumpJson() { return "{\"traceEvents\":[]}"; }
+void traceClear() {}
+
+#endif
@@ -0,0 +1,54 @@
+// trace.h — scoped trace spans for the native inference pipeline.
+//
+//   TRACE_SCOPE("prefill");   // records [construction, end of scope) on this thread
+//
+// Spans go into a fixed-size ring buffer owned by the recording thread, so the hot
+// path takes no lock: one steady_clock read on entry, one on exit, a handful of
+// relaxed atomic stores. When a ring is full the oldest spans are overwritten.
+// traceDumpJson() renders every thread's ring as Chrome trace JSON ("X" complete
+// events), loadable in chrome://tracing or ui.perfetto.dev.
+//
+// Span names must be string literals (the pointer is stored, not the text).
+//
+// Built only with -DAIGENTIK_TRACE=ON (CMake option; Gradle property
+// aigentik.trace=ON). Otherwise TRACE_SCOPE expands to nothing, trace.cpp compiles
+// to stubs and traceDumpJson() returns an empty trace.
+#pragma once
+
+#include <string>
+
+#ifdef AIGENTIK_TRACE
+
+#include <cstdint>
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name);
+    ~TraceScope();
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name_;
+    int64_t     startNs_;
+};
+
+#define AIGENTIK_TRACE_CAT2(a, b) a##b
+#define AIGENTIK_TRACE_CAT(a, b)  AIGENTIK_TRACE_CAT2(a, b)
+#define TRACE_SCOPE(name) TraceScope AIGENTIK_TRACE_CAT(traceScope_, __LINE__)(name)
+
+constexpr bool kTraceEnabled = true;
+
+#else
+
+#define TRACE_SCOPE(name) do {} while (0)
+
+constexpr bool kTraceEnabled = false;
+
+#endif
+
+// Chrome trace JSON of all recorded spans ({"traceEvents":[]} when compiled out).
+std::string traceDumpJson();
+
+// Drops all recorded spans.
+void traceClear();
@@ -0,0 +1,162 @@
+// weights_residency.cpp — see weights_residency.h.
+
+#define LOG_TAG "Weights"
+#include "weights_residency.h"
+#include "aigentik_log.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t MINCORE_CHUNK = 64u << 20;
+constexpr size_t TOUCH_CHECK   = 16u << 20;    // stop flag checked this often
+
+size_t pageSize() {
+    static const size_t size = (size_t)sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+int adviceFlag(WeightsAdvice a) {
+    switch (a) {
+        case WeightsAdvice::WillNeed:   return MADV_WILLNEED;
+        case WeightsAdvice::Sequential: return MADV_SEQUENTIAL;
+        case WeightsAdvice::Random:     return MADV_RANDOM;
+        default:                        return -1;
+    }
+}
+
+int64_t lockedBytes() {
+    FILE* f = std::fopen("/proc/self/status", "r");
+    if (!f) return 0;
+    char line[256];
+    long long kb = 0;
+    while (std::fgets(line, sizeof(line), f)) {
+        if (std::sscanf(line, "VmLck: %lld", &kb) == 1) break;
+    }
+    std::fclose(f);
+    return kb * 1024;
+}
+
+} // namespace
+
+void WeightsPager::attach(const std::string& path) {
+    detach();
+    char real[PATH_MAX];
+    const std::string target = realpath(path.c_str(), real) ? real : path;
+
+    FILE* f = std::fopen("/proc/self/maps", "r");
+    if (!f) return;
+    std::vector<Range> ranges;
+    char line[PATH_MAX + 128];
+    while (std::fgets(line, sizeof(line), f)) {
+        unsigned long start = 0, end = 0;
+        int nameAt = 0;
+        // "<start>-<end> <perms> <offset> <dev> <inode>   <path>"
+        if (std::sscanf(line, "%lx-%lx %*s %*s %*s %*s %n", &start, &end, &nameAt) < 2 || !nameAt) continue;
+        char* name = line + nameAt;
+        name[std::strcspn(name, "\n")] = '\0';
+        if (target == name) ranges.push_back({reinterpret_cast<uint8_t*>(start), end - start});
+    }
+    std::fclose(f);
+
+    size_t total = 0;
+    for (const Range& r : ranges) total += r.len;
+    LOGI("%zu mapping(s), %.1f MiB mapped from %s", ranges.size(),
+         total / (1024.0 * 1024.0), target.c_str());
+    std::lock_guard<std::mutex> lock(mutex_);
+    ranges_ = std::move(ranges);
+}
+
+void WeightsPager::detach() {
+    stopTouch();
+    std::lock_guard<std::mutex> lock(mutex_);
+    ranges_.clear();
+}
+
+void WeightsPager::advise(WeightsAdvice advice) {
+    const int flag = adviceFlag(advice);
+    if (flag < 0) return;
+    TRACE_SCOPE("weights_advise");
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Range& r : ranges_) {
+        if (madvise(r.addr, r.len, flag) != 0) {
+            LOGW("madvise(%d) failed on %zu bytes: %s", flag, r.len, strerror(errno));
+        }
+    }
+}
+
+void WeightsPager::startTouch() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ranges_.empty() || touching_.load(std::memory_order_relaxed)) return;
+    if (toucher_.joinable()) toucher_.join();    // previous pass has finished
+    stopTouch_.store(false, std::memory_order_relaxed);
+    touching_.store(true, std::memory_order_relaxed);
+    toucher_ = std::thread(&WeightsPager::touch, this, ranges_);
+}
+
+void WeightsPager::stopTouch() {
+    std::thread toucher;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopTouch_.store(true, std::memory_order_relaxed);
+        toucher = std::move(toucher_);
+    }
+    if (toucher.joinable()) toucher.join();
+}
+
+// One read per page, in file order. Runs on its own thread; the ranges stay mapped
+// until detach() has joined it.
+void WeightsPager::touch(std::vector<Range> ranges) {
+    TRACE_SCOPE("weights_touch");
+    const auto t0 = std::chrono::steady_clock::now();
+    const size_t page = pageSize();
+    uint8_t sink = 0;
+    bool stopped = false;
+    for (const Range& r : ranges) {
+        for (size_t off = 0; off < r.len && !stopped; off += page) {
+            sink ^= *static_cast<volatile const uint8_t*>(r.addr + off);
+            if (off % TOUCH_CHECK == 0) stopped = stopTouch_.load(std::memory_order_relaxed);
+        }
+    }
+    (void)sink;
+    const int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+    if (!stopped) {
+        lastTouchUs_.store(us, std::memory_order_relaxed);
+        LOGI("Weights touched in %.1f ms", us / 1000.0);
+    }
+    touching_.store(false, std::memory_order_relaxed);
+}
+
+WeightsResidency WeightsPager::residency() const {
+    WeightsResidency w;
+    w.lockedBytes = lockedBytes();
+    w.touching    = touching_.load(std::memory_order_relaxed);
+    const int64_t us = lastTouchUs_.load(std::memory_order_relaxed);
+    w.lastTouchMs = us < 0 ? -1 : us / 1000.0;
+
+    const size_t page = pageSize();
+    std::vector<unsigned char> vec(MINCORE_CHUNK / page);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Range& r : ranges_) {
+        w.mappedBytes += (int64_t)r.len;
+        for (size_t off = 0; off < r.len; off += MINCORE_CHUNK) {
+            const size_t len = std::min(MINCORE_CHUNK, r.len - off);
+            if (mincore(r.addr + off, len, vec.data()) != 0) continue;
+            const size_t pages = (len + page - 1) / page;
+            for (size_t i = 0; i < pages; i++) {
+                if (vec[i] & 1) w.residentBytes += (int64_t)page;
+            }
+        }
+    }
+    return w;
+}
@@ -0,0 +1,88 @@
+// weights_residency.h — how the model's weights are mapped, and keeping them in RAM.
+//
+// By default llama.cpp mmaps the GGUF file and lets the kernel fault weight pages
+// in on first use. After the phone has been idle the page cache has usually
+// dropped most of them, so the first request after a pause reads the model back
+// from flash one fault at a time. WeightsPolicy trades memory for latency:
+//
+//   useMmap     false copies the weights into anonymous memory at load — never
+//               evicted, only swapped (zram), but the full size counts against RSS
+//               and load reads the whole file up front.
+//   useMlock    pins the mapped weights. Needs RLIMIT_MEMLOCK headroom, which app
+//               processes normally do not have; llama.cpp logs a warning and
+//               carries on unpinned. WeightsResidency.lockedBytes shows the outcome.
+//   advice      madvise() on the file mappings after load and on every prefetch():
+//               WillNeed starts asynchronous readahead of the whole file,
+//               Sequential makes faults read ahead aggressively, Random turns
+//               readahead off (less memory when only part of the model is hot).
+//   touchPages  after load and on every prefetch(), a background thread reads one
+//               byte per page so the faults happen there rather than in the first
+//               prefill. Stopped before the mapping goes away.
+//
+// residency() counts resident pages with mincore(), so it is exact for the file
+// mappings and cheap enough (one syscall per 64 MiB) for a diagnostics screen.
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class WeightsAdvice : int {
+    None       = 0,
+    WillNeed   = 1,
+    Sequential = 2,
+    Random     = 3,
+};
+
+struct WeightsPolicy {
+    bool          useMmap    = true;
+    bool          useMlock   = false;
+    WeightsAdvice advice     = WeightsAdvice::None;
+    bool          touchPages = false;
+};
+
+struct WeightsResidency {
+    int64_t mappedBytes   = 0;    // file-backed mappings of the model
+    int64_t residentBytes = 0;    // of those, pages currently in RAM
+    int64_t lockedBytes   = 0;    // process VmLck
+    double  lastTouchMs   = -1;   // duration of the last completed touch pass; -1 none
+    bool    touching      = false;
+};
+
+class WeightsPager {
+public:
+    ~WeightsPager() { detach(); }
+
+    // After a model load: finds the mappings of path in /proc/self/maps.
+    void attach(const std::string& path);
+
+    // Before the model is freed: stops any touch pass and forgets the mappings.
+    void detach();
+
+    // madvise() on every mapping (None is a no-op).
+    void advise(WeightsAdvice advice);
+
+    // Starts a background touch pass unless one is running.
+    void startTouch();
+
+    WeightsResidency residency() const;
+
+private:
+    struct Range {
+        uint8_t* addr;
+        size_t   len;
+    };
+
+    void stopTouch();
+    void touch(std::vector<Range> ranges);
+
+    mutable std::mutex  mutex_;
+    std::vector<Range>  ranges_;
+    std::thread         toucher_;
+    std::atomic<bool>   stopTouch_{false};
+    std::atomic<bool>   touching_{false};
+    std::atomic<int64_t> lastTouchUs_{-1};
+};
@@ -1,11 +1,85 @@
 package com.aigentik.app.ai
 
 import android.util.Log
+import java.io.File
 import com.aigentik.app.core.AigentikPersona
+import kotlinx.coroutines.CancellationException
 import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.suspendCancellableCoroutine
 import kotlinx.coroutines.withContext
-
-// AiEngine v1.6
+import kotlin.coroutines.resume
+
+// AiEngine v3.3
+// v3.3: SMS cascade. With the small COMMAND_MODEL loaded, generateSmsReply() drafts
+//   the reply on it and keeps the draft when the model was sure of it. Otherwise
+//   the main model writes the reply (LlamaJNI.generateCascade()). Routine replies
+//   then take small-model time; getLastGenerationStats().cascade says which model
+//   answered.
+// v3.2: Per-task models. loadCommandModel() registers a small model as COMMAND_MODEL
+//   beside the main one, and interpretCommand() runs on it while it is loaded. Its
+//   greedy JSON does not need the reply model, and a 0.6B model answers several
+//   times sooner than a 4B one. Replies still come from the main model.
+// v3.1: switchModel() hot-swaps while READY. The current model keeps answering and
+//   isSwitching / loadProgress track the new one. It falls back to a cold
+//   loadModel() when the native side refuses because both models would not fit
+//   in memory.
+// v3.0: warmUp() calls the native warm-up instead of generating 4 tokens from a
+//   throwaway chat prompt. That skips the template, the context reset and the
+//   sampling, and still runs every weight and kernel once. The stage timings are
+//   logged.
+// v2.9: Weight residency policy. Weights stay mmap'd; after load and before the
+//   first request following WEIGHTS_IDLE_MS without one, the native side issues
+//   MADV_WILLNEED readahead over the model file and touches its pages on a
+//   background thread, so that request does not fault the model in from flash one
+//   page at a time. getWeightsResidency() reports the resident share.
+// v2.8: loadModel() uses the native background load — the coroutine suspends instead
+//   of pinning an IO thread, loadProgress (and getStateLabel()) follow the weights as
+//   they load, and cancelling the coroutine or calling cancelLoad() abandons it.
+// v2.7: Status queries never wait on the engine. getModelInfo() is one native call
+//   that reads the engine's published status snapshot (it was isLoaded() followed by
+//   getModelInfo(), which could straddle an unload). getStateLabel() shows
+//   "Generating..." while a request is running, from the metrics page.
+// v2.6: getMemoryStats(); the native memory breakdown is logged after each model load
+//   so OOM / LMK kills can be matched against the configuration that preceded them.
+// v2.5: writeTrace() saves the native trace spans as a Chrome trace JSON file.
+// v2.4: metrics — zero-JNI live engine counters for dashboard polling.
+// v2.3: getLastGenerationStats() exposes the native per-generation stats record.
+// v2.2: Long email threads are summarized instead of cut. When the body exceeds
+//   EMAIL_BODY_TOKENS or the thread history exceeds HISTORY_TOKEN_BUDGET,
+//   generateEmailReply() sends both as summarizable spans; the native side splits
+//   them into chunks, summarizes the chunks in parallel sequences, and writes the
+//   reply over the summaries. Such emails are left out of bulk prefetch so they
+//   take this path.
+// v2.1: Email bodies (and SMS/chat message text) are passed as truncatable spans;
+//   the native prompt builder cuts them to EMAIL_BODY_TOKENS and, if needed, further
+//   until prompt + reply budget fits the context — keeping the head and tail of the
+//   text with an omission marker rather than chopping the end off by characters.
+//   fitText() removed. budgetedPrompt() reserves the reply budget natively and only
+//   sheds history when even fully cut spans would not fit.
+// v2.0: Prompts are budgeted in tokens, not characters. Conversation history keeps
+//   the newest turns that fit HISTORY_TOKEN_BUDGET and email bodies are cut to
+//   EMAIL_BODY_TOKENS (was 2000 chars). Each reply prompt is tokenized once with
+//   LlamaJNI.tokenizeChat(); if prompt + reply budget would overflow the context,
+//   the oldest history turns are dropped before generating, and the measured token
+//   ids go straight to generateTokens(). Per-turn token counts are cached, so a
+//   thread's history is not re-counted on every message.
+// v1.9: All prompts go through LlamaJNI.generateChat() as structured system/user
+//   messages; the native side applies the loaded model's chat template, so non-Qwen
+//   GGUFs get their own format. interpretCommand()'s empty <think></think> block is
+//   passed as assistantPrefill. Bulk email prefetch passes the system prompt and one
+//   user turn per email.
+// v1.8: Bulk email replies. prefetchEmailReplies() generates replies for several
+//   emails in one native call — the shared email system prompt is prefilled once and
+//   forked per email (LlamaJNI.generateBulk). Results are held until the matching
+//   generateEmailReply() call consumes them, so MessageEngine's per-message flow is
+//   unchanged. To make the prefix shareable the per-sender details (name,
+//   relationship, instructions) moved from the email system prompt into the user turn.
+// v1.7: Per-contact KV session reuse. Every generate() call passes a session key
+//   (sms:<phone>, email:<address>, chat:owner, cmd) so the native layer can restore
+//   that conversation's KV cache and only prefill what changed — the long
+//   interpretCommand() system prompt in particular is prefilled once, not per call.
+//   configureSessionCache() sets the RAM budget (SESSION_RAM_MB) and the spill
+//   directory for evicted sessions.
 // v1.6: generateChatReply() — dedicated chat reply function with a chat-appropriate
 //   system prompt ("have a natural, helpful conversation") and no SMS signature or
 //   SMS framing. maxTokens=512 for fuller responses. Used by MessageEngine fast-path
@@ -48,6 +122,35 @@ object AiEngine {
 
     private const val TAG = "AiEngine"
 
+    // Engine::modelInfo() when nothing is loaded.
+    private const val NO_MODEL = "No model loaded"
+
+    // KV session budgets — ~30MB per SMS-sized session on Qwen3-4B at Q8_0, so
+    // 192MB keeps the hottest handful of contacts resident; the rest spill to disk.
+    private const val SESSION_RAM_MB  = 192
+    private const val SESSION_DISK_MB = 512
+
+    // Readahead + page touch again before a request after this long without one.
+    private const val WEIGHTS_IDLE_MS = 5 * 60 * 1000L
+
+    // Registry name of the model interpretCommand() prefers (LlamaJNI.addModel()).
+    private const val COMMAND_MODEL = "cmd"
+
+    // Cascade limits for SMS drafts — mean token entropy in nats, the least likely
+    // token the draft may contain, and the draft length after which the main model
+    // takes over (SMS replies are short; a longer draft is wasted time). Starting
+    // points, not yet measured on device: sweep them with aigentik_bench --cascade
+    // (README "Native layer") and keep the pair with the lowest sms latency whose
+    // small-tier replies still read well.
+    private const val CASCADE_MAX_ENTROPY  = 1.5f
+    private const val CASCADE_MIN_PROB     = 0.01f
+    private const val CASCADE_DRAFT_TOKENS = 96
+
+    // Prompt budgets in tokens.
+    private const val HISTORY_TOKEN_BUDGET = 1536
+    private const val EMAIL_BODY_TOKENS    = 1024
+    private const val TOKEN_COUNT_CACHE    = 256
+
     private var agentName = "Aigentik"
     private var ownerName = "Ish"
     private val llama = LlamaJNI.getInstance()
@@ -57,6 +160,19 @@ object AiEngine {
     @Volatile var state = State.NOT_LOADED
         private set
 
+    // Weight loading progress 0..1 while state == LOADING or isSwitching.
+    @Volatile var loadProgress = 0f
+        private set
+
+    // A hot swap is loading the next model; state stays READY meanwhile.
+    @Volatile var isSwitching = false
+        private set
+
+    // COMMAND_MODEL is registered; interpretCommand() runs on it and SMS replies are
+    // drafted on it.
+    @Volatile var hasCommandModel = false
+        private set
+
     fun configure(agentName: String, ownerName: String) {
         this.agentName = agentName
         this.ownerName = ownerName
@@ -65,6 +181,101 @@ object AiEngine {
         AigentikPersona.ownerName = ownerName
     }
 
+    // Called by AigentikService on startup — dir is in app-private cache storage.
+    fun configureSessionCache(dir: java.io.File) {
+        llama.configureSessionCache(dir.absolutePath, SESSION_RAM_MB, SESSION_DISK_MB)
+    }
+
+    fun getSessionStats(): String = llama.getSessionStats()
+
+    // Live native counters — cheap enough to read every frame.
+    val metrics: EngineMetrics get() = llama.metrics
+
+    // Writes the recorded native trace spans to dir as Chrome trace JSON and clears
+    // them. Returns the file, or null when tracing is not compiled in.
+    fun writeTrace(dir: File): File? {
+        if (!llama.isTraceEnabled()) return null
+        val json = llama.dumpTrace(clear = true) ?: return null
+        return try {
+            File(dir, "aigentik-trace-${System.currentTimeMillis()}.json").apply { writeText(json) }
+        } catch (e: Exception) {
+            Log.e(TAG, "Trace write failed: ${e.message}")
+            null
+        }
+    }
+
+    // Native memory breakdown (null if the native library is unavailable).
+    fun getMemoryStats(): MemoryStats? = llama.memoryStats()
+
+    // Share of the mapped weights in RAM (null if the native library is unavailable).
+    fun getWeightsResidency(): WeightsResidency? = llama.weightsResidency()
+
+    @Volatile private var lastRequestAt = 0L
+
+    // Called at the start of every generation. After an idle period the page cache
+    // has usually dropped much of the model; prefetchWeights() returns immediately
+    // and the readahead and touch pass overlap prompt building and prefill.
+    private fun wakeWeights() {
+        val now = System.currentTimeMillis()
+        if (now - lastRequestAt > WEIGHTS_IDLE_MS) llama.prefetchWeights()
+        lastRequestAt = now
+    }
+
+    // Timings of the most recent reply generation (null before the first one).
+    fun getLastGenerationStats(): GenerationStats? =
+        llama.lastStats()?.takeIf { it.stopReason != GenerationStats.StopReason.NONE }
+
+    // Token counts of recently seen text (history turns repeat across messages).
+    private val tokenCounts = object : LinkedHashMap<String, Int>(TOKEN_COUNT_CACHE, 0.75f, true) {
+        override fun removeEldestEntry(eldest: MutableMap.MutableEntry<String, Int>?) =
+            size > TOKEN_COUNT_CACHE
+    }
+
+    // Tokens text costs in a prompt. Falls back to a ~4 chars/token estimate
+    // when no model is loaded (the prompt is not generated then anyway).
+    private fun tokenCount(text: String): Int {
+        synchronized(tokenCounts) { tokenCounts[text]?.let { return it } }
+        val n = llama.countTokens(text)
+        if (n < 0) return (text.length + 3) / 4
+        synchronized(tokenCounts) { tokenCounts[text] = n }
+        return n
+    }
+
+    // Newest history turns whose tokens (plus a newline each) fit budget, in order.
+    private fun fitHistory(history: List<String>, budget: Int): List<String> {
+        var used = 0
+        var keep = 0
+        for (turn in history.asReversed()) {
+            used += tokenCount(turn) + 1
+            if (used > budget) break
+            keep++
+        }
+        return history.takeLast(keep)
+    }
+
+    // Prompt tokens for [system, userTurn(history)] leaving room for maxTokens.
+    // History is first trimmed to HISTORY_TOKEN_BUDGET; truncatable spans are cut
+    // natively (to segmentBudget, then to fit). Only if the prompt still cannot fit
+    // is the older half of the history dropped and the prompt rebuilt.
+    private fun budgetedPrompt(
+        systemMsg: String,
+        history: List<String>,
+        maxTokens: Int,
+        segmentBudget: Int = 0,
+        userTurn: (List<String>) -> String
+    ): IntArray {
+        var turns = fitHistory(history, HISTORY_TOKEN_BUDGET)
+        while (true) {
+            val tokens = llama.tokenizeChat(
+                listOf(ChatTurn.system(systemMsg), ChatTurn.user(userTurn(turns))),
+                reserveTokens = maxTokens, segmentBudget = segmentBudget
+            )
+            if (tokens.isNotEmpty() || turns.isEmpty()) return tokens
+            Log.d(TAG, "budgetedPrompt: prompt does not fit — dropping ${(turns.size + 1) / 2} turn(s)")
+            turns = turns.drop((turns.size + 1) / 2)
+        }
+    }
+
     // Load model then warm up — called by AigentikService on startup
     // NOT on first message — ensures first reply has no cold-start delay
     suspend fun loadModel(modelPath: String): Boolean = withContext(Dispatchers.IO) {
@@ -73,16 +284,27 @@ object AiEngine {
             return@withContext false
         }
         state = State.LOADING
+        loadProgress = 0f
         Log.i(TAG, "Loading model: $modelPath")
-
-        val loaded = llama.loadModel(modelPath)
+        llama.setWeightsPolicy(advice = WeightsAdvice.WILL_NEED, touchPages = true)
+
+        val loaded = try {
+            loadInBackground(modelPath)
+        } catch (e: CancellationException) {
+            Log.i(TAG, "Model load cancelled")
+            state = State.NOT_LOADED
+            throw e
+        }
         if (!loaded) {
-            Log.e(TAG, "Model load failed")
-            state = State.ERROR
+            // The native side reports a cancelled load as NOT_LOADED, a failed one as ERROR.
+            state = if (metrics.state == EngineMetrics.State.NOT_LOADED) State.NOT_LOADED else State.ERROR
+            Log.e(TAG, if (state == State.NOT_LOADED) "Model load cancelled" else "Model load failed")
             return@withContext false
         }
 
         Log.i(TAG, "Model loaded — ${llama.getModelInfo()}")
+        llama.memoryStats()?.let { Log.i(TAG, "Memory — ${it.summary()}") }
+        lastRequestAt = System.currentTimeMillis()    // load already prefetched
         state = State.WARMING
         warmUp()
         state = State.READY
@@ -90,14 +312,86 @@ object AiEngine {
         true
     }
 
-    // Warm-up: fire a trivial prompt to prime JIT compilation and KV cache
-    // 4 tokens is enough — takes ~2s but saves 2s on the first real message
+    // Abandons a load in progress; loadModel() then returns false.
+    fun cancelLoad() = llama.cancelLoad()
+
+    // Switch to another model. While READY the current model keeps serving until the
+    // new one is loaded and warm (native hot swap); otherwise, or when the device
+    // cannot hold both models, this is a plain loadModel().
+    suspend fun switchModel(modelPath: String): Boolean = withContext(Dispatchers.IO) {
+        if (state != State.READY) return@withContext loadModel(modelPath)
+        var result = SwapResult.BUSY
+        isSwitching = true
+        loadProgress = 0f
+        Log.i(TAG, "Switching model: $modelPath")
+        val swapped = try {
+            awaitNativeLoad { listener ->
+                result = llama.swapModelAsync(modelPath, listener)
+                result == SwapResult.STARTED
+            }
+        } catch (e: CancellationException) {
+            Log.i(TAG, "Model switch cancelled — previous model still loaded")
+            throw e
+        } finally {
+            isSwitching = false
+        }
+        when (result) {
+            SwapResult.STARTED -> {
+                if (swapped) Log.i(TAG, "Model switched — ${llama.getModelInfo()}")
+                else Log.e(TAG, "Model switch failed — previous model still loaded")
+                swapped
+            }
+            SwapResult.NO_MEMORY, SwapResult.NOT_LOADED -> {
+                Log.i(TAG, "Hot swap refused ($result) — loading cold")
+                loadModel(modelPath)
+            }
+            SwapResult.BUSY -> {
+                Log.w(TAG, "Load already in progress")
+                false
+            }
+        }
+    }
+
+    // Loads a small model for command parsing and SMS drafts beside the main one —
+    // called by AigentikService after loadModel(). False (and everything stays on the
+    // main model) if it failed or does not fit in memory beside the main model.
+    suspend fun loadCommandModel(modelPath: String): Boolean = withContext(Dispatchers.IO) {
+        Log.i(TAG, "Loading command model: $modelPath")
+        hasCommandModel = llama.addModel(COMMAND_MODEL, modelPath)
+        if (hasCommandModel) Log.i(TAG, "Command model ready")
+        else Log.w(TAG, "Command model not loaded — commands use the main model")
+        hasCommandModel
+    }
+
+    // Suspends until the native loader thread finishes. Cancelling the coroutine
+    // cancels the native load.
+    private suspend fun loadInBackground(path: String): Boolean =
+        awaitNativeLoad { listener -> llama.loadModelAsync(path, listener) }
+
+    // start() hands the listener to a native background load and reports whether
+    // it started; false completes at once.
+    private suspend fun awaitNativeLoad(start: (LlamaJNI.LoadListener) -> Boolean): Boolean =
+        suspendCancellableCoroutine { cont ->
+            val started = start(object : LlamaJNI.LoadListener {
+                override fun onProgress(progress: Float) { loadProgress = progress }
+                override fun onComplete(success: Boolean) {
+                    if (cont.isActive) cont.resume(success)
+                }
+            })
+            if (started) cont.invokeOnCancellation { llama.cancelLoad() } else cont.resume(false)
+        }
+
+    // Warm-up: native graph over every weight, buffers faulted in, threads awake —
+    // the first real message then runs at steady-state speed
     private fun warmUp() {
         try {
             Log.i(TAG, "Warming up...")
-            val prompt = llama.buildChatPrompt("You are a helpful assistant.", "Hello")
-            val result = llama.generate(prompt, 4, temperature = 0.7f, topP = 0.9f)
-            Log.i(TAG, "Warm-up done — ${result.length} chars")
+            val w = llama.warmup()
+            when {
+                w == null -> Log.w(TAG, "Warm-up unavailable")
+                w.ok      -> Log.i(TAG, "Warm-up done — ${w.summary()}")
+                else      -> Log.w(TAG, "Warm-up decode failed (non-fatal) after %.0f ms".format(w.totalMs))
+            }
         } catch (e: Throwable) {
             // Non-fatal — model still works, first call just slower.
             // Catching Throwable (not just Exception) to handle OutOfMemoryError
@@ -108,13 +402,16 @@ object AiEngine {
 
     fun isReady() = state == State.READY
 
-    fun getModelInfo(): String = if (llama.isLoaded()) llama.getModelInfo() else "Not loaded"
+    // Lock-free on the native side — safe to poll from the UI thread.
+    fun getModelInfo(): String = llama.getModelInfo().let { if (it == NO_MODEL) "Not loaded" else it }
 
     fun getStateLabel(): String = when {
         !llama.isNativeLibLoaded()   -> "Native lib error"
         state == State.NOT_LOADED    -> "Not loaded"
-        state == State.LOADING       -> "Loading..."
+        state == State.LOADING       -> "Loading... ${(loadProgress * 100).toInt()}%"
         state == State.WARMING       -> "Warming up..."
+        state == State.READY && isSwitching -> "Ready (switching ${(loadProgress * 100).toInt()}%)"
+        state == State.READY && metrics.state == EngineMetrics.State.GENERATING -> "Generating..."
         state == State.READY         -> "Ready"
         else                         -> "Error"
     }
@@ -139,6 +436,7 @@ object AiEngine {
             Log.w(TAG, "Model not ready — using fallback")
             return@withContext fallbackSmsReply(senderName, senderPhone) + signature
         }
+        wakeWeights()
 
         val systemMsg = "You are $agentName, an AI personal assistant for $ownerName. " +
             "Reply to a text message sent to $ownerName from ${senderName ?: senderPhone}. " +
@@ -148,24 +446,51 @@ object AiEngine {
             "Do NOT add a signature. Reply with message text only."
 
         // Build user turn: prepend conversation history if present
-        val userTurn = buildString {
-            if (conversationHistory.isNotEmpty()) {
-                appendLine("Previous conversation:")
-                conversationHistory.forEach { appendLine(it) }
-                appendLine("---")
+        val userTurn = { history: List<String> ->
+            buildString {
+                if (history.isNotEmpty()) {
+                    appendLine("Previous conversation:")
+                    history.forEach { appendLine(it) }
+                    appendLine("---")
+                }
+                append("Reply to: \"${LlamaJNI.truncatable(message)}\" from ${senderName ?: senderPhone}")
             }
-            append("Reply to: \"$message\" from ${senderName ?: senderPhone}")
         }
 
-        val prompt = llama.buildChatPrompt(systemMsg, userTurn)
+        // Cascade: the models tokenize differently, so the messages go native and
+        // each model fits them to its own context.
+        if (hasCommandModel) {
+            val messages = listOf(
+                ChatTurn.system(systemMsg),
+                ChatTurn.user(userTurn(fitHistory(conversationHistory, HISTORY_TOKEN_BUDGET)))
+            )
+            Log.d(TAG, "generateSmsReply: invoking llama.generateCascade()")
+            val raw = try {
+                llama.generateCascade(messages, COMMAND_MODEL, 256, temperature = 0.7f, topP = 0.9f,
+                    sessionKey = "sms:$senderPhone",
+                    maxMeanEntropy = CASCADE_MAX_ENTROPY, minTokenProb = CASCADE_MIN_PROB,
+                    draftMaxTokens = CASCADE_DRAFT_TOKENS)
+            } catch (e: Throwable) {
+                Log.e(TAG, "generateSmsReply: llama.generateCascade() threw ${e.javaClass.simpleName}: ${e.message}")
+                null
+            }
+            getLastGenerationStats()?.cascade?.let { Log.d(TAG, "generateSmsReply: cascade ${it.summary()}") }
+            val reply = raw?.trim() ?: ""
+            return@withContext if (reply.isEmpty()) fallbackSmsReply(senderName, senderPhone) + signature
+                               else reply + signature
+        }
+
+        val prompt = budgetedPrompt(systemMsg, conversationHistory, 256, userTurn = userTurn)
+
         // temperature=0.7 + topP=0.9: natural, varied SMS replies
         // Null-safe: nativeGenerate() can return null (OOM/native-side error).
         // Catching Throwable ensures native JNI errors don't propagate as NPE.
-        Log.d(TAG, "generateSmsReply: invoking llama.generate()")
+        Log.d(TAG, "generateSmsReply: invoking llama.generateTokens() — ${prompt.size} prompt tokens")
         val raw = try {
-            llama.generate(prompt, 256, temperature = 0.7f, topP = 0.9f)
+            llama.generateTokens(prompt, 256, temperature = 0.7f, topP = 0.9f,
+                sessionKey = "sms:$senderPhone")
         } catch (e: Throwable) {
-            Log.e(TAG, "generateSmsReply: llama.generate() threw ${e.javaClass.simpleName}: ${e.message}")
+            Log.e(TAG, "generateSmsReply: llama.generateTokens() threw ${e.javaClass.simpleName}: ${e.message}")
             null
         }
         val reply = raw?.trim() ?: ""
@@ -174,8 +499,93 @@ object AiEngine {
         else reply + signature
     }
 
-    // Generate email reply — 512 tokens, up to 2000 char body
+    // One email to reply to — parameters of generateEmailReply() as a value,
+    // used to queue bulk prefetches.
+    data class EmailReplyRequest(
+        val fromName: String?,
+        val fromEmail: String,
+        val subject: String,
+        val body: String,
+        val relationship: String?,
+        val instructions: String?,
+        val conversationHistory: List<String> = emptyList()
+    )
+
+    // Replies produced by prefetchEmailReplies(), keyed by prefetchKey() and consumed
+    // (removed) by generateEmailReply(). Bounded — stale entries are dropped wholesale.
+    private val prefetchedEmailReplies = java.util.concurrent.ConcurrentHashMap<String, String>()
+    private const val MAX_PREFETCHED = 32
+
+    private fun prefetchKey(r: EmailReplyRequest): String =
+        "${r.fromEmail.lowercase()}|${r.subject}|${r.body.hashCode()}|${r.conversationHistory.hashCode()}"
+
+    // Identical for every email — this is the prefix shared by bulk generation
+    // and by the per-contact KV sessions.
+    private fun emailSystemPrompt(): String =
+        "You are $agentName, an AI personal assistant for $ownerName. " +
+        "You reply to emails sent to $ownerName. " +
+        "Follow any IMPORTANT instruction given for the sender. " +
+        "Be professional and natural. Do NOT add a signature."
+
+    // summarize: pass history and body as summarizable spans (long threads) rather
+    // than trimmed history and a truncatable body.
+    private fun emailUserTurn(
+        r: EmailReplyRequest,
+        history: List<String> = fitHistory(r.conversationHistory, HISTORY_TOKEN_BUDGET),
+        summarize: Boolean = false
+    ): String = buildString {
+        appendLine("From: ${r.fromName ?: r.fromEmail}")
+        r.relationship?.let { appendLine("Relationship: $it") }
+        r.instructions?.let { appendLine("IMPORTANT: $it") }
+        if (history.isNotEmpty()) {
+            appendLine("Previous thread context:")
+            if (summarize) appendLine(LlamaJNI.summarizable(history.joinToString("\n")))
+            else history.forEach { appendLine(it) }
+            appendLine("---")
+        }
+        val body = if (summarize) LlamaJNI.summarizable(r.body) else LlamaJNI.truncatable(r.body)
+        append("Subject: ${r.subject}\nBody: $body\n\nWrite a reply.")
+    }
+
+    // Too long for the regular budgets — reply over a native summary instead.
+    private fun isLongThread(r: EmailReplyRequest): Boolean =
+        llama.countTokens(r.body) > EMAIL_BODY_TOKENS ||
+            r.conversationHistory.sumOf { tokenCount(it) + 1 } > HISTORY_TOKEN_BUDGET
+
+    // Generate replies for several emails at once and hold them for generateEmailReply().
+    // One native call: shared prefix prefilled once, all replies decoded in lockstep.
+    // No-op for fewer than two requests — the single path is just as fast then.
+    suspend fun prefetchEmailReplies(requests: List<EmailReplyRequest>) = withContext(Dispatchers.IO) {
+        if (!isReady()) return@withContext
+        wakeWeights()
+        // Long threads go through generateEmailReply()'s summarizing path instead.
+        val eligible = requests.filterNot { isLongThread(it) }
+        if (eligible.size < 2) return@withContext
+        val userTurns = eligible.map { emailUserTurn(it) }
+        Log.d(TAG, "prefetchEmailReplies: invoking llama.generateBulk() for ${eligible.size} emails")
+        val replies = try {
+            llama.generateBulk(emailSystemPrompt(), userTurns, 512, temperature = 0.7f, topP = 0.9f,
+                segmentBudget = EMAIL_BODY_TOKENS)
+        } catch (e: Throwable) {
+            Log.e(TAG, "prefetchEmailReplies: generateBulk() threw ${e.javaClass.simpleName}: ${e.message}")
+            return@withContext
+        }
+        if (prefetchedEmailReplies.size + eligible.size > MAX_PREFETCHED) prefetchedEmailReplies.clear()
+        eligible.zip(replies).forEach { (r, reply) ->
+            val trimmed = reply.trim()
+            if (trimmed.isNotEmpty()) prefetchedEmailReplies[prefetchKey(r)] = trimmed
+        }
+        Log.i(TAG, "prefetchEmailReplies: ${replies.count { it.isNotBlank() }}/${eligible.size} ready")
+    }
+
+    // Generate email reply — 512 tokens, body up to EMAIL_BODY_TOKENS (longer
+    // threads are summarized first, see isLongThread())
     // conversationHistory: prior turns in this email thread (chronological, oldest first)
+    suspend fun generateEmailReply(r: EmailReplyRequest): String = generateEmailReply(
+        r.fromName, r.fromEmail, r.subject, r.body, r.relationship, r.instructions,
+        r.conversationHistory
+    )
+
     suspend fun generateEmailReply(
         fromName: String?,
         fromEmail: String,
@@ -191,30 +601,37 @@ object AiEngine {
         if (!isReady()) {
             return@withContext fallbackEmailReply(fromName, fromEmail) + signature
         }
-
-        val systemMsg = "You are $agentName, an AI personal assistant for $ownerName. " +
-            "Reply to an email sent to $ownerName from ${fromName ?: fromEmail}. " +
-            (relationship?.let { "Relationship: $it. " } ?: "") +
-            (instructions?.let { "IMPORTANT: $it. " } ?: "") +
-            "Be professional and natural. Do NOT add a signature."
-
-        val userTurn = buildString {
-            if (conversationHistory.isNotEmpty()) {
-                appendLine("Previous thread context:")
-                conversationHistory.forEach { appendLine(it) }
-                appendLine("---")
-            }
-            append("Subject: $subject\nBody: ${body.take(2000)}\n\nWrite a reply.")
+        wakeWeights()
+
+        val request = EmailReplyRequest(
+            fromName, fromEmail, subject, body, relationship, instructions, conversationHistory
+        )
+        prefetchedEmailReplies.remove(prefetchKey(request))?.let {
+            Log.d(TAG, "generateEmailReply: using prefetched reply")
+            return@withContext it + signature
         }
 
-        val prompt = llama.buildChatPrompt(systemMsg, userTurn)
         // temperature=0.7 + topP=0.9: professional but not robotic email replies
         // Null-safe: same reasoning as generateSmsReply above.
-        Log.d(TAG, "generateEmailReply: invoking llama.generate()")
         val raw = try {
-            llama.generate(prompt, 512, temperature = 0.7f, topP = 0.9f)
+            if (isLongThread(request)) {
+                Log.d(TAG, "generateEmailReply: long thread — invoking llama.generateChat() with summarization")
+                val messages = listOf(
+                    ChatTurn.system(emailSystemPrompt()),
+                    ChatTurn.user(emailUserTurn(request, conversationHistory, summarize = true))
+                )
+                llama.generateChat(messages, 512, temperature = 0.7f, topP = 0.9f,
+                    sessionKey = "email:$fromEmail", summarizeAbove = EMAIL_BODY_TOKENS)
+            } else {
+                val prompt = budgetedPrompt(emailSystemPrompt(), conversationHistory, 512, EMAIL_BODY_TOKENS) {
+                    emailUserTurn(request, it)
+                }
+                Log.d(TAG, "generateEmailReply: invoking llama.generateTokens() — ${prompt.size} prompt tokens")
+                llama.generateTokens(prompt, 512, temperature = 0.7f, topP = 0.9f,
+                    sessionKey = "email:$fromEmail")
+            }
         } catch (e: Throwable) {
-            Log.e(TAG, "generateEmailReply: llama.generate() threw ${e.javaClass.simpleName}: ${e.message}")
+            Log.e(TAG, "generateEmailReply: llama generation threw ${e.javaClass.simpleName}: ${e.message}")
             null
         }
         val reply = raw?.trim() ?: ""
@@ -235,29 +652,32 @@ object AiEngine {
             Log.w(TAG, "generateChatReply: model not ready")
             return@withContext "I'm not loaded yet. Go to Settings → AI Model to load a model."
         }
+        wakeWeights()
 
         val systemMsg = "You are $agentName, an AI personal assistant for $ownerName. " +
             "Have a natural, helpful conversation. " +
             "You can manage Gmail, reply to texts, look up contacts, and more. " +
             "Be concise and direct. Do not add any signature or sign-off."
 
-        val userTurn = buildString {
-            if (conversationHistory.isNotEmpty()) {
-                appendLine("Previous conversation:")
-                conversationHistory.forEach { appendLine(it) }
-                appendLine("---")
+        val prompt = budgetedPrompt(systemMsg, conversationHistory, 512) { history ->
+            buildString {
+                if (history.isNotEmpty()) {
+                    appendLine("Previous conversation:")
+                    history.forEach { appendLine(it) }
+                    appendLine("---")
+                }
+                append(LlamaJNI.truncatable(message))
             }
-            append(message)
         }
 
-        val prompt = llama.buildChatPrompt(systemMsg, userTurn)
         // temperature=0.7 + topP=0.9: natural conversational replies
         // Null-safe: nativeGenerate() can return null (OOM/native-side error).
-        Log.d(TAG, "generateChatReply: invoking llama.generate()")
+        Log.d(TAG, "generateChatReply: invoking llama.generateTokens() — ${prompt.size} prompt tokens")
         val raw = try {
-            llama.generate(prompt, 512, temperature = 0.7f, topP = 0.9f)
+            llama.generateTokens(prompt, 512, temperature = 0.7f, topP = 0.9f,
+                sessionKey = "chat:owner")
         } catch (e: Throwable) {
-            Log.e(TAG, "generateChatReply: llama.generate() threw ${e.javaClass.simpleName}: ${e.message}")
+            Log.e(TAG, "generateChatReply: llama.generateTokens() threw ${e.javaClass.simpleName}: ${e.message}")
             null
         }
         val reply = raw?.trim() ?: ""
@@ -269,6 +689,7 @@ object AiEngine {
     suspend fun interpretCommand(commandText: String): CommandResult =
         withContext(Dispatchers.IO) {
             if (!isReady()) return@withContext parseSimpleCommand(commandText)
+            wakeWeights()
 
             val systemMsg = "You interpret commands for an AI assistant. " +
                 "Return ONLY valid JSON with no extra text: " +
@@ -300,19 +721,21 @@ object AiEngine {
                 "\"always reply formally to John\" -> {\"action\":\"set_contact_instructions\",\"target\":\"John\",\"content\":\"always reply formally\",\"query\":null} " +
                 "\"when texting Mom be casual\" -> {\"action\":\"set_contact_instructions\",\"target\":\"Mom\",\"content\":\"be casual and friendly\",\"query\":null}"
 
-            // Append empty <think> block to the assistant prefill — Qwen3-specific trick
+            // Empty <think> block as the assistant prefill — Qwen3-specific trick
             // to disable thinking mode for this call. Qwen3 sees <think> already closed
             // in the prompt and skips chain-of-thought, going straight to JSON output.
             // parse_special=true in llama_tokenize() ensures <think>/<|im_end|> etc. are
             // tokenised as their proper special token IDs, not as plain text.
-            val prompt = llama.buildChatPrompt(systemMsg, "Command: \"$commandText\"") +
-                "<think>\n\n</think>\n"
+            val messages = listOf(ChatTurn.system(systemMsg), ChatTurn.user("Command: \"$commandText\""))
             try {
                 // temperature=0.0 → greedy for deterministic JSON output
                 // Command parsing needs reliability over creativity
                 // Null-safe: nativeGenerate() can return null; treat as parse failure.
-                Log.d(TAG, "interpretCommand: invoking llama.generate()")
-                val rawStr = llama.generate(prompt, 120, temperature = 0.0f, topP = 1.0f)
+                Log.d(TAG, "interpretCommand: invoking llama.generateChat()")
+                // Shared "cmd" session: the long system prompt stays cached in KV.
+                val rawStr = llama.generateChat(messages, 120, temperature = 0.0f, topP = 1.0f,
+                    assistantPrefill = "<think>\n\n</think>\n", sessionKey = "cmd",
+                    model = if (hasCommandModel) COMMAND_MODEL else null)
                 val raw = rawStr?.trim() ?: return@withContext parseSimpleCommand(commandText)
                 // Strip <think>...</think> blocks first — Qwen3 thinking-mode models
                 // generate these before the JSON output. With maxTokens=120 the thinking
@@ -0,0 +1,69 @@
+package com.aigentik.app.ai
+
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+// EngineMetrics v1.1 — read-only view of the native metrics page (metrics.h)
+// v1.1: loadProgress (page layout version 2).
+// The page is a DirectByteBuffer over native 64-bit atomics, mapped once. Every
+// getter is a plain 8-byte load — no JNI call and no lock — so the UI can poll it
+// every frame while a generation is running.
+// Offsets must match MetricsPage in metrics.h (layout is append-only).
+class EngineMetrics internal constructor(buffer: ByteBuffer?) {
+
+    enum class State { NOT_LOADED, LOADING, READY, GENERATING, ERROR }
+
+    companion object {
+        private const val OFF_LAYOUT_VERSION  = 0
+        private const val OFF_STATE           = 8
+        private const val OFF_ACTIVE_REQUESTS = 16
+        private const val OFF_QUEUE_DEPTH     = 24
+        private const val OFF_TOK_PER_SEC_MILLI = 32
+        private const val OFF_KV_CELLS_USED   = 40
+        private const val OFF_KV_CELLS_TOTAL  = 48
+        private const val OFF_RSS_BYTES       = 56
+        private const val OFF_TOTAL_TOKENS    = 64
+        private const val OFF_TOTAL_PROMPT_TOKENS = 72
+        private const val OFF_TOTAL_REQUESTS  = 80
+        private const val OFF_UPDATES         = 88
+        private const val PAGE_SIZE_V1        = 96
+        // v2
+        private const val OFF_LOAD_PROGRESS_MILLI = 96
+        private const val PAGE_SIZE_V2        = 104
+    }
+
+    private val page: ByteBuffer? =
+        buffer?.takeIf { it.capacity() >= PAGE_SIZE_V1 }?.order(ByteOrder.nativeOrder())
+
+    // Absolute getLong() leaves the buffer position alone — safe from any thread.
+    private fun at(offset: Int): Long = page?.getLong(offset) ?: 0L
+
+    // False when the native library (and so the page) is unavailable.
+    val available: Boolean get() = page != null && at(OFF_LAYOUT_VERSION) >= 1
+
+    val state: State get() = State.values().getOrElse(at(OFF_STATE).toInt()) { State.ERROR }
+    val activeRequests: Long get() = at(OFF_ACTIVE_REQUESTS)
+    val queueDepth: Long get() = at(OFF_QUEUE_DEPTH)
+    val tokensPerSec: Double get() = at(OFF_TOK_PER_SEC_MILLI) / 1000.0
+    val kvCellsUsed: Long get() = at(OFF_KV_CELLS_USED)
+    val kvCellsTotal: Long get() = at(OFF_KV_CELLS_TOTAL)
+    val rssBytes: Long get() = at(OFF_RSS_BYTES)
+    val totalTokens: Long get() = at(OFF_TOTAL_TOKENS)
+    val totalPromptTokens: Long get() = at(OFF_TOTAL_PROMPT_TOKENS)
+    val totalRequests: Long get() = at(OFF_TOTAL_REQUESTS)
+
+    // Model load progress 0..1 (1 once loaded; 0 on a v1 page).
+    val loadProgress: Float get() =
+        if (at(OFF_LAYOUT_VERSION) >= 2 && (page?.capacity() ?: 0) >= PAGE_SIZE_V2)
+            at(OFF_LOAD_PROGRESS_MILLI) / 1000f else 0f
+
+    // Increments on every native change — compare to skip redundant redraws.
+    val updates: Long get() = at(OFF_UPDATES)
+
+    fun summary(): String {
+        if (!available) return "Metrics unavailable"
+        return "$state | %.1f tok/s | KV $kvCellsUsed/$kvCellsTotal | RSS ${rssBytes / (1024 * 1024)}MB | "
+            .format(tokensPerSec) +
+            "active $activeRequests, queued $queueDepth | $totalTokens tok / $totalRequests req"
+    }
+}
@@ -1,8 +1,78 @@
 package com.aigentik.app.ai
 
 import android.util.Log
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
 
-// LlamaJNI v0.9.5 — Kotlin-side mutex prevents concurrent JNI calls
+// LlamaJNI v2.5 — Kotlin-side mutex prevents concurrent JNI calls
+// v2.5: generateCascade(): generateChat() drafted by a small registered model and
+//   redone by the primary model when the draft is not confident (mean token entropy
+//   above maxMeanEntropy, or a token below minTokenProb). GenerationStats.cascade
+//   says which tier answered. The draft is greedy and capped at draftMaxTokens.
+// v2.4: Model registry. addModel(name, path) loads a further model beside the
+//   primary one, and removeModel()/modelNames() manage the set. generate() and
+//   generateChat() take `model` to pick one by name (null = primary). addModel()
+//   blocks for the load but, like swapModelAsync(), does not take the Kotlin lock.
+// v2.3: swapModelAsync() replaces the loaded model without a gap in service. The
+//   current model answers requests until the new one is loaded and warm. Like
+//   loadModelAsync() it does not take the Kotlin lock.
+// v2.2: warmup(): a native warm-up with no generation. It wakes the threads, faults
+//   in the buffers and runs one graph over every weight, and returns WarmupStats
+//   with the time each stage took.
+// v2.1: setHugePages()/hugePageInfo() — transparent huge pages for the KV cache,
+//   compute buffers and anonymous weight copies; HwCounters.dtlbMisses.
+// v2.0: setWeightsPolicy()/prefetchWeights()/weightsResidency() — mmap and mlock
+//   choice, madvise readahead hints and a background page-touch pass for the model
+//   weights, and how much of them is resident.
+// v1.9: loadModelAsync() — loads on a native thread and reports progress and
+//   completion through a LoadListener; cancelLoad() abandons it. It does not take
+//   the Kotlin lock (the native engine serializes the load against generations).
+// v1.8: Text crosses JNI as UTF-8 byte[] — prompts, chat messages, session keys and
+//   tokenizer input are encoded here (utf8()), and replies come back as bytes
+//   decoded here (decode()). Natives are bound by RegisterNatives in JNI_OnLoad, so
+//   the external declarations below must match the table in llama_jni.cpp.
+// v1.7: memoryStats() — native memory breakdown (weights mapped/anonymous/resident,
+//   KV, compute buffers, malloc arena, RSS/PSS/swap, peak RSS since load).
+// v1.6: GenerationStats.prefillCounters/decodeCounters — hardware counters per
+//   phase (cycles, instructions, cache and branch misses); null unless the native
+//   library was built with AIGENTIK_PERF_COUNTERS and the kernel allows it.
+// v1.5: setOpProfiling()/opProfileReport() — opt-in per-op, per-tensor and per-layer
+//   wall time of the compute graph, for judging kernel and quantization changes.
+// v1.4: isTraceEnabled()/dumpTrace() — Chrome trace JSON of the native pipeline
+//   spans (tokenize, prefill, per-token sample/detokenize/decode, ...). Spans are
+//   only recorded in builds made with -Paigentik.trace=ON.
+// v1.3: metrics — EngineMetrics view over the native metrics page, fetched once
+//   with nativeMetricsBuffer(); reading it afterwards involves no JNI at all.
+// v1.2: lastStats() — GenerationStats of the most recent single-prompt generation
+//   (prefill/decode throughput, TTFT, sampler time, stop reason, peak KV cells).
+//   Lock-free on the Kotlin side; the native record has its own small mutex.
+// v1.1: Summarizable spans. Content wrapped with summarizable() and longer than
+//   generateChat()'s summarizeAbove is replaced natively by a map-reduce summary
+//   (chunks summarized in parallel sequences) before the reply is generated.
+// v1.0: Truncatable spans. Content wrapped with truncatable() may be shortened
+//   natively — head and tail kept around an omission marker — first to
+//   segmentBudget tokens, then as far as needed for prompt + maxTokens to fit the
+//   context. generateChat()/generateBulk()/tokenizeChat() take segmentBudget;
+//   tokenizeChat() takes the reply budget to reserve.
+// v0.9.9: Token-level API. tokenize()/tokenizeChat() return prompt token ids (copied
+//   out of a per-thread direct buffer the native side writes into), countTokens()
+//   returns just the count, generateTokens() generates from ids the caller already
+//   has, and contextSize() reports the window. tokenize()/countTokens() do not take
+//   the generation lock — the native side only needs the model to stay loaded.
+// v0.9.8: generateChat() — structured messages (role + content) are formatted
+//   natively with the loaded model's own chat template instead of hard-coded
+//   Qwen ChatML strings; unchanged segments (system prompt, persona) reuse cached
+//   tokens. buildChatPrompt()/buildChatPrefix()/buildChatSuffix() removed.
+//   generateBulk() now takes the shared system prompt and one user message per reply.
+// v0.9.7: generateBulk() — N prompts sharing one prefix are generated together;
+//   the prefix is prefilled once and forked natively (llama_memory_seq_cp).
+//   buildChatPrompt() is now split into buildChatPrefix() + buildChatSuffix() so
+//   callers can form the shared prefix from the same ChatML text.
+// v0.9.6: Per-contact KV sessions. generate() takes an optional sessionKey — the
+//   native side restores that key's KV state and only prefills the part of the
+//   prompt that changed since its last generation. configureSessionCache() sets the
+//   RAM budget and spill directory; getSessionStats() reports hit rate and restore
+//   latency. getSessionStats() does not take the lock (native cache has its own).
 // v0.9.5: nativeLibLoaded flag exposed so AiEngine can distinguish
 //   "native .so failed to load" from "model not yet loaded". Enables
 //   dashboard to show "Native lib error" vs "No model" accurately.
@@ -16,6 +86,28 @@ class LlamaJNI private constructor() {
         private const val TAG = "LlamaJNI"
         private var instance: LlamaJNI? = null
 
+        // Initial token buffer: 8k ids = the whole context window.
+        private const val TOKEN_BUFFER_INTS = 8192
+
+        // Span delimiters understood by the native prompt builder (chat_prompt.h).
+        private const val TRUNCATE_BEGIN = '\uE000'
+        private const val TRUNCATE_END   = '\uE001'
+        private const val SUMMARIZE_BEGIN = '\uE002'
+        private const val SUMMARIZE_END   = '\uE003'
+
+        private fun stripSpanMarkers(text: String): String =
+            text.replace(TRUNCATE_BEGIN, ' ').replace(TRUNCATE_END, ' ')
+                .replace(SUMMARIZE_BEGIN, ' ').replace(SUMMARIZE_END, ' ')
+
+        // Marks text (e.g. an email body) as shortenable to fit the prompt budget.
+        fun truncatable(text: String): String =
+            "$TRUNCATE_BEGIN${stripSpanMarkers(text)}$TRUNCATE_END"
+
+        // Marks text (e.g. a long email thread) as replaceable by a native summary
+        // when it exceeds generateChat()'s summarizeAbove; otherwise truncatable.
+        fun summarizable(text: String): String =
+            "$SUMMARIZE_BEGIN${stripSpanMarkers(text)}$SUMMARIZE_END"
+
         fun getInstance(): LlamaJNI {
             return instance ?: synchronized(this) {
                 instance ?: LlamaJNI().also {
@@ -29,6 +121,42 @@ class LlamaJNI private constructor() {
     // Kotlin-side lock — prevents two coroutines calling nativeGenerate simultaneously
     private val lock = java.util.concurrent.locks.ReentrantLock()
 
+    // Direct buffer the native tokenizers write ids into — one per thread, grown on demand.
+    private val tokenBuffer = object : ThreadLocal<ByteBuffer>() {
+        override fun initialValue(): ByteBuffer = allocTokenBuffer(TOKEN_BUFFER_INTS)
+    }
+
+    private fun allocTokenBuffer(ints: Int): ByteBuffer =
+        ByteBuffer.allocateDirect(ints * 4).order(ByteOrder.nativeOrder())
+
+    // Runs a native tokenizer against the thread's buffer; retries once, grown,
+    // when the native side reports it needs more room (negative count).
+    private inline fun readTokens(fill: (ByteBuffer) -> Int): IntArray {
+        var buf = tokenBuffer.get()!!
+        var n = fill(buf)
+        if (n < 0) {
+            buf = allocTokenBuffer(-n)
+            tokenBuffer.set(buf)
+            n = fill(buf)
+        }
+        if (n <= 0) return IntArray(0)
+        val out = IntArray(n)
+        buf.asIntBuffer().get(out, 0, n)
+        return out
+    }
+
+    private fun utf8(s: String): ByteArray = s.toByteArray(Charsets.UTF_8)
+
+    // Reply bytes → String; null (native allocation failed) → "".
+    private fun decode(bytes: ByteArray?): String =
+        if (bytes == null || bytes.isEmpty()) "" else String(bytes, Charsets.UTF_8)
+
+    private fun roles(messages: List<ChatTurn>): Array<ByteArray> =
+        Array(messages.size) { utf8(messages[it].role) }
+
+    private fun contents(messages: List<ChatTurn>): Array<ByteArray> =
+        Array(messages.size) { utf8(messages[it].content) }
+
     // Tracks whether the native .so was successfully loaded.
     // False means the JNI bridge itself is broken (wrong ABI, missing from APK, etc.)
     // Distinct from "model not loaded" — allows dashboard to show specific error.
@@ -47,6 +175,86 @@ class LlamaJNI private constructor() {
 
     fun isNativeLibLoaded(): Boolean = nativeLibLoaded
 
+    // Live engine counters (state, tok/s, KV, RSS, queue) — see EngineMetrics.
+    val metrics: EngineMetrics by lazy {
+        EngineMetrics(
+            try {
+                if (nativeLibLoaded) nativeMetricsBuffer() else null
+            } catch (e: UnsatisfiedLinkError) {
+                Log.e(TAG, "nativeMetricsBuffer UnsatisfiedLinkError: ${e.message}")
+                null
+            }
+        )
+    }
+
+    // Callbacks from the native loader thread — keep them short.
+    interface LoadListener {
+        fun onProgress(progress: Float)        // 0..1, once per percent
+        fun onComplete(success: Boolean)       // false on failure or cancellation
+    }
+
+    // Starts a background load and returns at once; false if one is already running
+    // (the listener is then never called).
+    fun loadModelAsync(path: String, listener: LoadListener): Boolean {
+        return try {
+            nativeLoadModelAsync(path, listener)
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "loadModelAsync UnsatisfiedLinkError: ${e.message}")
+            false
+        }
+    }
+
+    // Hot swap: the current model keeps serving while path loads and warms. It is
+    // replaced once its request in flight finishes. The listener is only called when
+    // the result is STARTED. NO_MEMORY: both models would not fit. NOT_LOADED: there
+    // is nothing to keep serving, so use loadModelAsync().
+    fun swapModelAsync(path: String, listener: LoadListener): SwapResult {
+        return try {
+            SwapResult.values().getOrElse(nativeSwapModelAsync(path, listener)) { SwapResult.BUSY }
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "swapModelAsync UnsatisfiedLinkError: ${e.message}")
+            SwapResult.NOT_LOADED
+        }
+    }
+
+    // Registers path as model `name` (replacing one of that name), for generate() /
+    // generateChat(model = name). Blocks for the load and warm-up — call it from
+    // Dispatchers.IO. False if it failed or would not fit beside the primary model.
+    fun addModel(name: String, path: String): Boolean {
+        return try {
+            nativeAddModel(name, path)
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "addModel UnsatisfiedLinkError: ${e.message}")
+            false
+        }
+    }
+
+    fun removeModel(name: String): Boolean {
+        return try {
+            nativeRemoveModel(name)
+        } catch (e: UnsatisfiedLinkError) {
+            false
+        }
+    }
+
+    fun modelNames(): List<String> {
+        return try {
+            nativeModelNames()?.map { decode(it) } ?: emptyList()
+        } catch (e: UnsatisfiedLinkError) {
+            emptyList()
+        }
+    }
+
+    // Abandons the loadModelAsync() or swapModelAsync() in progress; addModel() is not
+    // affected.
+    fun cancelLoad() {
+        try {
+            nativeCancelLoad()
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "cancelLoad UnsatisfiedLinkError: ${e.message}")
+        }
+    }
+
     fun loadModel(path: String): Boolean {
         return try {
             lock.lock()
@@ -59,19 +267,38 @@ class LlamaJNI private constructor() {
         }
     }
 
+    // After a load: brings the model to steady state without generating anything.
+    // Blocks for the warm-up (about one prefill); null if the native library is missing.
+    fun warmup(): WarmupStats? {
+        return try {
+            lock.lock()
+            nativeWarmup()?.let { WarmupStats.fromArray(it) }
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "warmup UnsatisfiedLinkError: ${e.message}")
+            null
+        } finally {
+            lock.unlock()
+        }
+    }
+
     // NOTE: This blocks the calling thread during generation (can be 5-30s)
     // Always call from Dispatchers.IO — never on Main thread
     // temperature: 0.0 = greedy/deterministic, 0.7 = balanced, 1.0 = creative
     // topP: nucleus sampling probability mass (0.9 is a good default)
+    // sessionKey: stable per-conversation key (e.g. "sms:+15551234567") — reuses the
+    //   KV cache of that conversation's previous prompt. null = stateless generation.
+    // model: name given to addModel(); null = the primary model.
     fun generate(
         prompt: String,
         maxTokens: Int = 256,
         temperature: Float = 0.7f,
-        topP: Float = 0.9f
+        topP: Float = 0.9f,
+        sessionKey: String? = null,
+        model: String? = null
     ): String {
         return try {
             lock.lock()
-            nativeGenerate(prompt, maxTokens, temperature, topP)
+            decode(nativeGenerate(utf8(prompt), maxTokens, temperature, topP, sessionKey?.let { utf8(it) }, model))
         } catch (e: UnsatisfiedLinkError) {
             Log.e(TAG, "generate UnsatisfiedLinkError: ${e.message}")
             ""
@@ -80,6 +307,174 @@ class LlamaJNI private constructor() {
         }
     }
 
+    // Chat generation — messages are rendered with the model's own chat template.
+    // assistantPrefill: text placed after the assistant header (e.g. an empty
+    //   <think></think> block for Qwen3); null for none.
+    // segmentBudget: token cap per truncatable() span; 0 = cut only as needed to fit.
+    // summarizeAbove: summarizable() spans over this many tokens are summarized
+    //   first (can take a while — several chunk generations); 0 = never.
+    // Other parameters as generate().
+    fun generateChat(
+        messages: List<ChatTurn>,
+        maxTokens: Int = 256,
+        temperature: Float = 0.7f,
+        topP: Float = 0.9f,
+        assistantPrefill: String? = null,
+        sessionKey: String? = null,
+        segmentBudget: Int = 0,
+        summarizeAbove: Int = 0,
+        model: String? = null
+    ): String {
+        return try {
+            lock.lock()
+            decode(nativeGenerateChat(
+                roles(messages), contents(messages),
+                assistantPrefill?.let { utf8(it) }, segmentBudget, summarizeAbove, maxTokens,
+                temperature, topP, sessionKey?.let { utf8(it) }, model
+            ))
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "generateChat UnsatisfiedLinkError: ${e.message}")
+            ""
+        } finally {
+            lock.unlock()
+        }
+    }
+
+    // generateChat() through a small-to-large cascade: `small` (an addModel() name)
+    // drafts the reply greedily, for at most draftMaxTokens, and it is kept if the
+    // draft ended on its own with a mean token entropy of at most maxMeanEntropy
+    // (nats) and no token less likely than minTokenProb; otherwise the primary model
+    // answers with temperature / topP. lastStats().cascade says which. No
+    // summarization; other parameters as generateChat().
+    fun generateCascade(
+        messages: List<ChatTurn>,
+        small: String,
+        maxTokens: Int = 256,
+        temperature: Float = 0.7f,
+        topP: Float = 0.9f,
+        assistantPrefill: String? = null,
+        sessionKey: String? = null,
+        segmentBudget: Int = 0,
+        maxMeanEntropy: Float = 1.5f,
+        minTokenProb: Float = 0.01f,
+        draftMaxTokens: Int = 96
+    ): String {
+        return try {
+            lock.lock()
+            decode(nativeGenerateCascade(
+                roles(messages), contents(messages),
+                assistantPrefill?.let { utf8(it) }, segmentBudget, maxTokens,
+                temperature, topP, sessionKey?.let { utf8(it) }, small, maxMeanEntropy, minTokenProb,
+                draftMaxTokens
+            ))
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "generateCascade UnsatisfiedLinkError: ${e.message}")
+            ""
+        } finally {
+            lock.unlock()
+        }
+    }
+
+    // Prefix-shared bulk generation — prompt i is [system, userMessages[i]].
+    // The common prompt prefix is prefilled once and forked natively.
+    // Returns one reply per message in order ("" where a reply could not be produced).
+    // Each prompt is fitted on its own; segmentBudget as generateChat().
+    // Blocks for the whole batch; same threading rules as generate().
+    fun generateBulk(
+        systemPrompt: String,
+        userMessages: List<String>,
+        maxTokens: Int = 256,
+        temperature: Float = 0.7f,
+        topP: Float = 0.9f,
+        segmentBudget: Int = 0
+    ): List<String> {
+        if (userMessages.isEmpty()) return emptyList()
+        return try {
+            lock.lock()
+            nativeGenerateBulk(utf8(systemPrompt), Array(userMessages.size) { utf8(userMessages[it]) },
+                segmentBudget, maxTokens, temperature, topP)
+                ?.map { decode(it) } ?: List(userMessages.size) { "" }
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "generateBulk UnsatisfiedLinkError: ${e.message}")
+            List(userMessages.size) { "" }
+        } finally {
+            lock.unlock()
+        }
+    }
+
+    // Token ids for text as-is (no chat template). addSpecial adds BOS where the
+    // model wants one — only for text that starts a prompt. Empty if no model.
+    fun tokenize(text: String, addSpecial: Boolean = false): IntArray {
+        return try {
+            readTokens { nativeTokenize(utf8(text), addSpecial, it) }
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "tokenize UnsatisfiedLinkError: ${e.message}")
+            IntArray(0)
+        }
+    }
+
+    // Tokens text costs inside a prompt; -1 if no model is loaded.
+    fun countTokens(text: String): Int {
+        return try {
+            nativeCountTokens(utf8(text))
+        } catch (e: UnsatisfiedLinkError) {
+            -1
+        }
+    }
+
+    // Exact prompt tokens generateChat() would decode for these messages with
+    // maxTokens = reserveTokens — measure with .size, then pass to generateTokens()
+    // without re-tokenizing. Empty if the prompt cannot fit.
+    fun tokenizeChat(
+        messages: List<ChatTurn>,
+        assistantPrefill: String? = null,
+        reserveTokens: Int = 256,
+        segmentBudget: Int = 0
+    ): IntArray {
+        return try {
+            lock.lock()
+            readTokens {
+                nativeTokenizeChat(
+                    roles(messages), contents(messages),
+                    assistantPrefill?.let { utf8(it) }, reserveTokens, segmentBudget, it
+                )
+            }
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "tokenizeChat UnsatisfiedLinkError: ${e.message}")
+            IntArray(0)
+        } finally {
+            lock.unlock()
+        }
+    }
+
+    // Generation from prompt token ids (see tokenizeChat). Parameters as generate().
+    fun generateTokens(
+        tokens: IntArray,
+        maxTokens: Int = 256,
+        temperature: Float = 0.7f,
+        topP: Float = 0.9f,
+        sessionKey: String? = null
+    ): String {
+        return try {
+            lock.lock()
+            decode(nativeGenerateTokens(tokens, maxTokens, temperature, topP, sessionKey?.let { utf8(it) }))
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "generateTokens UnsatisfiedLinkError: ${e.message}")
+            ""
+        } finally {
+            lock.unlock()
+        }
+    }
+
+    // Context window in tokens; 0 when no model is loaded.
+    fun contextSize(): Int {
+        return try {
+            nativeGetContextSize()
+        } catch (e: UnsatisfiedLinkError) {
+            0
+        }
+    }
+
     fun isLoaded(): Boolean {
         return try {
             nativeIsLoaded()
@@ -107,17 +502,405 @@ class LlamaJNI private constructor() {
         }
     }
 
-    // Chat prompt formatter for Qwen3 ChatML format
-    fun buildChatPrompt(systemPrompt: String, userMessage: String): String {
-        return "<|im_start|>system\n$systemPrompt<|im_end|>\n" +
-               "<|im_start|>user\n$userMessage<|im_end|>\n" +
-               "<|im_start|>assistant\n"
+    // Session cache: hot sessions stay in RAM up to ramBudgetMb, colder ones are
+    // compressed into dir up to diskBudgetMb. ramBudgetMb = 0 disables sessions.
+    fun configureSessionCache(dir: String, ramBudgetMb: Int, diskBudgetMb: Int) {
+        try {
+            nativeConfigureSessions(dir, ramBudgetMb * 1024L * 1024L, diskBudgetMb * 1024L * 1024L)
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "configureSessionCache error: ${e.message}")
+        }
+    }
+
+    // Stats of the last generate()/generateChat()/generateTokens() call; null if
+    // the native library is unavailable.
+    fun lastStats(): GenerationStats? {
+        return try {
+            nativeLastStats()?.let { GenerationStats.fromArray(it) }
+        } catch (e: UnsatisfiedLinkError) {
+            null
+        }
+    }
+
+    // Native memory breakdown; null if the native library is unavailable.
+    // Scans /proc/self/smaps — call on demand, not per frame.
+    fun memoryStats(): MemoryStats? {
+        return try {
+            nativeMemoryStats()?.let { MemoryStats.fromArray(it) }
+        } catch (e: UnsatisfiedLinkError) {
+            null
+        }
+    }
+
+    // How the next load maps the weights, and the readahead hint / page-touch pass
+    // applied after it and on every prefetchWeights(). See WeightsAdvice.
+    fun setWeightsPolicy(
+        useMmap: Boolean = true,
+        useMlock: Boolean = false,
+        advice: WeightsAdvice = WeightsAdvice.NONE,
+        touchPages: Boolean = false
+    ) {
+        try {
+            nativeSetWeightsPolicy(useMmap, useMlock, advice.ordinal, touchPages)
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "setWeightsPolicy UnsatisfiedLinkError: ${e.message}")
+        }
+    }
+
+    // Re-applies the advice and touch pass in the background — returns at once.
+    fun prefetchWeights() {
+        try {
+            nativePrefetchWeights()
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "prefetchWeights UnsatisfiedLinkError: ${e.message}")
+        }
+    }
+
+    // Resident share of the mapped weights; null if the native library is unavailable.
+    fun weightsResidency(): WeightsResidency? {
+        return try {
+            nativeWeightsResidency()?.let { WeightsResidency.fromArray(it) }
+        } catch (e: UnsatisfiedLinkError) {
+            null
+        }
+    }
+
+    // Huge-page backing for the native buffers — see HugePageMode. Recreates the
+    // context (KV cleared) when a model is loaded, so call it between generations.
+    fun setHugePages(mode: HugePageMode): Boolean {
+        return try {
+            nativeSetHugePages(mode.ordinal)
+        } catch (e: UnsatisfiedLinkError) {
+            false
+        }
+    }
+
+    // Kernel THP setting and how much of the advised memory is huge now.
+    fun hugePageInfo(): String {
+        return try {
+            nativeHugePageInfo()
+        } catch (e: UnsatisfiedLinkError) {
+            "Native library not available"
+        }
+    }
+
+    // Switches native op profiling on or off. Recreates the context (KV cleared), so
+    // call it between generations; profiled runs are slower than normal ones.
+    fun setOpProfiling(enabled: Boolean): Boolean {
+        return try {
+            nativeSetOpProfiling(enabled)
+        } catch (e: UnsatisfiedLinkError) {
+            false
+        }
+    }
+
+    // Op time breakdown accumulated while profiling was on, sorted by total time.
+    // reset = start the next report from zero.
+    fun opProfileReport(reset: Boolean = false): String {
+        return try {
+            nativeOpProfileReport(reset)
+        } catch (e: UnsatisfiedLinkError) {
+            "Native library not available"
+        }
+    }
+
+    // True if the native library was built with trace spans compiled in.
+    fun isTraceEnabled(): Boolean {
+        return try {
+            nativeTraceEnabled()
+        } catch (e: UnsatisfiedLinkError) {
+            false
+        }
+    }
+
+    // Recorded spans as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+    // clear = drop them afterwards, so the next dump covers only newer work.
+    fun dumpTrace(clear: Boolean = false): String? {
+        return try {
+            nativeTraceDump(clear)
+        } catch (e: UnsatisfiedLinkError) {
+            null
+        }
+    }
+
+    fun getSessionStats(): String {
+        return try {
+            nativeGetSessionStats()
+        } catch (e: UnsatisfiedLinkError) {
+            "Native library not available"
+        }
     }
 
     // Native declarations — prefixed to avoid Kotlin overload conflicts
     private external fun nativeLoadModel(path: String): Boolean
-    private external fun nativeGenerate(prompt: String, maxTokens: Int, temperature: Float, topP: Float): String
+    private external fun nativeLoadModelAsync(path: String, listener: LoadListener): Boolean
+    private external fun nativeSwapModelAsync(path: String, listener: LoadListener): Int
+    private external fun nativeCancelLoad()
+    // Text parameters and replies are UTF-8 bytes (utf8() / decode()).
+    private external fun nativeGenerate(prompt: ByteArray, maxTokens: Int, temperature: Float, topP: Float, sessionKey: ByteArray?, model: String?): ByteArray?
+    private external fun nativeGenerateChat(roles: Array<ByteArray>, contents: Array<ByteArray>, assistantPrefill: ByteArray?, segmentBudget: Int, summarizeAbove: Int, maxTokens: Int, temperature: Float, topP: Float, sessionKey: ByteArray?, model: String?): ByteArray?
+    private external fun nativeGenerateCascade(roles: Array<ByteArray>, contents: Array<ByteArray>, assistantPrefill: ByteArray?, segmentBudget: Int, maxTokens: Int, temperature: Float, topP: Float, sessionKey: ByteArray?, small: String, maxMeanEntropy: Float, minTokenProb: Float, draftMaxTokens: Int): ByteArray?
+    private external fun nativeGenerateBulk(systemPrompt: ByteArray, userMessages: Array<ByteArray>, segmentBudget: Int, maxTokens: Int, temperature: Float, topP: Float): Array<ByteArray?>?
+    private external fun nativeTokenize(text: ByteArray, addSpecial: Boolean, out: ByteBuffer): Int
+    private external fun nativeCountTokens(text: ByteArray): Int
+    private external fun nativeTokenizeChat(roles: Array<ByteArray>, contents: Array<ByteArray>, assistantPrefill: ByteArray?, reserveTokens: Int, segmentBudget: Int, out: ByteBuffer): Int
+    private external fun nativeGenerateTokens(tokens: IntArray, maxTokens: Int, temperature: Float, topP: Float, sessionKey: ByteArray?): ByteArray?
+    private external fun nativeGetContextSize(): Int
     private external fun nativeIsLoaded(): Boolean
     private external fun nativeUnload()
     private external fun nativeGetModelInfo(): String
+    private external fun nativeConfigureSessions(dir: String, ramBudgetBytes: Long, diskBudgetBytes: Long)
+    private external fun nativeGetSessionStats(): String
+    private external fun nativeLastStats(): DoubleArray?
+    private external fun nativeMetricsBuffer(): ByteBuffer?
+    private external fun nativeTraceEnabled(): Boolean
+    private external fun nativeTraceDump(clear: Boolean): String
+    private external fun nativeSetOpProfiling(enable: Boolean): Boolean
+    private external fun nativeMemoryStats(): LongArray?
+    private external fun nativeOpProfileReport(reset: Boolean): String
+    private external fun nativeSetWeightsPolicy(useMmap: Boolean, useMlock: Boolean, advice: Int, touchPages: Boolean)
+    private external fun nativePrefetchWeights()
+    private external fun nativeWeightsResidency(): LongArray?
+    private external fun nativeWarmup(): DoubleArray?
+    private external fun nativeSetHugePages(mode: Int): Boolean
+    private external fun nativeHugePageInfo(): String
+    private external fun nativeAddModel(name: String, path: String): Boolean
+    private external fun nativeRemoveModel(name: String): Boolean
+    private external fun nativeModelNames(): Array<ByteArray?>?
+}
+
+// One chat message for LlamaJNI.generateChat() — role is "system", "user" or "assistant"
+data class ChatTurn(val role: String, val content: String) {
+    companion object {
+        fun system(content: String) = ChatTurn("system", content)
+        fun user(content: String) = ChatTurn("user", content)
+    }
+}
+
+// Timings of one generation — mirrors GenerationStats in generation.h. Times in ms.
+// tokenizeMs covers prompt assembly (template, tokenize, summarization); it is 0 for
+// generateTokens(), whose prompt was tokenized by an earlier call.
+data class GenerationStats(
+    val tokenizeMs: Double,
+    val promptTokens: Int,
+    val reusedTokens: Int,
+    val restoreMs: Double,
+    val prefillMs: Double,
+    val prefillTokPerSec: Double,
+    val ttftMs: Double,
+    val decodeMs: Double,
+    val decodeTokPerSec: Double,
+    val samplerMs: Double,
+    val generatedTokens: Int,
+    val stopReason: StopReason,
+    val peakKvCells: Int,
+    val totalMs: Double,
+    val prefillCounters: HwCounters? = null,
+    val decodeCounters: HwCounters? = null,
+    val cascade: CascadeStats? = null
+) {
+    enum class StopReason { NONE, END_OF_GENERATION, MAX_TOKENS, CONTEXT_FULL, ERROR }
+
+    // Which model of generateCascade() answered — order matches CascadeTier in generation.h.
+    enum class CascadeTier { NONE, SMALL, LARGE }
+
+    // The small model's draft; when tier is LARGE the other fields describe the large
+    // model's run, and ttftMs / totalMs include draftMs.
+    data class CascadeStats(
+        val tier: CascadeTier,
+        val draftMeanEntropy: Double,    // nats per token
+        val draftMinProb: Double,
+        val draftMs: Double
+    ) {
+        fun summary(): String =
+            "$tier (draft entropy %.2f, min p %.3f, %.0f ms)".format(draftMeanEntropy, draftMinProb, draftMs)
+    }
+
+    fun summary(): String =
+        "Prompt: $promptTokens tok ($reusedTokens reused) | " +
+        "Prefill: %.0f ms, %.1f tok/s | TTFT: %.0f ms | ".format(prefillMs, prefillTokPerSec, ttftMs) +
+        "Decode: $generatedTokens tok, %.1f tok/s | Sampler: %.1f ms | ".format(decodeTokPerSec, samplerMs) +
+        "Tokenize: %.1f ms | Stop: $stopReason | KV: $peakKvCells cells | Total: %.0f ms".format(tokenizeMs, totalMs) +
+        (prefillCounters?.let { " | Prefill HW: ${it.summary()}" } ?: "") +
+        (decodeCounters?.let { " | Decode HW: ${it.summary()}" } ?: "") +
+        (cascade?.let { " | Cascade: ${it.summary()}" } ?: "")
+
+    companion object {
+        private const val FIELDS = 14    // hardware counters (10 more) and cascade (4) are optional
+
+        private fun cascadeFromArray(a: DoubleArray, at: Int): CascadeStats? {
+            if (a.size < at + 4) return null
+            val tier = CascadeTier.values().getOrElse(a[at].toInt()) { CascadeTier.NONE }
+            if (tier == CascadeTier.NONE) return null
+            return CascadeStats(tier, a[at + 1], a[at + 2], a[at + 3])
+        }
+
+        // Index order matches statsToArray() in llama_jni.cpp.
+        fun fromArray(a: DoubleArray): GenerationStats? {
+            if (a.size < FIELDS) return null
+            return GenerationStats(
+                tokenizeMs       = a[0],
+                promptTokens     = a[1].toInt(),
+                reusedTokens     = a[2].toInt(),
+                restoreMs        = a[3],
+                prefillMs        = a[4],
+                prefillTokPerSec = a[5],
+                ttftMs           = a[6],
+                decodeMs         = a[7],
+                decodeTokPerSec  = a[8],
+                samplerMs        = a[9],
+                generatedTokens  = a[10].toInt(),
+                stopReason       = StopReason.values().getOrElse(a[11].toInt()) { StopReason.NONE },
+                peakKvCells      = a[12].toInt(),
+                totalMs          = a[13],
+                prefillCounters  = HwCounters.fromArray(a, 14, 22),
+                decodeCounters   = HwCounters.fromArray(a, 18, 23),
+                cascade          = cascadeFromArray(a, 24)
+            )
+        }
+    }
+}
+
+// Hardware counters of one generation phase (perf_counters.h).
+data class HwCounters(
+    val cycles: Long,
+    val instructions: Long,
+    val cacheMisses: Long,
+    val branchMisses: Long,
+    val dtlbMisses: Long = -1     // -1: the core has no dTLB event
+) {
+    // Instructions per cycle — low IPC with many cache misses means memory-bound.
+    val ipc: Double get() = if (cycles > 0) instructions.toDouble() / cycles else 0.0
+
+    fun summary(): String =
+        "%.2f IPC, %.0fM cycles, %.1fM cache misses, %.1fM branch misses".format(
+            ipc, cycles / 1e6, cacheMisses / 1e6, branchMisses / 1e6) +
+        (if (dtlbMisses >= 0) ", %.1fM dTLB misses".format(dtlbMisses / 1e6) else "")
+
+    companion object {
+        // Four values from `at`, the dTLB count from dtlbAt; native -1 marks counters
+        // that were unavailable.
+        fun fromArray(a: DoubleArray, at: Int, dtlbAt: Int): HwCounters? {
+            if (a.size < at + 4 || a[at] < 0) return null
+            return HwCounters(a[at].toLong(), a[at + 1].toLong(), a[at + 2].toLong(), a[at + 3].toLong(),
+                              if (a.size > dtlbAt) a[dtlbAt].toLong() else -1)
+        }
+    }
+}
+
+// Outcome of LlamaJNI.swapModelAsync() — order matches SwapResult in engine.h.
+enum class SwapResult { STARTED, BUSY, NO_MEMORY, NOT_LOADED }
+
+// Stage timings of the native warm-up (Engine::warmup() in engine.h).
+data class WarmupStats(
+    val ok: Boolean,
+    val threadsMs: Double,       // wake the threadpool
+    val touchMs: Double,         // fault in KV cache and compute buffers
+    val touchedBytes: Long,
+    val graphMs: Double,         // warm-up graph over every weight
+    val decodeMs: Double,        // one single-token decode
+    val totalMs: Double
+) {
+    fun summary(): String =
+        "%.0f ms — threads %.1f, touch %.0f (%.0f MB), graph %.0f, decode %.0f".format(
+            totalMs, threadsMs, touchMs, touchedBytes / 1048576.0, graphMs, decodeMs)
+
+    companion object {
+        private const val FIELDS = 7
+
+        // Index order matches nativeWarmup() in llama_jni.cpp.
+        fun fromArray(a: DoubleArray): WarmupStats? {
+            if (a.size < FIELDS) return null
+            return WarmupStats(a[0] != 0.0, a[1], a[2], a[3].toLong(), a[4], a[5], a[6])
+        }
+    }
+}
+
+// Native memory breakdown in bytes (memory_stats.h). Buffer sizes come from
+// llama.cpp's load log and read 0 if its format changes.
+data class MemoryStats(
+    val weightsBytes: Long,
+    val weightsMappedBytes: Long,
+    val weightsAnonBytes: Long,
+    val weightsResidentBytes: Long,
+    val kvBytes: Long,
+    val kvKBytes: Long,
+    val kvVBytes: Long,
+    val kvType: Int,             // ggml_type of K and V
+    val computeBytes: Long,
+    val mallocArenaBytes: Long,
+    val mallocMmappedBytes: Long,
+    val mallocInUseBytes: Long,
+    val mallocFreeBytes: Long,
+    val rssBytes: Long,
+    val pssBytes: Long,
+    val pssAnonBytes: Long,
+    val pssFileBytes: Long,
+    val swapBytes: Long,
+    val peakRssBytes: Long,
+    val peakSinceLoad: Boolean   // false: peak since process start
+) {
+    val kvTypeName: String get() = GGML_TYPES[kvType] ?: "type $kvType"
+
+    fun summary(): String =
+        "Weights: ${mb(weightsBytes)} (mapped ${mb(weightsMappedBytes)}, anon ${mb(weightsAnonBytes)}, " +
+        "resident ${mb(weightsResidentBytes)}) | KV: ${mb(kvBytes)} $kvTypeName (K ${mb(kvKBytes)}, V ${mb(kvVBytes)}) | " +
+        "Compute: ${mb(computeBytes)} | Malloc: ${mb(mallocInUseBytes)} used, ${mb(mallocFreeBytes)} free, " +
+        "${mb(mallocMmappedBytes)} mmapped | RSS: ${mb(rssBytes)} | PSS: ${mb(pssBytes)} " +
+        "(anon ${mb(pssAnonBytes)}, file ${mb(pssFileBytes)}) | Swap: ${mb(swapBytes)} | " +
+        "Peak RSS: ${mb(peakRssBytes)}${if (peakSinceLoad) " since load" else " since start"}"
+
+    companion object {
+        private const val FIELDS = 20
+        private val GGML_TYPES = mapOf(0 to "f32", 1 to "f16", 2 to "q4_0", 8 to "q8_0", 30 to "bf16")
+
+        private fun mb(bytes: Long) = "%.0f MB".format(bytes / 1048576.0)
+
+        // Index order matches nativeMemoryStats() in llama_jni.cpp.
+        fun fromArray(a: LongArray): MemoryStats? {
+            if (a.size < FIELDS) return null
+            return MemoryStats(
+                a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7].toInt(), a[8],
+                a[9], a[10], a[11], a[12], a[13], a[14], a[15], a[16], a[17],
+                a[18], a[19] != 0L
+            )
+        }
+    }
+}
+
+// madvise() hint for the mapped weights — order matches WeightsAdvice in
+// weights_residency.h.
+enum class WeightsAdvice { NONE, WILL_NEED, SEQUENTIAL, RANDOM }
+
+// Transparent huge pages for native buffers — order matches HugePageMode in
+// huge_pages.h. COLLAPSE converts synchronously (Linux 6.1+); ADVISE leaves it
+// to khugepaged. Nothing changes on kernels whose THP setting is "never".
+enum class HugePageMode { OFF, ADVISE, COLLAPSE }
+
+// Model file pages in RAM (weights_residency.h). Only mmap'd weights are counted —
+// with mmap off the weights are anonymous memory and mappedBytes is 0.
+data class WeightsResidency(
+    val mappedBytes: Long,
+    val residentBytes: Long,
+    val lockedBytes: Long,       // process VmLck — 0 when mlock was refused
+    val lastTouchMs: Double,     // last completed page-touch pass; -1 if none
+    val touching: Boolean
+) {
+    val residentFraction: Double get() =
+        if (mappedBytes > 0) residentBytes.toDouble() / mappedBytes else 0.0
+
+    fun summary(): String =
+        "Weights resident: %.0f%% of %.0f MB | locked %.0f MB".format(
+            residentFraction * 100, mappedBytes / 1048576.0, lockedBytes / 1048576.0) +
+        (if (touching) " | touching" else if (lastTouchMs >= 0) " | touched in %.0f ms".format(lastTouchMs) else "")
+
+    companion object {
+        private const val FIELDS = 5
+
+        // Index order matches nativeWeightsResidency() in llama_jni.cpp.
+        fun fromArray(a: LongArray): WeightsResidency? {
+            if (a.size < FIELDS) return null
+            return WeightsResidency(a[0], a[1], a[2], if (a[3] < 0) -1.0 else a[3] / 1000.0, a[4] != 0L)
+        }
+    }
 }
@@ -23,7 +23,9 @@ import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.SupervisorJob
 import kotlinx.coroutines.launch
 
-// AigentikService v1.6
+// AigentikService v1.7
+// v1.7: Loads the optional command model (AigentikSettings.commandModelPath) after the
+//   main model is ready.
 // v1.6: MessageEngine.configure() moved before EmailMonitor.init() (code-audit-2026-03-10).
 //   Previously configure() was called AFTER EmailMonitor.init(). If a Gmail notification
 //   arrived between those two calls, EmailMonitor would trigger processEmail() →
@@ -98,10 +100,16 @@ class AigentikService : Service() {
                 // AI model
                 val modelPath = AigentikSettings.modelPath
                 AiEngine.configure(agentName, ownerName)
+                AiEngine.configureSessionCache(java.io.File(this@AigentikService.cacheDir, "kv_sessions"))
                 if (modelPath.isNotEmpty() && java.io.File(modelPath).exists()) {
                     Log.i(TAG, "Auto-loading model: $modelPath")
                     AiEngine.loadModel(modelPath)
                     Log.i(TAG, "Model state: ${AiEngine.state}")
+                    val commandModelPath = AigentikSettings.commandModelPath
+                    if (AiEngine.isReady() && commandModelPath.isNotEmpty() &&
+                        java.io.File(commandModelPath).exists()) {
+                        AiEngine.loadCommandModel(commandModelPath)
+                    }
                 } else {
                     Log.w(TAG, "No model — fallback mode")
                 }
@@ -3,7 +3,8 @@ package com.aigentik.app.core
 import android.content.Context
 import android.content.SharedPreferences
 
-// AigentikSettings v1.1
+// AigentikSettings v1.2
+// Added: commandModelPath (optional small model for command parsing)
 // Added: adminPasswordHash, adminUsername, isOAuthSignedIn
 // Removed: gmailAppPassword dependency (replaced by OAuth2)
 object AigentikSettings {
@@ -20,6 +21,7 @@ object AigentikSettings {
     private const val KEY_AUTO_REPLY        = "auto_reply_default"
     private const val KEY_PAUSED            = "paused"
     private const val KEY_MODEL_PATH        = "model_path"
+    private const val KEY_COMMAND_MODEL_PATH = "command_model_path"
     private const val KEY_CHANNEL_PREFIX    = "channel_enabled_"
     private const val KEY_ADMIN_PASS_HASH   = "admin_password_hash"
     private const val KEY_ADMIN_USERNAME    = "admin_username"
@@ -96,6 +98,11 @@ object AigentikSettings {
         get() = prefs.getString(KEY_MODEL_PATH, "") ?: ""
         set(v) = prefs.edit().putString(KEY_MODEL_PATH, v).apply()
 
+    // "" = commands are interpreted by the main model.
+    var commandModelPath: String
+        get() = prefs.getString(KEY_COMMAND_MODEL_PATH, "") ?: ""
+        set(v) = prefs.edit().putString(KEY_COMMAND_MODEL_PATH, v).apply()
+
     fun setChannelEnabled(channelName: String, enabled: Boolean) {
         prefs.edit().putBoolean("$KEY_CHANNEL_PREFIX$channelName", enabled).apply()
     }
@@ -18,7 +18,18 @@ import kotlinx.coroutines.launch
 import kotlinx.coroutines.sync.Mutex
 import kotlinx.coroutines.sync.withLock
 
-// MessageEngine v2.1
+// MessageEngine v2.3
+// v2.3: replyDecision() and emailReplyRequest() hold the reply filters and email
+//   prompt arguments, and isAdminSender() the admin routing. handlePublicMessage(),
+//   onMessageReceived() and prefetchEmailReplies() all call them, so a prefetched
+//   reply always matches the decision and prompt of the normal path.
+// v2.2: prefetchEmailReplies() — EmailMonitor hands over a batch of fetched emails
+//   before dispatching them one by one. Emails that will be auto-replied to get their
+//   replies generated together (AiEngine.prefetchEmailReplies → bulk native call),
+//   then each handlePublicMessage() picks up its ready reply instead of running its
+//   own generation. Same filters as handlePublicMessage (never-reply, spam, auto-reply
+//   behaviour); admin senders and repeat senders within a batch are left to the
+//   normal path because their prompt depends on state changed by earlier messages.
 // v2.1: Serial message processing via Mutex (code-audit-2026-03-10):
 //   Added messageMutex (kotlinx Mutex) wrapping the entire handleAdminCommand /
 //   handlePublicMessage execution inside onMessageReceived's scope.launch.
@@ -229,8 +240,7 @@ object MessageEngine {
             }
         }
 
-        val isAdmin = isAdminChannel || AdminAuthManager.hasActiveSession(channelKey) ||
-                      message.sender.lowercase() == AigentikSettings.gmailAddress.lowercase()
+        val isAdmin = isAdminSender(message)
 
         scope.launch {
             // Acquire wake lock for the duration of inference so Samsung doesn't throttle
@@ -251,6 +261,34 @@ object MessageEngine {
         }
     }
 
+    // Pre-generate replies for a batch of inbound emails (see v2.2 notes).
+    // Runs under messageMutex like any handler; failures only lose the speed-up.
+    suspend fun prefetchEmailReplies(messages: List<Message>) {
+        if (AigentikSettings.isPaused || !AiEngine.isReady()) return
+        val wl = wakeLock
+        wl?.acquire(10 * 60 * 1000L)
+        try {
+            messageMutex.withLock {
+                val seen = mutableSetOf<String>()
+                val requests = messages.mapNotNull { message ->
+                    if (message.channel != Message.Channel.EMAIL) return@mapNotNull null
+                    if (!seen.add(message.sender.lowercase())) return@mapNotNull null
+                    if (isAdminSender(message)) return@mapNotNull null
+                    val decision = replyDecision(message)
+                    if (!decision.autoReply) return@mapNotNull null
+                    emailReplyRequest(message, decision.contact,
+                        loadHistory(historyKey(message), message.channel.name))
+                }
+                Log.i(TAG, "prefetchEmailReplies: ${requests.size} of ${messages.size} emails eligible")
+                AiEngine.prefetchEmailReplies(requests)
+            }
+        } catch (e: Throwable) {
+            Log.w(TAG, "prefetchEmailReplies failed (non-fatal): ${e.javaClass.simpleName}: ${e.message}")
+        } finally {
+            if (wl?.isHeld == true) wl.release()
+        }
+    }
+
     private suspend fun handleAdminCommand(message: Message) {
         Log.i(TAG, "handleAdminCommand: entry channel=${message.channel} body='${message.body.take(80)}'")
 
@@ -872,33 +910,70 @@ object MessageEngine {
         }
     }
 
+    // Chat screen, authenticated admin session or the owner's own address — these
+    // messages are commands, never auto-replied.
+    private fun isAdminSender(message: Message): Boolean =
+        message.channel == Message.Channel.CHAT ||
+            AdminAuthManager.hasActiveSession(message.sender) ||
+            message.sender.lowercase() == AigentikSettings.gmailAddress.lowercase()
+
+    // What handlePublicMessage() does with a public message. skip: why it is dropped
+    // outright (never-reply contact, spam), null otherwise.
+    private class ReplyDecision(
+        val contact: ContactEngine.Contact,
+        val skip: String?,
+        val autoReply: Boolean
+    )
+
+    private fun replyDecision(message: Message): ReplyDecision {
+        // Use email-appropriate lookup for EMAIL channel (sender is an email address)
+        val contact = if (message.channel == Message.Channel.EMAIL)
+            ContactEngine.findOrCreateByEmail(message.sender)
+        else
+            ContactEngine.findOrCreateByPhone(message.sender)
+
+        if (contact.replyBehavior == ContactEngine.ReplyBehavior.NEVER) {
+            return ReplyDecision(contact, "Never-reply contact — skipping", false)
+        }
+
+        // Use email rules for EMAIL channel, SMS rules for all other channels
+        val (ruleAction, _) = if (message.channel == Message.Channel.EMAIL)
+            RuleEngine.checkEmail(message.sender, message.subject ?: "", message.body)
+        else
+            RuleEngine.checkSms(message.sender, message.body)
+        if (ruleAction == RuleEngine.Action.SPAM) return ReplyDecision(contact, "Spam blocked", false)
+
+        val autoReply = contact.replyBehavior == ContactEngine.ReplyBehavior.ALWAYS ||
+            contact.replyBehavior == ContactEngine.ReplyBehavior.AUTO ||
+            ruleAction == RuleEngine.Action.AUTO_REPLY
+        return ReplyDecision(contact, null, autoReply)
+    }
+
+    // Email reply prompt arguments — a prefetched reply is found by these.
+    private fun emailReplyRequest(
+        message: Message,
+        contact: ContactEngine.Contact,
+        history: List<String>
+    ) = AiEngine.EmailReplyRequest(
+        fromName            = message.senderName,
+        fromEmail           = message.sender,
+        subject             = message.subject ?: "Email",
+        body                = message.body,
+        relationship        = contact.relationship,
+        instructions        = contact.instructions,
+        conversationHistory = history
+    )
+
     private suspend fun handlePublicMessage(message: Message) {
         Log.i(TAG, "Public message from ${message.sender} via ${message.channel}")
         try {
-            // Use email-appropriate lookup for EMAIL channel (sender is an email address)
-            val contact = if (message.channel == Message.Channel.EMAIL)
-                ContactEngine.findOrCreateByEmail(message.sender)
-            else
-                ContactEngine.findOrCreateByPhone(message.sender)
-
-            if (contact.replyBehavior == ContactEngine.ReplyBehavior.NEVER) {
-                Log.i(TAG, "Never-reply contact — skipping")
-                return
-            }
-
-            // Use email rules for EMAIL channel, SMS rules for all other channels
-            val (ruleAction, _) = if (message.channel == Message.Channel.EMAIL)
-                RuleEngine.checkEmail(message.sender, message.subject ?: "", message.body)
-            else
-                RuleEngine.checkSms(message.sender, message.body)
-            if (ruleAction == RuleEngine.Action.SPAM) {
-                Log.i(TAG, "Spam blocked")
+            val decision = replyDecision(message)
+            decision.skip?.let {
+                Log.i(TAG, it)
                 return
             }
-
-            val shouldAutoReply = contact.replyBehavior == ContactEngine.ReplyBehavior.ALWAYS ||
-                contact.replyBehavior == ContactEngine.ReplyBehavior.AUTO ||
-                ruleAction == RuleEngine.Action.AUTO_REPLY
+            val contact = decision.contact
+            val shouldAutoReply = decision.autoReply
 
             if (message.body.lowercase().contains(ownerName.lowercase())) {
                 val sender = contact.name ?: message.sender
@@ -918,15 +993,7 @@ object MessageEngine {
                 // Use email-appropriate reply for EMAIL channel (longer, more professional)
                 // SMS/NOTIFICATION get the concise SMS generator
                 val reply = if (message.channel == Message.Channel.EMAIL) {
-                    AiEngine.generateEmailReply(
-                        fromName             = message.senderName,
-                        fromEmail            = message.sender,
-                        subject              = message.subject ?: "Email",
-                        body                 = message.body,
-                        relationship         = contact.relationship,
-                        instructions         = contact.instructions,
-                        conversationHistory  = history
-                    )
+                    AiEngine.generateEmailReply(emailReplyRequest(message, contact, history))
                 } else {
                     AiEngine.generateSmsReply(
                         senderName           = message.senderName ?: contact.name,
@@ -12,7 +12,10 @@ import kotlinx.coroutines.SupervisorJob
 import kotlinx.coroutines.launch
 import java.util.concurrent.atomic.AtomicBoolean
 
-// EmailMonitor v4.3 — on-device notification-triggered Gmail processing
+// EmailMonitor v4.4 — on-device notification-triggered Gmail processing
+// v4.4: processUnread() hands the fetched batch to MessageEngine.prefetchEmailReplies()
+//   before dispatching, so auto-replies for the batch are generated in one bulk
+//   native call (shared prompt prefix prefilled once) instead of one at a time.
 // v4.3: processUnread() capped at 3 emails (was 10) (code-audit-2026-03-10).
 //   On first install there is no stored historyId, so every Gmail notification falls
 //   through to the listUnread() fallback. Fetching 10 emails dispatched all 10 to
@@ -176,6 +179,13 @@ object EmailMonitor {
         }
         Log.i(TAG, "Fallback: processing ${emails.size} unread email(s)")
         val ownEmail = GoogleAuthManager.getSignedInEmail(context) ?: ""
+        if (ChannelManager.isEnabled(ChannelManager.Channel.EMAIL)) {
+            val batch = emails
+                .filter { !it.fromEmail.equals(ownEmail, ignoreCase = true) }
+                .filter { !GmailApiClient.isGoogleVoiceText(it.subject) }
+                .map { buildEmailMessage(it) }
+            MessageEngine.prefetchEmailReplies(batch)
+        }
         for (email in emails) {
             try {
                 if (email.fromEmail.equals(ownEmail, ignoreCase = true)) continue
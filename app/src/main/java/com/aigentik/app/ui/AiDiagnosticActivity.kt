@@ -6,6 +6,7 @@ import android.widget.TextView
 import androidx.appcompat.app.AppCompatActivity
 import com.aigentik.app.R
 import com.aigentik.app.ai.AiEngine
+import com.aigentik.app.ai.ChatTurn
 import com.aigentik.app.ai.LlamaJNI
 import com.aigentik.app.auth.GoogleAuthManager
 import com.aigentik.app.core.AigentikSettings
@@ -17,7 +18,18 @@ import kotlinx.coroutines.SupervisorJob
 import kotlinx.coroutines.launch
 import kotlinx.coroutines.withContext
 
-// AiDiagnosticActivity v1.1
+// AiDiagnosticActivity v1.8
+// v1.8: Benchmark result shows the huge-page state of the native buffers.
+// v1.7: Benchmark result shows the resident share of the mapped weights.
+// v1.6: Benchmark result includes the native memory breakdown.
+// v1.5: Benchmark shows per-phase hardware counters when the build records them.
+// v1.4: Long-press on Run Benchmark runs it with native op profiling on and shows
+//   the per-op / per-tensor / per-layer time breakdown in place of the sample output.
+// v1.3: In trace builds the benchmark saves its native trace spans to the cache
+//   dir (Chrome trace JSON) and shows the file path.
+// v1.2: Benchmark reports the native GenerationStats record — real prompt/generated
+//   token counts, tokenize, prefill and decode throughput, TTFT, sampler time, stop
+//   reason and peak KV cells — instead of a chars/4 tok/s estimate.
 // v1.1: Added Gmail Health section — shows sign-in status, scope grant status,
 //   historyId prime status, and a "Check Gmail Token" button that calls
 //   GmailApiClient.checkTokenHealth() (users.getProfile) to verify the token
@@ -61,6 +73,7 @@ class AiDiagnosticActivity : AppCompatActivity() {
         tvGmailHealthResult  = findViewById(R.id.tvGmailHealthResult)
 
         btnRunBenchmark.setOnClickListener { runBenchmark() }
+        btnRunBenchmark.setOnLongClickListener { runBenchmark(profileOps = true); true }
         btnCheckGmailHealth.setOnClickListener { checkGmailHealth() }
 
         refreshStatus()
@@ -183,7 +196,9 @@ class AiDiagnosticActivity : AppCompatActivity() {
         }
     }
 
-    private fun runBenchmark() {
+    // profileOps: recreate the context with the op profiler for this run (slower —
+    // every op is computed on its own) and show its report afterwards.
+    private fun runBenchmark(profileOps: Boolean = false) {
         if (!AiEngine.isReady()) {
             tvBenchmarkResult.text = "Model not loaded. Load a model first in Settings → Manage AI Model."
             tvBenchmarkResult.setTextColor(0xFFFF4444.toInt())
@@ -197,16 +212,23 @@ class AiDiagnosticActivity : AppCompatActivity() {
 
         scope.launch {
             val (elapsed, output) = withContext(Dispatchers.IO) {
-                val testPrompt = llama.buildChatPrompt(
-                    "You are a concise AI assistant.",
-                    "Briefly explain what artificial intelligence is in two sentences."
+                llama.dumpTrace(clear = true)    // trace only this run
+                if (profileOps) llama.setOpProfiling(true)
+                val testMessages = listOf(
+                    ChatTurn.system("You are a concise AI assistant."),
+                    ChatTurn.user("Briefly explain what artificial intelligence is in two sentences.")
                 )
                 val startMs = System.currentTimeMillis()
-                val result = llama.generate(testPrompt, maxTokens = 64, temperature = 0.7f, topP = 0.9f)
+                val result = llama.generateChat(testMessages, maxTokens = 64, temperature = 0.7f, topP = 0.9f)
                 val endMs = System.currentTimeMillis()
                 Pair(endMs - startMs, result)
             }
 
+            val opProfile = if (profileOps) {
+                withContext(Dispatchers.IO) {
+                    llama.opProfileReport(reset = true).also { llama.setOpProfiling(false) }
+                }
+            } else null
             btnRunBenchmark.isEnabled = true
 
             if (output.isEmpty()) {
@@ -217,22 +239,54 @@ class AiDiagnosticActivity : AppCompatActivity() {
                 return@launch
             }
 
-            val approxTokens = (output.length / 4).coerceAtLeast(1)
-            val tokensPerSec = approxTokens * 1000.0 / elapsed.coerceAtLeast(1)
+            val stats = AiEngine.getLastGenerationStats()
+            val traceFile = withContext(Dispatchers.IO) { AiEngine.writeTrace(cacheDir) }
 
             val result = buildString {
                 appendLine("Benchmark complete")
                 appendLine("─────────────────────")
                 appendLine("Time:        ${elapsed}ms")
-                appendLine("Output:      ${output.length} chars (~$approxTokens tokens)")
-                appendLine("Speed:       %.1f tok/s (approx)".format(tokensPerSec))
+                if (stats != null) {
+                    appendLine("Output:      ${output.length} chars (${stats.generatedTokens} tokens)")
+                    appendLine("Prompt:      ${stats.promptTokens} tokens (${stats.reusedTokens} reused)")
+                    appendLine("Tokenize:    %.1f ms".format(stats.tokenizeMs))
+                    appendLine("Prefill:     %.0f ms  %.1f tok/s".format(stats.prefillMs, stats.prefillTokPerSec))
+                    appendLine("TTFT:        %.0f ms".format(stats.ttftMs))
+                    appendLine("Decode:      %.0f ms  %.1f tok/s".format(stats.decodeMs, stats.decodeTokPerSec))
+                    appendLine("Sampler:     %.1f ms".format(stats.samplerMs))
+                    appendLine("Stop:        ${stats.stopReason}")
+                    appendLine("Peak KV:     ${stats.peakKvCells} cells")
+                    stats.prefillCounters?.let { appendLine("Prefill HW:  ${it.summary()}") }
+                    stats.decodeCounters?.let { appendLine("Decode HW:   ${it.summary()}") }
+                } else {
+                    val approxTokens = (output.length / 4).coerceAtLeast(1)
+                    appendLine("Output:      ${output.length} chars (~$approxTokens tokens)")
+                    appendLine("Speed:       %.1f tok/s (approx)".format(approxTokens * 1000.0 / elapsed.coerceAtLeast(1)))
+                }
+                if (traceFile != null) appendLine("Trace:       ${traceFile.absolutePath}")
+                AiEngine.getMemoryStats()?.let { m ->
+                    appendLine("─────────────────────")
+                    appendLine("Weights:     %.0f MB (%.0f mapped, %.0f anon, %.0f resident)".format(
+                        m.weightsBytes / MB, m.weightsMappedBytes / MB, m.weightsAnonBytes / MB, m.weightsResidentBytes / MB))
+                    appendLine("KV cache:    %.0f MB ${m.kvTypeName}".format(m.kvBytes / MB))
+                    appendLine("Compute:     %.0f MB".format(m.computeBytes / MB))
+                    appendLine("Malloc:      %.0f MB used, %.0f MB free".format(m.mallocInUseBytes / MB, m.mallocFreeBytes / MB))
+                    appendLine("RSS / PSS:   %.0f / %.0f MB".format(m.rssBytes / MB, m.pssBytes / MB))
+                    appendLine("Peak RSS:    %.0f MB${if (m.peakSinceLoad) " since load" else ""}".format(m.peakRssBytes / MB))
+                }
+                AiEngine.getWeightsResidency()?.takeIf { it.mappedBytes > 0 }?.let { w ->
+                    appendLine("Resident:    %.0f%% of mapped weights, %.0f MB locked".format(
+                        w.residentFraction * 100, w.lockedBytes / MB))
+                }
+                appendLine("Huge pages:  ${llama.hugePageInfo()}")
                 appendLine("─────────────────────")
                 appendLine(AiEngine.getModelInfo())
+                appendLine(AiEngine.getSessionStats())
             }
 
             tvBenchmarkResult.text = result
             tvBenchmarkResult.setTextColor(0xFF00FF88.toInt())
-            tvSampleOutput.text = output.trim()
+            tvSampleOutput.text = opProfile ?: output.trim()
         }
     }
 
@@ -245,3 +299,5 @@ class AiDiagnosticActivity : AppCompatActivity() {
 private fun CoroutineScope.cancel() {
     this.coroutineContext[kotlinx.coroutines.Job]?.cancel()
 }
+
+private const val MB = 1048576.0
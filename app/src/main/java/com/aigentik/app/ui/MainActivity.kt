@@ -11,6 +11,9 @@ import android.widget.TextView
 import androidx.appcompat.app.AppCompatActivity
 import androidx.core.app.ActivityCompat
 import androidx.core.content.ContextCompat
+import androidx.lifecycle.Lifecycle
+import androidx.lifecycle.lifecycleScope
+import androidx.lifecycle.repeatOnLifecycle
 import com.aigentik.app.BuildConfig
 import com.aigentik.app.R
 import com.aigentik.app.adapters.NotificationAdapter
@@ -25,7 +28,10 @@ import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.delay
 import kotlinx.coroutines.launch
 
-// MainActivity v1.1
+// MainActivity v1.2
+// v1.2: Live engine metrics line (tvEngineMetrics) — state, tok/s, KV cells, RSS,
+//   queue — read from the shared native metrics page without JNI while the
+//   activity is started; redrawn only when the page's update counter moves.
 // Dashboard additions over v0.9.3:
 //   - AI state display with color (Not loaded / Loading / Warming / Ready / Error)
 //   - Model info line (vocab, ctx, threads, KV, batch) from nativeGetModelInfo
@@ -42,6 +48,7 @@ class MainActivity : AppCompatActivity() {
         )
         private const val PERMISSION_REQUEST_CODE  = 100
         private const val BATTERY_OPT_REQUEST_CODE = 101
+        private const val METRICS_REFRESH_MS       = 250L  // 4 Hz
     }
 
     private val scope = CoroutineScope(Dispatchers.Main)
@@ -134,6 +141,22 @@ class MainActivity : AppCompatActivity() {
                 updateStats()
             }
         }
+
+        // Stops while the activity is in the background and ends with it.
+        lifecycleScope.launch {
+            repeatOnLifecycle(Lifecycle.State.STARTED) {
+                var lastUpdate = -1L
+                while (true) {
+                    val metrics = AiEngine.metrics
+                    val updates = metrics.updates
+                    if (updates != lastUpdate) {
+                        lastUpdate = updates
+                        safeSetText(R.id.tvEngineMetrics, "⚡ ${metrics.summary()}")
+                    }
+                    delay(METRICS_REFRESH_MS)
+                }
+            }
+        }
     }
 
     private fun updateStats() {
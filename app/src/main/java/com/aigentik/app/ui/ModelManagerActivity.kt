@@ -26,7 +26,9 @@ import java.io.FileOutputStream
 import java.net.HttpURLConnection
 import java.net.URL
 
-// ModelManagerActivity v0.9.3
+// ModelManagerActivity v0.9.4
+// v0.9.4: Loading a model while another is ready uses AiEngine.switchModel(). The
+//   assistant keeps answering with the old model until the new one is warm.
 // v0.9.3: Shows all downloaded GGUF files in modelsDir with "Load" button per file.
 //   Allows switching between multiple downloaded models without re-downloading.
 // v0.9.2: Handles model download from URL or loading from local file.
@@ -227,10 +229,14 @@ class ModelManagerActivity : AppCompatActivity() {
     }
 
     private suspend fun loadModelFile(path: String) {
-        showStatus("Loading model — this takes 15-30 seconds...")
+        if (AiEngine.isReady()) {
+            showStatus("Switching model — the current one keeps answering until it is ready...")
+        } else {
+            showStatus("Loading model — this takes 15-30 seconds...")
+        }
         Log.i(TAG, "Loading model: $path")
 
-        val success = AiEngine.loadModel(path)
+        val success = AiEngine.switchModel(path)
 
         if (success) {
             // Save model path to settings